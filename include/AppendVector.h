@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+// An append-only array in fixed blocks that copies share, so copying is O(1)
+// and a copy can be read on another thread while the original keeps growing.
+// The original goes on writing in place past the end the copy sees; a copy
+// copies the last block before its first write, and either side copies the
+// list of blocks before changing it while it is shared.
+template <typename T>
+class AppendVector {
+public:
+    AppendVector() = default;
+
+    AppendVector(std::initializer_list<T> values) {
+        for (auto& value : values) {
+            push_back(value);
+        }
+    }
+
+    AppendVector(const AppendVector& other) : blocks_(other.blocks_), size_(other.size_), limit_(other.size_) {
+
+    }
+
+    AppendVector& operator=(const AppendVector& other) {
+        if (this != &other) {
+            blocks_ = other.blocks_;
+            size_ = limit_ = other.size_;
+        }
+
+        return *this;
+    }
+
+    AppendVector(AppendVector&& other) noexcept : blocks_(std::move(other.blocks_)), size_(other.size_), limit_(other.limit_) {
+        other.size_ = other.limit_ = 0;
+    }
+
+    AppendVector& operator=(AppendVector&& other) noexcept {
+        if (this != &other) {
+            blocks_ = std::move(other.blocks_);
+            size_ = other.size_;
+            limit_ = other.limit_;
+            other.size_ = other.limit_ = 0;
+        }
+
+        return *this;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    const T& operator[](size_t i) const {
+        return (*blocks_)[i >> blockShift_][i & (blockSize_ - 1)];
+    }
+
+    const T& back() const {
+        return (*this)[size_ - 1];
+    }
+
+    void push_back(const T& value) {
+        if (size_ == limit_) {
+            grow();
+        }
+        (*blocks_)[size_ >> blockShift_][size_ & (blockSize_ - 1)] = value;
+        size_++;
+    }
+
+    void append(const T* values, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            push_back(values[i]);
+        }
+    }
+
+    // the first index from `from` on holding more than value; the values are
+    // ascending
+    size_t upperBound(const T& value, size_t from = 0) const {
+        auto count = size_ - from;
+        while (count > 0) {
+            auto half = count / 2;
+            if (!(value < (*this)[from + half])) {
+                from += half + 1;
+                count -= half + 1;
+            } else {
+                count = half;
+            }
+        }
+
+        return from;
+    }
+
+    // bytes held, blocks shared with copies included
+    size_t memory() const {
+        return blocks_ ? blocks_->size() * (blockSize_ * sizeof(T) + sizeof(Block)) : 0;
+    }
+
+    void clear() {
+        blocks_.reset();
+        size_ = limit_ = 0;
+    }
+
+    static constexpr size_t blockShift_ = 12;
+    static constexpr size_t blockSize_ = size_t(1) << blockShift_;
+
+private:
+    using Block = std::shared_ptr<T[]>;
+
+    // a block of our own for index size_: a new one at a block boundary, else
+    // a copy of the shared last block
+    void grow() {
+        if (!blocks_) {
+            blocks_ = std::make_shared<std::vector<Block>>();
+        } else if (blocks_.use_count() > 1) {
+            blocks_ = std::make_shared<std::vector<Block>>(*blocks_);
+        }
+
+        Block block(new T[blockSize_]);
+        auto used = size_ & (blockSize_ - 1);
+        if (used == 0) {
+            blocks_->push_back(std::move(block));
+        } else {
+            auto& last = blocks_->back();
+            std::copy(last.get(), last.get() + used, block.get());
+            last = std::move(block);
+        }
+        limit_ = (size_ | (blockSize_ - 1)) + 1;
+    }
+
+    std::shared_ptr<std::vector<Block>> blocks_;
+    size_t size_ = 0;
+    // push_back writes in place below this
+    size_t limit_ = 0;
+};
\ No newline at end of file
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Append-only bytes in chunks that never move, so appending never copies what
+// is stored and never stalls on a reallocation. Offsets are virtual: chunk k
+// covers [k << chunkShift_, (k + 1) << chunkShift_). The bytes of one append()
+// stay contiguous: a run that does not fit in what is left of the current
+// chunk starts the next one, the rest being padded.
+//
+// Copies share the chunks and the list of them, which makes copying O(1) and
+// lets a copy be read on another thread while the original is appended to.
+// The original goes on writing its last chunk past the end the copy sees; the
+// copy starts a fresh chunk on its first append. The list is copied before it
+// is changed while shared.
+//
+// A chunk no longer written can be frozen: kept only compressed, and thawed
+// again by the first at() that reaches it.
+class ChunkArena {
+public:
+    ChunkArena() = default;
+    ChunkArena(const ChunkArena& other);
+    ChunkArena& operator=(const ChunkArena& other);
+    ChunkArena(ChunkArena&& other) noexcept;
+    ChunkArena& operator=(ChunkArena&& other) noexcept;
+
+    // the offset text starts at; text is at most maxAppend_ bytes
+    size_t append(std::string_view text);
+    // the byte at offset; the rest of the append() it came from follows it.
+    // Safe from several threads, and while the original of a copy is changed
+    const char* at(size_t offset) const;
+    // the end of the last append, padding included
+    size_t size() const;
+    // bytes allocated, plain and compressed
+    size_t capacity() const;
+    void clear();
+    // freezes every chunk outside the sorted offset ranges in hot but the one
+    // being written, compressing at most pack chunks not compressed before. A
+    // copy keeps the chunks it shares readable; a pointer from at() on this
+    // arena into a frozen chunk is left dangling. The plain bytes released
+    size_t freeze(const std::vector<std::pair<size_t, size_t>>& hot, size_t pack);
+
+    static constexpr size_t chunkShift_ = 18;
+    static constexpr size_t chunkSize_ = size_t(1) << chunkShift_;
+    // a chunk ends in at least one byte of padding
+    static constexpr size_t maxAppend_ = chunkSize_ - 1;
+    // fills the unused end of a chunk; a space holds no line feed and no word
+    static constexpr char padding_ = ' ';
+
+private:
+    // a chunk is replaced rather than changed once it is frozen; only a thaw
+    // changes one, filling plain_ and data_ under a lock
+    struct Chunk {
+        std::shared_ptr<char[]> plain_;
+        std::shared_ptr<const std::string> packed_;
+        // compressing saved too little to be worth a thaw
+        bool incompressible_ = false;
+        // plain_.get(), null while frozen
+        std::atomic<char*> data_ = nullptr;
+    };
+    using Chunks = std::vector<std::shared_ptr<Chunk>>;
+
+    void thaw(Chunk& chunk) const;
+    Chunks& own();
+
+    std::shared_ptr<Chunks> chunks_;
+    size_t size_ = 0;
+    // appends up to here go in the last chunk
+    size_t limit_ = 0;
+};
\ No newline at end of file
@@ -13,6 +13,8 @@ public:
     void insertChar(char c);
     void insertStr(const std::string& str);
     void backspace();
+    void insertRange(size_t offset, std::string_view text);
+    void eraseRange(size_t offset, size_t length);
     void moveCursor(int dir);
     glm::ivec2 cursorRenderPos(int fontAdvance);
     bool empty();
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Table view of CSV/TSV text. A row ends at a newline outside quotes and a
+// cell at a separator outside quotes. The text is cut into chunks that are
+// parsed on worker threads, every chunk learning whether it starts inside
+// quotes from the number of quotes before it. The index is a list of row
+// starts and, per row, the offsets of its cells; sorting permutes row
+// numbers and never moves text.
+class CsvTable {
+public:
+    // threads = 0 uses every core
+    CsvTable(std::shared_ptr<const void> owner, std::string_view text, char separator, size_t threads = 0);
+
+    // '\t' for .tsv and .tab files, else whichever of , ; \t | the first line
+    // has most of
+    static char separator(std::string_view path, std::string_view head);
+
+    size_t rows() const;
+    size_t columns() const;
+    size_t cells(size_t row) const;
+    // row is a shown row, which is a row of the text until sort() is called
+    std::string_view raw(size_t row, size_t column) const;
+    // without the quotes and with "" read as "
+    std::string cell(size_t row, size_t column) const;
+    // offset of the cell in the text
+    size_t offset(size_t row, size_t column) const;
+    // the shown row holding text offset
+    size_t rowAt(size_t offset) const;
+
+    // row as aligned columns, starting at column first and stopping after
+    // width characters, so only cells that can be seen are formatted
+    std::string line(size_t row, size_t first, size_t width) const;
+    // the character the cell starts at in line(row, first, ...)
+    size_t cellColumn(size_t column, size_t first) const;
+    size_t width(size_t column) const;
+
+    // the first row is a header and stays on top; a column whose cells are
+    // all numbers is sorted as numbers
+    void sort(size_t column, bool descending, size_t threads = 0);
+
+    static constexpr size_t maxWidth_ = 32;
+    static constexpr size_t chunkSize_ = 4 << 20;
+    static constexpr size_t rowBlock_ = 1 << 16;
+
+private:
+    size_t rowEnd(size_t row) const;
+
+    std::shared_ptr<const void> owner_;
+    std::string_view text_;
+    char separator_;
+    // the start of every row and then the size of the text
+    std::vector<size_t> rowStarts_;
+    // the index in cellStarts_ of every row's first cell, and then their count
+    std::vector<size_t> rowCells_;
+    // offsets of the cells from the start of their row
+    std::vector<uint32_t> cellStarts_;
+    std::vector<uint32_t> widths_;
+    // row of the text shown at every position, empty until sorted
+    std::vector<uint32_t> order_;
+};
\ No newline at end of file
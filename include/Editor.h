@@ -2,9 +2,28 @@
 
 #include "GLFW/glfw3.h"
 #include "glm/fwd.hpp"
+#include "PieceTable.h"
+#include "PagedDocument.h"
+#include "FileSync.h"
+#include "UndoJournal.h"
+#include "SaveEngine.h"
+#include "RecoveryJournal.h"
+#include "TextSearch.h"
+#include "LineOps.h"
+#include "LogTail.h"
+#include "HexView.h"
+#include "CsvTable.h"
+#include "Transcode.h"
+#include "WrapIndex.h"
+#include "FoldIndex.h"
+#include <atomic>
 #include <cstdint>
+#include <map>
 #include <vector>
 #include <string>
+#include <string_view>
+#include <memory>
+#include <functional>
 #include <glm/glm.hpp>
 #include <iostream>
 #include <format>
@@ -27,11 +46,49 @@ public:
     struct Limit {
         int32_t up_ = 0;
         int32_t bottom_ = 1;
+        // the wrapped row of line up_ shown first
+        int32_t upRow_ = 0;
+    };
+
+    // a screen row: a line and which of its wrapped rows
+    struct Row {
+        int32_t line_ = 0;
+        int32_t row_ = 0;
+    };
+
+    struct Layout {
+        // grapheme cluster boundaries, the last one is the line's length
+        std::vector<uint32_t> bounds_;
+        // the on-screen column at each boundary
+        std::vector<uint32_t> columns_;
+    };
+
+    struct Stats {
+        size_t bytes_ = 0;
+        size_t chars_ = 0;
+        size_t words_ = 0;
+        size_t lines_ = 0;
     };
 
     Editor(int32_t width, int32_t height, int32_t lineHeight, int32_t fontAdvance = 0, int32_t showWordsOffset = 0);
 
     void init(const std::string& path);
+    void follow(const std::string& path);
+    void follow(std::shared_ptr<MappedFile> file);
+    void hex(const std::string& path);
+    void hex(std::shared_ptr<MappedFile> file);
+    void table(const std::string& path);
+    void table(bool show);
+    bool sortTable(const std::string& column, bool descending);
+    void scrollTable();
+    void opened(const std::string& path);
+    bool reload();
+    void reopen();
+    void rebaseRecovery();
+    bool followTail();
+    void freezeCold();
+    void publish();
+    std::shared_ptr<const PieceTable> snapshot() const;
     Mode mode() const;
     void enter();
     void backspace();
@@ -49,20 +106,69 @@ public:
     void moveRightWord();
     void moveLeftSpace();
     void moveLeftWord();
+    size_t runBefore(bool space) const;
+    size_t runAfter(bool space) const;
     void rmCopyLine();
     void adjustCursor();
     void moveCursor(Direction dir);
     void setCursor(glm::ivec2 cursorPos);
     void moveLimit();
-    bool lineEmpty(const std::string& line);
+    bool lineEmpty(int32_t line) const;
+    size_t lineCount() const;
+    size_t lineSize(int32_t line) const;
+    char charAt(int32_t line, int32_t column) const;
+    std::string line(int32_t line) const;
+    std::vector<std::string> lines(int32_t first, int32_t last) const;
+    size_t offset(glm::ivec2 pos) const;
+    const Layout& layout(int32_t line) const;
+    const std::vector<uint32_t>& graphemes(int32_t line) const;
+    int32_t column(glm::ivec2 pos) const;
+    int32_t columnOffset(int32_t line, int32_t column) const;
+    void editLayouts(size_t offset, size_t erase, std::string_view insert);
+    void setTabWidth(int32_t width);
+    void setWrap(bool wrap);
+    bool wrapped() const;
+    void rewrap();
+    void linesEdited(size_t offset, size_t length, int64_t shift);
+    int32_t wrapRow(int32_t line, int32_t column) const;
+    std::vector<Row> showRows() const;
+    bool folded() const;
+    bool toggleFold();
+    void fold(int32_t first, int32_t last);
+    void unfold();
+    size_t foldedAt(int32_t line) const;
+    bool readOnly() const;
+    static PieceTable decode(const MappedFile& file, Transcode::Format format);
+    glm::ivec2 position(size_t offset) const;
+    void insertText(size_t offset, std::string_view text);
+    void eraseText(size_t offset, size_t length);
+    void applyText(size_t offset, size_t erase, std::string_view insert, bool local = true);
+    void insertRange(size_t offset, std::string_view text);
+    void eraseRange(size_t offset, size_t length);
+    void addCursorsAtMatches();
+    void addCursorsOnLines(int32_t first, int32_t last);
+    void clearCursors(bool all = true);
+    bool multiCursor() const;
+    std::vector<glm::ivec2> visibleCursors() const;
+    void editCursors(size_t erase, std::string_view insert);
+    void undo();
+    void redo();
     void adjust(int32_t width, int32_t height);
     glm::ivec2 cursorRenderPos(int32_t offsetX, int32_t fontAdvance);
+    glm::ivec2 renderPos(glm::ivec2 pos, int32_t offsetX, int32_t fontAdvance);
     bool empty();
     Editor::Limit showLimit();
     glm::ivec2 posToScreenPos(glm::ivec2 pos);
     glm::ivec2 searchStr(const std::string& str);
+    glm::ivec2 searchNext();
+    glm::ivec2 searchPrev();
+    int64_t substitute(const std::string& pattern, const std::string& replacement);
+    int64_t lineOp(LineOps::Op op, const std::string& pattern, int32_t first = 0, int32_t last = -1);
+    Stats stats() const;
+    std::string status() const;
     bool save();
-    bool save(const std::string& fileName);
+    bool save(const std::string& fileName, bool force = false);
+    bool update();
     void setMode(Mode mode);
     void newLine(); // huan hang
     glm::ivec2 nextCharPosition(int32_t offsetX, int32_t fontAdvance);
@@ -73,9 +179,60 @@ public:
     int32_t lineHeight_;
     int32_t fontAdvance_;
     int32_t currLine_ = 0;
-    std::vector<std::string> lines_;
+    PieceTable document_;
+    // document_ as of its last change, for other threads to read without locks
+    std::atomic<std::shared_ptr<const PieceTable>> published_;
+    // set instead of document_ for files of at least pagedThreshold_ bytes
+    std::shared_ptr<PagedDocument> paged_;
+    size_t pagedThreshold_ = 256ull << 20;
+    // set instead of document_ while a file is shown as a hex dump
+    std::shared_ptr<HexView> hex_;
+    // set over the document while it is shown as a table; a line is a row,
+    // cursorPos_.x the cell within it and tableColumn_ the first shown column
+    std::shared_ptr<CsvTable> table_;
+    size_t tableColumn_ = 0;
+    // set while following a file that is appended to, see follow()
+    std::shared_ptr<LogTail> tail_;
+    std::string tailBuffer_;
+    size_t tailBudget_ = 8 << 20;
+    // encoding of the file on disk; document_ always holds UTF-8
+    Transcode::Format format_;
+    UndoJournal journal_;
+    std::shared_ptr<SaveEngine> saver_;
+    // unsaved edits, replayed when the same file is opened after a crash
+    std::shared_ptr<RecoveryJournal> recovery_;
+    // set while the open file is watched for changes other processes make
+    std::shared_ptr<FileSync> sync_;
+    // the mapping init() made the original buffer, while it is one
+    std::weak_ptr<MappedFile> mapped_;
+    // the file changed where it could not be merged with the unsaved edits;
+    // save() does not write over it unless forced
+    bool diverged_ = false;
+    // saves of fileName_ not finished yet; a change seen meanwhile is theirs
+    size_t saving_ = 0;
+    // matches of the last searched string
+    TextSearch search_;
+    // document_.pieces() as of the last search, valid until the next edit
+    std::vector<std::string_view> searchPieces_;
+    bool searchPiecesValid_ = false;
+    // added text this far from the screen is compressed, coldPack_ chunks a frame
+    size_t coldMargin_ = 4 << 20;
+    size_t coldPack_ = 2;
+    int32_t tabWidth_ = 4;
+    static constexpr int32_t maxTabWidth_ = 32;
+    // layouts of the lines the cursor or the renderer asked for, by line
+    mutable std::map<int32_t, Layout> layouts_;
+    static constexpr size_t maxLayouts_ = 4096;
+    // lines wrap at showWords_ columns; wrap_ holds their rows while they do
+    bool wrapping_ = false;
+    WrapIndex wrap_;
+    // lines hidden under closed folds are skipped on screen and by the cursor
+    FoldIndex folds_;
+    std::function<void(bool ok, const std::string& path)> onSaved_;
     glm::ivec2 cursorPos_ = {0, 0};
     glm::ivec2 cursorPosTrue_ = {};
+    // offsets of the cursors besides cursorPos_, sorted
+    std::vector<size_t> cursors_;
     glm::ivec2 screen_;
     int32_t showLines_;
     int32_t showWords_;
@@ -83,7 +240,6 @@ public:
     Limit limit_{};
     int32_t lineNumberOffset_ = 0;
     int showLinesOffset_ = 1;
-    unsigned long long wordCount_ = 0;
     std::string fileName_;
     std::string copyLine_;
 };
\ No newline at end of file
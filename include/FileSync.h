@@ -0,0 +1,130 @@
+#pragma once
+
+#include "FileWatcher.h"
+#include "MappedFile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Keeps an open document in step with its file when another process changes
+// it. The file is remembered as hashes of chunkSize_ byte chunks; after the
+// watcher reports something, the file now at the path is hashed again and
+// compared from both ends, so a change is found as the one byte range that
+// differs without holding a copy of the file. Edits made in the editor are
+// kept as hunks lining the document up with the file, which tell where a
+// change to the file lands in the document and whether it collides with an
+// unsaved edit.
+//
+// Offsets into the file are base offsets: file offsets less skip bytes (a
+// byte order mark), as the document counts them.
+class FileSync {
+public:
+    enum Status : uint8_t {
+        Unchanged,
+        // one range differs, see Change
+        Changed,
+        // changed in a way the document cannot follow: written over in place,
+        // its mark changed, or only watched
+        Rewritten,
+        // written over in place and shorter: the mapping reaches past the end
+        // of the file, and reading there faults
+        Truncated,
+        // nothing is at the path
+        Missing,
+    };
+
+    // base bytes [begin_, end_) became text_, which stays valid until the
+    // next compare()
+    struct Change {
+        size_t begin_ = 0;
+        size_t end_ = 0;
+        std::string_view text_;
+    };
+
+    // base [baseBegin_, baseEnd_) reads as document [docBegin_, docEnd_) does
+    struct Hunk {
+        size_t baseBegin_ = 0;
+        size_t baseEnd_ = 0;
+        size_t docBegin_ = 0;
+        size_t docEnd_ = 0;
+    };
+
+    // without a file, changes are only reported as Rewritten. The file is
+    // hashed on a worker thread; threads = 0 uses every core
+    FileSync(const std::string& path, std::shared_ptr<MappedFile> file = nullptr, size_t skip = 0, size_t threads = 0);
+    FileSync(const FileSync&) = delete;
+    FileSync& operator=(const FileSync&) = delete;
+    ~FileSync();
+
+    // non-blocking; true when the file may have changed since the last compare()
+    bool poll();
+    // on Changed the file at the path becomes the one kept in step with
+    Status compare(Change& change);
+    // the file as the document was last written to it; unsaved edits are kept
+    void reset(std::shared_ptr<MappedFile> file);
+
+    // replaces erase document bytes at offset with insert bytes
+    void edited(size_t offset, size_t erase, size_t insert);
+    // where the change lands in the document, false when it meets an edit;
+    // the hunks then take the change in and the document is left as it is
+    bool merge(const Change& change, size_t& docBegin, size_t& docEnd);
+    // the document as it is now is being written to the file
+    void saving();
+    // how the document of documentSize bytes lines up with the file is no
+    // longer known: every change collides
+    void mismatch(size_t documentSize);
+    bool clean() const;
+    const std::vector<Hunk>& hunks() const;
+    // the file as of the last compare() or reset()
+    const std::shared_ptr<MappedFile>& file() const;
+
+    static uint64_t hash(const char* data, size_t size);
+
+    static constexpr size_t chunkSize_ = 64 << 10;
+    // chunks compared in one round on all threads, at most
+    static constexpr size_t maxBatch_ = 1024;
+
+private:
+    struct Chunk {
+        size_t offset_ = 0;
+        size_t size_ = 0;
+        uint64_t hash_ = 0;
+    };
+
+    // tells a file written over in place, which keeps device and inode, from
+    // one renamed over the path
+    struct Identity {
+        uint64_t device_ = 0;
+        uint64_t inode_ = 0;
+        uint64_t size_ = 0;
+        int64_t mtime_ = 0;
+
+        bool operator==(const Identity&) const = default;
+    };
+
+    void watch();
+    void wait();
+    void replace(std::shared_ptr<MappedFile> file);
+    bool identify(Identity& identity) const;
+    size_t run(std::string_view data, size_t begin, size_t end, bool backward, size_t delta, size_t floor) const;
+    std::vector<Chunk> hashChunks(std::string_view data, size_t begin, size_t end) const;
+    size_t shift(size_t index) const;
+
+    std::string path_;
+    std::unique_ptr<FileWatcher> watcher_;
+    std::shared_ptr<MappedFile> file_;
+    size_t skip_;
+    size_t threads_;
+    Identity identity_;
+    // cover file_ end to end
+    std::vector<Chunk> chunks_;
+    // hashes the file opened, or lets go of the one replaced
+    std::thread worker_;
+    // sorted and disjoint
+    std::vector<Hunk> hunks_;
+};
\ No newline at end of file
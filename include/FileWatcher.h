@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Reports changes to one file without blocking: inotify on Linux, elsewhere a
+// look at the file's size and modification time on every poll().
+class FileWatcher {
+public:
+    enum Event : uint8_t {
+        None = 0,
+        // the contents or the attributes changed
+        Modified = 1,
+        // the file was deleted or renamed; the path may name another file now
+        Replaced = 2,
+    };
+
+    FileWatcher(const std::string& path);
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+    ~FileWatcher();
+
+    bool valid() const;
+    // the events since the last call, or-ed together
+    uint8_t poll();
+
+private:
+    std::string path_;
+#ifdef __linux__
+    int fd_ = -1;
+    int watch_ = -1;
+#else
+    bool exists_ = false;
+    uint64_t size_ = 0;
+    int64_t mtime_ = 0;
+#endif
+};
\ No newline at end of file
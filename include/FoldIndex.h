@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Fold ranges of lines, nested or not, in an interval treap ordered by first
+// line, outer folds before inner ones starting on the same line. Every node
+// keeps the greatest last line of its subtree, over all folds and over the
+// closed ones, so whether a line is hidden, the next line shown, or the fold
+// around a line is found in O(log n), however many lines a fold spans, and
+// opening or closing one is a path update. Lines after an edit move by a
+// shift left pending on the subtree they lead, so an edit costs O(log n)
+// besides the folds it cuts through.
+//
+// A fold shows its first line and hides the rest.
+class FoldIndex {
+public:
+    struct Fold {
+        size_t first_ = 0;
+        size_t last_ = 0;
+        bool closed_ = false;
+        // made by hand rather than derived from the text
+        bool manual_ = false;
+    };
+
+    FoldIndex() = default;
+    FoldIndex(const FoldIndex&) = delete;
+    FoldIndex& operator=(const FoldIndex&) = delete;
+
+    // a fold of lines first..last, or the one there already, closed or not
+    void add(size_t first, size_t last, bool closed, bool manual);
+    // opens the closed folds starting on line, or else closes the innermost
+    // fold around it; false when there is neither
+    bool toggle(size_t line);
+    // opens every closed fold hiding line
+    void reveal(size_t line);
+    void openAll();
+    void clear();
+    // the derived folds replaced by the ones the text's braces make, or its
+    // indentation when it has none; manual folds stay
+    void derive(const std::vector<std::string_view>& pieces, int32_t tabWidth);
+    bool derived() const;
+    // lines first..lo became first..ln; lines after lo move with the shift
+    void edited(size_t first, size_t lo, size_t ln);
+
+    bool empty() const;
+    bool closed() const;
+    bool hidden(size_t line) const;
+    // the first line shown from line on
+    size_t next(size_t line) const;
+    // the line shown for line: itself, or the first line of the fold hiding it
+    size_t shown(size_t line) const;
+    std::vector<Fold> folds() const;
+
+    // the lines from one with an opening brace to the one with its closing
+    // brace, comments and literals skipped
+    static std::vector<Fold> braces(const std::vector<std::string_view>& pieces);
+    // the lines from one to the last after it indented deeper, blank lines
+    // between them included
+    static std::vector<Fold> indents(const std::vector<std::string_view>& pieces, int32_t tabWidth);
+
+private:
+    struct Node;
+    using Tree = std::unique_ptr<Node>;
+
+    struct Node {
+        Fold fold_;
+        Tree left_;
+        Tree right_;
+        uint32_t priority_ = 0;
+        // over the subtree, 0 when there is none: a fold's last line is
+        // after its first
+        size_t maxLast_ = 0;
+        size_t maxClosedLast_ = 0;
+        // lines the subtrees are still to move by
+        int64_t shift_ = 0;
+    };
+
+    Tree newNode(const Fold& fold);
+    static void apply(Node& node, int64_t shift);
+    static void push(Node& node);
+    static void update(Node& node);
+    static Tree merge(Tree a, Tree b);
+    // l takes the folds ordered before the one of first..last, r the rest
+    static void split(Tree t, size_t first, size_t last, Tree& l, Tree& r);
+    static bool openAt(Node* t, size_t line);
+    static bool closeAround(Node* t, size_t line);
+    static void reveal(Node* t, size_t line);
+    static Tree cut(Tree t, size_t first, size_t lo, size_t ln, std::vector<Fold>& moved);
+    void place(const Fold& fold, bool set = false);
+    static void collect(const Node* t, int64_t shift, std::vector<Fold>& out);
+    size_t hiddenTo(size_t line) const;
+    static size_t header(const Node* t, int64_t shift, size_t line);
+    void build(const std::vector<Fold>& folds);
+
+    Tree root_;
+    bool derived_ = false;
+    uint32_t seed_ = 2463534242u;
+};
\ No newline at end of file
@@ -17,6 +17,8 @@
 #include "Grammar.h"
 #include "vulkan/vulkan_core.h"
 #include "Timer.h"
+#include "Utf8.h"
+#include "HexView.h"
 
 #include <ft2build.h>
 #include <utility>
@@ -91,7 +93,7 @@ public:
 
     struct Character {
         Character() {}
-        char char_{};
+        char32_t char_{};
         // left top point
         int offsetX_{};
         int offsetY_{};
@@ -171,45 +173,24 @@ public:
 
     
 
-    static std::pair<std::vector<Font::Point>, std::vector<uint32_t>> genTextLine(float x, float y, const std::string& line, const std::unordered_map<char, Character>& dictionary, const Grammar* const grammar) {
-        auto s = Timer::nowMilliseconds();
-        std::pair<std::vector<Font::Point>, std::vector<uint32_t>> result;
-        unsigned long long v = 0, m = 0;
-        bool isSpace_ = false;
-        for (size_t i = 0; i < line.size(); i++) {
-            glm::vec2 center;
-            center.x = x + dictionary.at(line[i]).offsetX_ + dictionary.at(line[i]).width_ / 2.0f;
-            center.y = y + dictionary.at(line[i]).offsetY_ - dictionary.at(line[i]).height_ / 2.0f;
-
-            auto t = Font::vertices(center.x, center.y, dictionary.at(line[i]), dictionary.at(line[i]).color_);
-
-            mergeVerticesDefine(result, t);
+    // the glyph of c, U+FFFD for a code point the dictionary does not hold
+    static const Character& glyph(const std::unordered_map<char32_t, Character>& dictionary, char32_t c) {
+        auto it = dictionary.find(c);
 
-            x += dictionary.at(line[i]).advance_;
-        }
-        // color
-        if (grammar != nullptr) {
-            auto wordColor = grammar->parseLine(line);
-            for (auto& word : wordColor) {
-                auto begin = word.first.first;
-                auto size = word.first.second;
-                auto color = word.second;
-                for (int i = begin * 4; i < (begin + size) * 4; i++) {
-                    result.first[i].color_ = color;
-                }
-            }
-        }
+        return it != dictionary.end() ? it->second : dictionary.at(Utf8::replacement);
+    }
 
-        return result;
+    static std::pair<std::vector<Font::Point>, std::vector<uint32_t>> genTextLine(float x, float y, const std::string& line, const std::unordered_map<char32_t, Character>& dictionary, const Grammar* const grammar, int32_t tabWidth = 4) {
+        return genTextLine(x, y, line, dictionary, grammar, 0, INT32_MAX, tabWidth);
     }
 
-    static std::pair<std::vector<Font::Point>, std::vector<uint32_t>> genTextLines(float x, float y, uint32_t lineHeight, const std::vector<std::string>& lines, const std::unordered_map<char, Character>& dictionary, const Grammar* const grammar) {
+    static std::pair<std::vector<Font::Point>, std::vector<uint32_t>> genTextLines(float x, float y, uint32_t lineHeight, const std::vector<std::string>& lines, const std::unordered_map<char32_t, Character>& dictionary, const Grammar* const grammar, int32_t tabWidth = 4) {
         std::pair<std::vector<Font::Point>, std::vector<uint32_t>> result;
 
         unsigned long long g = 0, m = 0;
         for (auto& line : lines) {
             // auto s = Timer::nowMilliseconds();
-            auto pointAndIndex = Font::genTextLine(x, y, line, dictionary, grammar);
+            auto pointAndIndex = Font::genTextLine(x, y, line, dictionary, grammar, tabWidth);
             // auto e = Timer::nowMilliseconds();
             // g += e - s;
             
@@ -225,21 +206,42 @@ public:
         return result;
     }
 
-    static std::pair<std::vector<Font::Point>, std::vector<uint32_t>> genTextLine(float x, float y, const std::string& line, const std::unordered_map<char, Character>& dictionary, const Grammar* const grammar, int32_t leftLimit, int32_t rightLimit) {
-        auto s = Timer::nowMilliseconds();
+    // one glyph per grapheme cluster, drawn with its first code point; a tab
+    // draws nothing and reaches to the next multiple of tabWidth columns, the
+    // limits are columns
+    static std::pair<std::vector<Font::Point>, std::vector<uint32_t>> genTextLine(float x, float y, const std::string& line, const std::unordered_map<char32_t, Character>& dictionary, const Grammar* const grammar, int32_t leftLimit, int32_t rightLimit, int32_t tabWidth = 4) {
         std::pair<std::vector<Font::Point>, std::vector<uint32_t>> result;
-        unsigned long long v = 0, m = 0;
-        bool isSpace_ = false;
-        for (size_t i = leftLimit; i < line.size() && i < rightLimit; i++) {
-            glm::vec2 center;
-            center.x = x + dictionary.at(line[i]).offsetX_ + dictionary.at(line[i]).width_ / 2.0f;
-            center.y = y + dictionary.at(line[i]).offsetY_ - dictionary.at(line[i]).height_ / 2.0f;
+        // the glyph drawn for every byte of line, -1 where it is not drawn
+        std::vector<int32_t> glyphs(line.size(), -1);
+        int32_t column = 0, drawn = 0;
+        for (size_t i = 0; i < line.size() && column < rightLimit; column++) {
+            if (line[i] == '\t') {
+                auto stop = (column / tabWidth + 1) * tabWidth;
+                if (stop > leftLimit) {
+                    x += (stop - std::max(column, leftLimit)) * glyph(dictionary, ' ').advance_;
+                }
+                // the loop counts the last column
+                column = stop - 1;
+                i++;
+                continue;
+            }
+
+            size_t length;
+            auto& character = glyph(dictionary, Utf8::decode(line, i, length));
+            auto end = Utf8::next(line, i);
+            if (column >= leftLimit) {
+                glm::vec2 center;
+                center.x = x + character.offsetX_ + character.width_ / 2.0f;
+                center.y = y + character.offsetY_ - character.height_ / 2.0f;
 
-            auto t = Font::vertices(center.x, center.y, dictionary.at(line[i]), dictionary.at(line[i]).color_);
+                auto t = Font::vertices(center.x, center.y, character, character.color_);
 
-            mergeVerticesDefine(result, t);
+                mergeVerticesDefine(result, t);
 
-            x += dictionary.at(line[i]).advance_;
+                x += character.advance_;
+                std::fill(glyphs.begin() + i, glyphs.begin() + end, drawn++);
+            }
+            i = end;
         }
         // color
         if (grammar != nullptr) {
@@ -248,8 +250,13 @@ public:
                 auto begin = word.first.first;
                 auto size = word.first.second;
                 auto color = word.second;
-                for (int i = begin * 4; i < (begin + size) * 4; i++) {
-                    result.first[i].color_ = color;
+                for (int i = begin; i < begin + size && i < glyphs.size(); i++) {
+                    if (glyphs[i] < 0) {
+                        continue;
+                    }
+                    for (int j = glyphs[i] * 4; j < (glyphs[i] + 1) * 4; j++) {
+                        result.first[j].color_ = color;
+                    }
                 }
             }
         }
@@ -257,12 +264,12 @@ public:
         return result;
     }
 
-    static std::pair<std::vector<Font::Point>, std::vector<uint32_t>> genTextLines(float x, float y, uint32_t lineHeight, const std::vector<std::string>& lines, const std::unordered_map<char, Character>& dictionary, const Grammar* const grammar, int32_t leftLimit, int32_t rightLimit) {
+    static std::pair<std::vector<Font::Point>, std::vector<uint32_t>> genTextLines(float x, float y, uint32_t lineHeight, const std::vector<std::string>& lines, const std::unordered_map<char32_t, Character>& dictionary, const Grammar* const grammar, int32_t leftLimit, int32_t rightLimit, int32_t tabWidth = 4) {
         std::pair<std::vector<Font::Point>, std::vector<uint32_t>> result;
 
         unsigned long long g = 0, m = 0;
         for (auto& line : lines) {
-            auto pointAndIndex = Font::genTextLine(x, y, line, dictionary, grammar, leftLimit, rightLimit);
+            auto pointAndIndex = Font::genTextLine(x, y, line, dictionary, grammar, leftLimit, rightLimit, tabWidth);
 
             mergeVerticesDefine(result, pointAndIndex);
 
@@ -272,9 +279,77 @@ public:
         return result;
     }
 
-    static std::vector<Font::Point> genOneChar(float x, float y, uint32_t lineHeight, char c, const std::unordered_map<char, Character>& dictionary) {
+    // rows of wrapped lines, each a line of lines and the column its row
+    // starts at, drawn width columns wide
+    static std::pair<std::vector<Font::Point>, std::vector<uint32_t>> genTextRows(float x, float y, uint32_t lineHeight, const std::vector<std::string>& lines, const std::vector<std::pair<size_t, int32_t>>& rows, int32_t width, const std::unordered_map<char32_t, Character>& dictionary, const Grammar* const grammar, int32_t tabWidth = 4) {
+        std::pair<std::vector<Font::Point>, std::vector<uint32_t>> result;
+
+        for (auto& [line, column] : rows) {
+            auto pointAndIndex = Font::genTextLine(x, y, lines[line], dictionary, grammar, column, column + width, tabWidth);
+
+            mergeVerticesDefine(result, pointAndIndex);
+
+            y -= lineHeight;
+        }
+
+        return result;
+    }
+
+    // rows [first, last) of a hex view, formatted one at a time into a buffer
+    // on the stack and turned into quads in place; every column is as wide as
+    // a space, the offsets and the bytes that are not printable are grey
+    static void genHexRows(float x, float y, uint32_t lineHeight, const HexView& view, size_t first, size_t last, const std::unordered_map<char32_t, Character>& dictionary, std::pair<std::vector<Font::Point>, std::vector<uint32_t>>& result) {
+        const Character* glyphs[128];
+        for (char32_t c = 0; c < 128; c++) {
+            glyphs[c] = &glyph(dictionary, c);
+        }
+        auto advance = glyphs[' ']->advance_;
+        const glm::vec3 grey(0.55f, 0.55f, 0.55f);
+
+        char text[128];
+        auto width = std::min(view.width(), sizeof(text));
+        last = std::min(last, view.rows());
+        if (first >= last) {
+            return ;
+        }
+        result.first.reserve(result.first.size() + (last - first) * width * 4);
+        result.second.reserve(result.second.size() + (last - first) * width * 6);
+        for (auto row = first; row < last; row++, y -= lineHeight) {
+            auto length = std::min(view.format(row, text), width);
+            auto bytes = view.view().substr(row * HexView::bytesPerRow_, HexView::bytesPerRow_);
+            bool dim[sizeof(text)] = {};
+            std::fill(dim, dim + view.hexColumn(0), true);
+            for (size_t i = 0; i < bytes.size(); i++) {
+                auto byte = static_cast<unsigned char>(bytes[i]);
+                dim[view.hexColumn(i)] = dim[view.hexColumn(i) + 1] = byte == 0;
+                dim[view.asciiColumn(i)] = byte < 0x20 || byte >= 0x7f;
+            }
+            for (size_t column = 0; column < length; column++) {
+                auto c = static_cast<unsigned char>(text[column]);
+                if (c == ' ' || c >= 128) {
+                    continue;
+                }
+
+                auto color = dim[column] ? grey : glyphs[c]->color_;
+                auto& character = *glyphs[c];
+                auto cx = x + column * advance + character.offsetX_ + character.width_ / 2.0f;
+                auto cy = y + character.offsetY_ - character.height_ / 2.0f;
+                auto w2 = character.width_ / 2.0f, h2 = character.height_ / 2.0f;
+                auto base = static_cast<uint32_t>(result.first.size());
+                result.first.emplace_back(cx - w2, cy + h2, color.x, color.y, color.z, 0.0f, 0.0f, character.index_);
+                result.first.emplace_back(cx + w2, cy + h2, color.x, color.y, color.z, 1.0f, 0.0f, character.index_);
+                result.first.emplace_back(cx - w2, cy - h2, color.x, color.y, color.z, 0.0f, 1.0f, character.index_);
+                result.first.emplace_back(cx + w2, cy - h2, color.x, color.y, color.z, 1.0f, 1.0f, character.index_);
+                for (auto index : {0u, 1u, 2u, 2u, 1u, 3u}) {
+                    result.second.push_back(base + index);
+                }
+            }
+        }
+    }
+
+    static std::vector<Font::Point> genOneChar(float x, float y, uint32_t lineHeight, char32_t c, const std::unordered_map<char32_t, Character>& dictionary) {
         glm::ivec2 center;
-        auto& word = dictionary.at(c);
+        auto& word = glyph(dictionary, c);
 
         center.x = x + word.offsetX_ + word.width_ / 2.0f;
         center.y = y + word.offsetY_ - lineHeight / 2.0f;
@@ -282,7 +357,7 @@ public:
         return Font::vertices(center.x, center.y, word, word.color_).first;
     }
 
-    void loadChar(char c);
+    void loadChar(char32_t c);
     void renderMode(FT_Render_Mode mode);
     FT_Bitmap bitmap() { return face_->glyph->bitmap; }
     FT_GlyphSlot glyph() { return face_->glyph; }
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "MappedFile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Read-only hex dump of a mapped file, bytesPerRow_ bytes a row laid out as
+//   <offset>  xx xx xx xx xx xx xx xx  xx xx xx xx xx xx xx xx  <ascii>
+// Rows are formatted straight from the mapping when they are shown, so the
+// cost of a frame does not depend on the size of the file.
+class HexView {
+public:
+    static constexpr size_t bytesPerRow_ = 16;
+
+    HexView(std::shared_ptr<MappedFile> file);
+
+    size_t size() const;
+    size_t rows() const;
+    std::string_view view() const;
+    const std::string& path() const;
+
+    // characters of a formatted row
+    size_t width() const;
+    // the column of byte i of a row in the hex and the ASCII part
+    size_t hexColumn(size_t i) const;
+    size_t asciiColumn(size_t i) const;
+    // writes row into out, which holds width() characters, and returns how many
+    // it wrote; the last row may be short
+    size_t format(size_t row, char* out) const;
+    std::string row(size_t row) const;
+
+    // NUL bytes are the mark of a binary file, as they are for git and diff
+    static bool binary(std::string_view head);
+
+private:
+    std::shared_ptr<MappedFile> file_;
+    size_t digits_ = 8;
+};
\ No newline at end of file
@@ -11,7 +11,13 @@ public:
     void adjust(const Editor& editor);
     void adjustCursor(const Editor& editor);
     void addLineNumber(std::string& line, int32_t lineNumber);
+    Editor::Limit showLimit();
+    std::vector<std::string> showLines();
 
 public:
     int32_t lineNumberOffset_ = 5;
+    size_t lineCount_ = 1;
+    unsigned long long wordCount_ = 0;
+    // the editor's screen rows while its lines wrap or fold
+    std::vector<Editor::Row> rows_;
 };
\ No newline at end of file
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "Regex.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// :sort, :uniq, :grep, :vgrep and :reverse. The lines of the range are
+// handles into one copy of its text; the handles are sorted, filtered or
+// reversed on worker threads and the result is assembled in parallel into
+// the text that replaces the range as a single edit.
+struct LineOps {
+    enum Op : uint8_t {
+        // byte order
+        Sort,
+        // drops a line equal to the one before it
+        Uniq,
+        // keeps the lines with a match
+        Grep,
+        // keeps the lines without one
+        VGrep,
+        Reverse,
+    };
+
+    // the lines of text after op; a line feed ending text ends the result too.
+    // regex is only read by Grep and VGrep, threads = 0 uses every core
+    static std::string run(std::string_view text, Op op, const Regex* regex = nullptr, size_t threads = 0);
+
+    static constexpr size_t chunkSize_ = 4 << 20;
+    static constexpr size_t lineBlock_ = 1 << 16;
+};
\ No newline at end of file
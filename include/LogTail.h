@@ -0,0 +1,47 @@
+#pragma once
+
+#include "FileWatcher.h"
+
+#include <cstddef>
+#include <string>
+
+// Follows a file that is only appended to, such as a live log. read() hands
+// over what was added since the last call, at most budget bytes at a time so
+// a fast writer is caught up with over several frames. A file that shrank or
+// was replaced has to be read again from the start.
+class LogTail {
+public:
+    enum Status {
+        Idle,
+        Appended,
+        Restart,
+    };
+
+    // offset is how much of the file the caller already has
+    LogTail(const std::string& path, size_t offset);
+    LogTail(const LogTail&) = delete;
+    LogTail& operator=(const LogTail&) = delete;
+    ~LogTail();
+
+    bool valid() const;
+    Status read(std::string& out, size_t budget);
+    size_t offset() const;
+
+private:
+    bool size(size_t& size) const;
+    bool replaced() const;
+    bool readAt(char* data, size_t length, size_t offset) const;
+
+    std::string path_;
+    FileWatcher watcher_;
+    size_t offset_;
+    // the last read stopped at budget, so there is more without an event
+    bool behind_ = true;
+    // once the file shrank or was replaced every read says Restart
+    bool restart_ = false;
+#ifdef _WIN32
+    void* file_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+};
\ No newline at end of file
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// A byte-oriented LZ77 codec for cold text: fast to decode, and strong on
+// the repeated fields of log lines. A sequence is a token byte holding the
+// literal count and the match length minus minMatch_ in four bits each (15
+// meaning more length bytes follow), the literals, a two byte little endian
+// offset back into the output and the rest of the match length. The last
+// sequence has literals only.
+struct Lz {
+
+static std::string compress(std::string_view data);
+// false when packed does not decode to exactly size bytes
+static bool decompress(std::string_view packed, char* out, size_t size);
+
+static constexpr size_t minMatch_ = 4;
+static constexpr size_t window_ = 65535;
+static constexpr size_t hashBits_ = 14;
+static constexpr size_t ways_ = 4;
+};
\ No newline at end of file
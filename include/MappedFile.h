@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Read-only view of a whole file: a copy for files up to copyLimit_ bytes, a
+// memory mapping for larger ones.
+//
+// A mapping is not a snapshot. Another process writing the file in place
+// changes the bytes under it, pages read before included, and shortening the
+// file makes a read past its new end fault with SIGBUS. Such a fault on a
+// mapped file is caught: the page reads as zeros from then on and truncated()
+// tells it happened, so the change is noticed rather than the editor killed.
+// Windows refuses to shorten a file while it is mapped.
+class MappedFile {
+public:
+    MappedFile(const std::string& path);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    bool valid() const { return valid_; }
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    std::string_view view() const { return {data_, size_}; }
+    // a mapping rather than a copy
+    bool mapped() const { return data_ != nullptr && copy_ == nullptr; }
+    const std::string& path() const { return path_; }
+    // part of the mapping was cut off by the file getting shorter
+    bool truncated() const { return truncated_; }
+    void release(size_t offset, size_t length) const;
+
+    static constexpr size_t copyLimit_ = 64 << 20;
+
+private:
+    std::string path_;
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool valid_ = false;
+    // the copy, for a file of at most copyLimit_ bytes
+    std::unique_ptr<char[]> copy_;
+    std::atomic<bool> truncated_ = false;
+#ifdef _WIN32
+    void* file_ = nullptr;
+    void* mapping_ = nullptr;
+#endif
+};
\ No newline at end of file
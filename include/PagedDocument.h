@@ -0,0 +1,70 @@
+#pragma once
+
+#include "MappedFile.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Read-only view of a very large file. A background thread records the byte
+// offset of every pageLines_-th line; pages of lines are materialized from the
+// mapping only when asked for and the least recently used ones are dropped.
+class PagedDocument {
+public:
+    PagedDocument(std::shared_ptr<MappedFile> file, size_t maxPages = 64);
+    PagedDocument(const PagedDocument&) = delete;
+    PagedDocument& operator=(const PagedDocument&) = delete;
+    ~PagedDocument();
+
+    bool indexed() const;
+    size_t size() const;
+    size_t lineCount() const;
+    size_t chars() const;
+    size_t words() const;
+    size_t lineLength(size_t line);
+    char at(size_t line, size_t column);
+    std::string line(size_t line);
+    std::vector<std::string> lines(size_t first, size_t last);
+    size_t lineStart(size_t line);
+    size_t lineOf(size_t offset);
+    std::string_view view() const;
+    const std::string& path() const;
+
+    static constexpr size_t pageLines_ = 1024;
+
+private:
+    struct Page {
+        std::string text_;
+        std::vector<uint32_t> starts_;
+        uint64_t lastUse_ = 0;
+    };
+
+    void index();
+    void indexChunk(size_t begin, size_t end, std::vector<size_t>& scratch);
+    Page& page(size_t number);
+    void evict();
+
+    std::shared_ptr<MappedFile> file_;
+    size_t maxPages_;
+
+    std::mutex mutex_;
+    std::vector<size_t> pageStarts_;
+    size_t pendingLines_ = 0;
+    std::atomic<size_t> lineFeeds_ = 0;
+    // counted by the indexer too, final once indexed_
+    std::atomic<size_t> chars_ = 0;
+    std::atomic<size_t> words_ = 0;
+    std::atomic<bool> indexed_ = false;
+    std::atomic<bool> stop_ = false;
+    std::thread indexer_;
+
+    std::unordered_map<size_t, Page> pages_;
+    uint64_t tick_ = 0;
+};
\ No newline at end of file
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// A worker pool: the calling thread and threads - 1 others take item indices
+// from a shared counter until none are left.
+struct Parallel {
+
+// threads = 0 is every core
+static size_t threads(size_t requested) {
+    return requested == 0 ? std::max(1u, std::thread::hardware_concurrency()) : requested;
+}
+
+// work(i) for every i < count, in no particular order
+template <typename Work>
+static void forEach(size_t count, size_t threads, Work work) {
+    forEach(count, threads, [] { return 0; }, [&](int, size_t i) {
+        work(i);
+    });
+}
+
+// the same with state each thread makes once with make() and hands to every
+// work(state, i) it runs, such as a matcher and its caches
+template <typename Make, typename Work>
+static void forEach(size_t count, size_t threads, Make make, Work work) {
+    threads = std::min(Parallel::threads(threads), count);
+
+    std::atomic<size_t> next = 0;
+    auto run = [&]() {
+        auto state = make();
+        for (auto i = next++; i < count; i = next++) {
+            work(state, i);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < threads; i++) {
+        workers.emplace_back(run);
+    }
+    run();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+// a stable merge sort: runs sorted on worker threads, then merged in pairs,
+// a round of merges at a time
+template <typename T, typename Less>
+static void sort(std::vector<T>& items, size_t begin, Less less, size_t threads) {
+    auto count = items.size() - begin;
+    auto runs = std::max<size_t>(std::min(Parallel::threads(threads), count / minRun_), 1);
+    std::vector<size_t> bounds;
+    for (size_t i = 0; i <= runs; i++) {
+        bounds.push_back(begin + count * i / runs);
+    }
+    forEach(runs, threads, [&](size_t i) {
+        std::stable_sort(items.begin() + bounds[i], items.begin() + bounds[i + 1], less);
+    });
+    if (runs == 1) {
+        return ;
+    }
+
+    std::vector<T> merged(items.size());
+    for (size_t width = 1; width < runs; width *= 2) {
+        auto pairs = (runs + 2 * width - 1) / (2 * width);
+        forEach(pairs, threads, [&](size_t i) {
+            auto low = bounds[2 * width * i];
+            auto middle = bounds[std::min(2 * width * i + width, runs)];
+            auto high = bounds[std::min(2 * width * (i + 1), runs)];
+            std::merge(items.begin() + low, items.begin() + middle, items.begin() + middle, items.begin() + high, merged.begin() + low, less);
+            std::copy(merged.begin() + low, merged.begin() + high, items.begin() + low);
+        });
+    }
+}
+
+// items a run must have before another thread takes a share
+static constexpr size_t minRun_ = 1 << 16;
+};
\ No newline at end of file
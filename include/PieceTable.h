@@ -0,0 +1,150 @@
+#pragma once
+
+#include "AppendVector.h"
+#include "ChunkArena.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Piece table: the document is a sequence of pieces pointing into an immutable
+// original buffer and an append-only added buffer kept in chunks that never
+// move. Pieces live in a treap (implicit key = byte offset) whose nodes
+// aggregate byte, line feed, code point and word counts, so edits, line
+// lookups and document statistics are O(log n) independent of document size.
+//
+// The treap is persistent: an edit copies the nodes on its path that a copy of
+// the table still shares and changes the rest in place, and the buffers and
+// their indexes are shared the same way. Copying a table is O(1), and a copy
+// is a snapshot that other threads can read without locks while this one is
+// edited.
+class PieceTable {
+public:
+    PieceTable();
+    explicit PieceTable(std::string text);
+    PieceTable(std::shared_ptr<const void> owner, std::string_view text);
+    PieceTable(std::shared_ptr<const void> owner, std::string_view text, std::vector<size_t> lineStarts);
+
+    void insert(size_t offset, std::string_view text);
+    void erase(size_t offset, size_t length);
+    void replaceAt(const std::vector<size_t>& offsets, size_t erase, std::string_view insert);
+    void clear();
+    // the original buffer copied into memory the table owns, for when the
+    // file a mapping of it reads from is changed under it; copies keep theirs
+    void ownOriginal();
+
+    size_t size() const;
+    size_t lineCount() const;
+    size_t chars() const;
+    size_t words() const;
+    size_t lineStart(size_t line) const;
+    size_t lineLength(size_t line) const;
+    size_t lineOf(size_t offset) const;
+    char at(size_t offset) const;
+    std::string line(size_t line) const;
+    std::vector<std::string> lines(size_t first, size_t last) const;
+    std::string text(size_t offset, size_t length) const;
+    std::string text() const;
+    // views valid until the next edit or freeze()
+    std::vector<std::string_view> pieces() const;
+    // the buffer the document was opened with and what keeps it alive
+    const std::shared_ptr<const void>& originalOwner() const;
+    std::string_view original() const;
+    // bytes held besides the original buffer: the added buffer and the indexes
+    size_t memory() const;
+    // keeps the added text between document offsets begin and end ready to
+    // read and compresses the rest, at most pack chunks of it a call; the
+    // plain bytes released. Copies keep reading what they share as it was
+    size_t freeze(size_t begin, size_t end, size_t pack);
+
+private:
+    enum Source : uint8_t {
+        Original,
+        Added,
+    };
+
+    struct Piece {
+        Source source_ = Original;
+        size_t start_ = 0;
+        size_t length_ = 0;
+        size_t lineFeeds_ = 0;
+        size_t chars_ = 0;
+        size_t words_ = 0;
+        // whether the first / last byte is part of a word
+        bool head_ = false;
+        bool tail_ = false;
+    };
+
+    // counts over the start of a buffer at every countBlock_ bytes, so the
+    // counts of any range scan at most two partial blocks
+    struct BlockCounts {
+        AppendVector<size_t> chars_ = {0};
+        AppendVector<size_t> words_ = {0};
+    };
+
+    struct Node;
+    // a node is changed in place only while no copy shares it
+    using Tree = std::shared_ptr<Node>;
+
+    struct Node {
+        Piece piece_;
+        Tree left_;
+        Tree right_;
+        uint32_t priority_ = 0;
+        size_t length_ = 0;
+        size_t lineFeeds_ = 0;
+        size_t chars_ = 0;
+        size_t words_ = 0;
+        size_t pieces_ = 0;
+        // whether the first / last byte of the subtree is part of a word
+        bool head_ = false;
+        bool tail_ = false;
+    };
+
+    static constexpr size_t countBlock_ = 1024;
+
+    Tree newNode(const Piece& piece);
+    static Node& own(Tree& t);
+    void update(Node& node);
+    static size_t length(const Tree& t);
+    static size_t lineFeeds(const Tree& t);
+    Tree merge(Tree a, Tree b);
+    void split(Tree t, size_t offset, Tree& l, Tree& r);
+    bool extendLast(Tree& t, const Piece& piece);
+    void collect(const Tree& t, size_t offset, size_t length, std::string& out) const;
+    void collectRanges(const Tree& t, size_t offset, size_t length, std::vector<std::pair<size_t, size_t>>& out) const;
+    void collectPieces(const Tree& t, std::vector<std::string_view>& out) const;
+    void collectPieces(const Tree& t, std::vector<Piece>& out) const;
+    Piece slice(const Piece& piece, size_t begin, size_t length) const;
+    void build(const std::vector<Piece>& pieces);
+    void refresh(Node& node);
+    std::vector<Piece> add(std::string_view text);
+
+    const char* data(Source source, size_t offset) const;
+    size_t bufferSize(Source source) const;
+    const AppendVector<size_t>& lineStarts(Source source) const;
+    size_t countLineFeeds(Source source, size_t start, size_t length) const;
+    size_t lineFeedEnd(const Piece& piece, size_t k) const;
+    bool wordAt(Source source, size_t offset) const;
+    void countBefore(Source source, size_t offset, size_t& chars, size_t& words) const;
+    void count(Piece& piece) const;
+    void join(Piece& piece, const Piece& next) const;
+    void appendCounts(Source source, size_t gapBegin = 0, size_t gapEnd = 0);
+    static void appendLineStarts(std::vector<size_t>& starts, std::string_view buffer, size_t from);
+
+    // the original buffer is a view kept alive by its owner (a string or a file mapping)
+    std::shared_ptr<const void> originalOwner_;
+    std::string_view original_;
+    ChunkArena added_;
+    AppendVector<size_t> originalLineStarts_;
+    AppendVector<size_t> addedLineStarts_;
+    BlockCounts originalCounts_;
+    BlockCounts addedCounts_;
+
+    Tree root_;
+    uint32_t seed_ = 2463534242u;
+};
\ No newline at end of file
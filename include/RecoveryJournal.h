@@ -0,0 +1,82 @@
+#pragma once
+
+#include "PieceTable.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// Append-only log of every edit made since the document was last saved, kept
+// in "<document>.journal". Records are copied into a shared file mapping and a
+// worker thread flushes them to disk every interval, so a keystroke never
+// waits on I/O. Opening the document again replays the log on top of it.
+class RecoveryJournal {
+public:
+    // identifies the file contents the log applies to
+    struct Fingerprint {
+        uint64_t size_ = 0;
+        int64_t mtime_ = 0;
+        uint64_t hash_ = 0;
+
+        bool operator==(const Fingerprint&) const = default;
+    };
+
+    RecoveryJournal(const std::string& path, const Fingerprint& base, uint32_t intervalMs = 100);
+    RecoveryJournal(const RecoveryJournal&) = delete;
+    RecoveryJournal& operator=(const RecoveryJournal&) = delete;
+    ~RecoveryJournal();
+
+    // false when the log could not be created or mapped; appending and
+    // rebasing then do nothing
+    bool valid() const;
+    size_t replay(PieceTable& document);
+    void append(size_t offset, size_t erase, std::string_view insert);
+    size_t position() const;
+    void rebase(size_t position, const Fingerprint& base);
+
+    static Fingerprint fingerprint(const std::string& path, std::string_view contents);
+
+private:
+    struct Header {
+        char magic_[8];
+        Fingerprint base_;
+    };
+
+    struct Record {
+        uint32_t checksum_;
+        uint32_t erase_;
+        uint32_t insert_;
+        uint32_t reserved_;
+        uint64_t offset_;
+    };
+
+    void reset(const Fingerprint& base);
+    bool write(size_t at, const void* data, size_t size);
+    void reserve(size_t size);
+    void flush();
+    static uint32_t checksum(const Record& record, std::string_view bytes);
+
+    std::string path_;
+    size_t used_ = 0;
+    uint32_t intervalMs_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::atomic<bool> dirty_ = false;
+    bool stop_ = false;
+    std::thread flusher_;
+
+#ifdef _WIN32
+    std::FILE* file_ = nullptr;
+#else
+    int fd_ = -1;
+    char* data_ = nullptr;
+    size_t capacity_ = 0;
+#endif
+};
\ No newline at end of file
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Line-oriented regular expressions: literals, ., [classes], \d \w \s, ^ $,
+// * + ?, | and groups. The pattern is compiled once into an NFA; matching runs
+// lazily built DFAs, so every byte costs a table lookup and no backtracking.
+// Matches never span lines and are leftmost-longest.
+class Regex {
+public:
+    explicit Regex(std::string_view pattern);
+
+    bool valid() const;
+    const std::string& error() const;
+
+    // Owns the DFA states, which are built on demand: use one per thread.
+    class Matcher {
+    public:
+        explicit Matcher(const Regex& regex);
+
+        // first match in the line at or after from
+        bool find(std::string_view line, size_t from, size_t& begin, size_t& end);
+        // appends text[first, last) with every match replaced to out, where
+        // first and last bound the matches; & in replacement is the match
+        size_t replace(std::string_view text, std::string_view replacement, std::string& out, size_t& first, size_t& last);
+
+    private:
+        struct Dfa {
+            int32_t entry_ = -1;
+            std::vector<std::vector<int32_t>> sets_;
+            std::map<std::vector<int32_t>, int32_t> ids_;
+            std::vector<int32_t> next_;
+            std::vector<uint8_t> accept_;
+            std::vector<uint8_t> acceptAtEnd_;
+            std::array<int32_t, 2> start_ = {-1, -1};
+        };
+
+        void reset(Dfa& dfa);
+        int32_t state(Dfa& dfa, std::vector<int32_t>& set, bool atBegin);
+        int32_t start(Dfa& dfa, bool atBegin);
+        int32_t next(Dfa& dfa, int32_t state, unsigned char c);
+        int32_t step(Dfa& dfa, int32_t state, unsigned char c);
+        void closure(std::vector<int32_t>& set, bool atBegin, bool atEnd);
+        void starts(std::string_view line);
+        size_t longest(std::string_view line, size_t begin);
+
+        bool matches(std::string_view line);
+        void matchLine(std::string_view line, size_t lineBegin, const std::function<void(size_t, size_t)>& emit);
+
+        const Regex& regex_;
+        // unanchored, tells whether a line has a match at all
+        Dfa search_;
+        // anchored at a match start, finds its end
+        Dfa forward_;
+        // finds where matches can start
+        Dfa reverse_;
+        // starts_[i] is set when a match can begin at line[i]
+        std::vector<uint8_t> starts_;
+        std::vector<uint8_t> seen_;
+        std::vector<int32_t> stack_;
+    };
+
+private:
+    struct Node {
+        enum Kind : uint8_t {
+            Set,
+            Split,
+            Begin,
+            End,
+            Match,
+        };
+
+        Kind kind_;
+        int32_t out_ = -1;
+        int32_t out1_ = -1;
+        int32_t set_ = -1;
+    };
+
+    struct Ast {
+        enum Kind : uint8_t {
+            Empty,
+            Set,
+            Concat,
+            Alt,
+            Star,
+            Plus,
+            Quest,
+            Begin,
+            End,
+        };
+
+        Kind kind_;
+        int32_t set_ = -1;
+        std::vector<std::unique_ptr<Ast>> children_;
+    };
+
+    std::unique_ptr<Ast> parseAlt();
+    std::unique_ptr<Ast> parseConcat();
+    std::unique_ptr<Ast> parseRepeat();
+    std::unique_ptr<Ast> parseAtom();
+    std::unique_ptr<Ast> parseClass();
+    bool parseEscape(std::bitset<256>& set);
+    int32_t addSet(const std::bitset<256>& set);
+    int32_t addNode(Node::Kind kind, int32_t out = -1, int32_t out1 = -1, int32_t set = -1);
+    int32_t compile(const Ast& ast, int32_t next, bool reverse);
+    void classify();
+    void findLiteral(const Ast& ast);
+
+    std::string pattern_;
+    size_t pos_ = 0;
+    std::string error_;
+
+    std::vector<std::bitset<256>> sets_;
+    std::vector<Node> nodes_;
+    int32_t forward_ = -1;
+    // the pattern behind a loop over any byte
+    int32_t search_ = -1;
+    // the reversed pattern behind a loop over any byte, run from line ends
+    int32_t reverse_ = -1;
+    // bytes every match contains; lines without them are skipped unscanned
+    std::string literal_;
+    // bytes no set tells apart share a class, DFA rows have one column per class
+    std::array<uint8_t, 256> classOf_ = {};
+    size_t classes_ = 1;
+};
\ No newline at end of file
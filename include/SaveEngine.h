@@ -0,0 +1,52 @@
+#pragma once
+
+#include "PieceTable.h"
+#include "Transcode.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Writes document snapshots on a worker thread: gathered writes of the pieces
+// into "<path>.tmp", flush to disk, then an atomic rename over <path>.
+// Completion callbacks run on whichever thread calls poll(). Text is encoded
+// back to the file's format in chunks as it is written.
+class SaveEngine {
+public:
+    using Callback = std::function<void(bool ok, const std::string& path)>;
+
+    SaveEngine();
+    SaveEngine(const SaveEngine&) = delete;
+    SaveEngine& operator=(const SaveEngine&) = delete;
+    ~SaveEngine();
+
+    void save(PieceTable snapshot, const std::string& path, Transcode::Format format, Callback callback);
+    bool busy();
+    void poll();
+
+    static bool write(const std::vector<std::string_view>& pieces, const std::string& path, Transcode::Format format = {});
+
+private:
+    struct Job {
+        PieceTable snapshot_;
+        std::string path_;
+        Transcode::Format format_;
+        Callback callback_;
+        bool ok_ = false;
+    };
+
+    void work();
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<Job> pending_;
+    std::deque<Job> done_;
+    bool writing_ = false;
+    bool stop_ = false;
+    std::thread worker_;
+};
\ No newline at end of file
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "PieceTable.h"
+#include "Regex.h"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Replace-all for :s. The document is cut into chunks at line boundaries and
+// the chunks are matched on worker threads; each one comes back as a single
+// span from its first to its last match, so applying the result is one
+// erase and one insert per chunk.
+struct Substitute {
+    struct Span {
+        size_t offset_ = 0;
+        size_t length_ = 0;
+        std::string text_;
+        size_t count_ = 0;
+    };
+
+    // spans in document order; threads = 0 uses every core
+    static std::vector<Span> run(const PieceTable& document, const Regex& regex, std::string_view replacement, size_t threads = 0);
+
+    static constexpr size_t chunkSize_ = 8 << 20;
+};
\ No newline at end of file
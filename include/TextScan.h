@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Byte scanning kernels with AVX2/SSE2 paths picked at runtime.
+struct TextScan {
+
+// appends base + i + 1 for every '\n' at data[i]
+static void lineStarts(const char* data, size_t size, size_t base, std::vector<size_t>& starts);
+
+static size_t count(const char* data, size_t size, char c);
+
+// appends base + i for every occurrence of needle at data[i], overlapping ones included
+static void find(const char* data, size_t size, std::string_view needle, size_t base, std::vector<size_t>& matches);
+
+// adds the UTF-8 code points and the words (runs of non-whitespace) starting
+// in data; afterSpace tells whether the byte before data is whitespace
+static void stats(const char* data, size_t size, bool afterSpace, size_t& chars, size_t& words);
+static bool space(char c);
+
+// length of the longest prefix of data that is well-formed UTF-8
+static size_t validUtf8(const char* data, size_t size);
+
+static bool avx2();
+};
\ No newline at end of file
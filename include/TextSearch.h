@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Every occurrence of a needle in a document as a sorted array of offsets, so
+// stepping to the next or previous match is a binary search. The document is
+// given as its pieces in order; matches spanning piece boundaries are found too.
+// The set is maintained rather than rebuilt: a longer needle filters the
+// current matches, a shorter one restores an earlier set, and an edit only
+// rescans the bytes around it.
+class TextSearch {
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+    // length bytes of the edited document at offset, fewer at its end
+    using Text = std::function<std::string(size_t offset, size_t length)>;
+
+    void search(const std::vector<std::string_view>& pieces, std::string_view needle);
+    void update(const std::vector<std::string_view>& pieces, std::string_view needle);
+    void edit(size_t offset, size_t erased, size_t inserted, const Text& text);
+    void clear();
+    bool valid() const;
+    const std::string& needle() const;
+    const std::vector<size_t>& matches() const;
+
+    // first match after / last match before offset, wrapping around
+    size_t next(size_t offset) const;
+    size_t prev(size_t offset) const;
+
+private:
+    struct Narrowed {
+        std::string needle_;
+        std::vector<size_t> matches_;
+    };
+
+    void narrow(const std::vector<std::string_view>& pieces, std::string_view needle);
+
+    std::string needle_;
+    std::vector<size_t> matches_;
+    // the sets of shorter needles this one was narrowed from
+    std::vector<Narrowed> history_;
+    bool valid_ = false;
+};
\ No newline at end of file
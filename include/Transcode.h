@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Conversion between UTF-8, which the editor works in, and the encodings
+// files are stored in, with AVX2 paths for ASCII runs and for characters of
+// up to two UTF-8 bytes.
+struct Transcode {
+
+enum Encoding : uint8_t {
+    Utf8,
+    Utf16LE,
+    Utf16BE,
+    Latin1,
+};
+
+struct Format {
+    Encoding encoding_ = Utf8;
+    // whether the file starts with a byte order mark
+    bool bom_ = false;
+};
+
+// Converts a stream handed over in chunks of any size. A character cut by
+// the end of a chunk is held back until the next one; finish() turns one
+// left at the end of the stream into a replacement character.
+class Stream {
+public:
+    Stream(Encoding from, Encoding to);
+
+    void convert(std::string_view data, std::string& out);
+    void finish(std::string& out);
+
+private:
+    size_t convertWhole(std::string_view data, std::string& out);
+
+    Encoding from_;
+    Encoding to_;
+    std::string carry_;
+    std::string buffer_;
+};
+
+// the byte order mark, else NUL bytes in every other position for UTF-16,
+// else UTF-8 when all of data is well-formed, else Latin-1; data may be a
+// prefix of the file
+static Format detect(std::string_view data, bool whole = true);
+static std::string_view bom(Format format);
+static const char* name(Format format);
+};
\ No newline at end of file
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <string_view>
+
+// Operation log for undo/redo. Every edit is kept as a (offset, erased bytes,
+// inserted bytes) record whose bytes live in one arena string; a step groups
+// the records of one Editor operation. Runs of typed characters are merged
+// into a single record, and the oldest steps are dropped past capacity_.
+class UndoJournal {
+public:
+    // replaces `erase` bytes at offset with `insert`
+    using Apply = std::function<void(size_t offset, size_t erase, std::string_view insert)>;
+
+    UndoJournal(size_t capacity = 64ull << 20);
+
+    void begin(bool typing = false);
+    void end();
+    void breakTyping();
+    void recordInsert(size_t offset, std::string_view text);
+    void recordErase(size_t offset, std::string_view text);
+
+    bool undo(const Apply& apply, size_t& cursor);
+    bool redo(const Apply& apply, size_t& cursor);
+
+    void clear();
+    void setCapacity(size_t capacity);
+    size_t usage() const;
+    size_t steps() const;
+
+private:
+    struct Record {
+        uint64_t offset_ = 0;
+        uint64_t arena_ = 0;
+        uint32_t erased_ = 0;
+        uint32_t inserted_ = 0;
+    };
+
+    struct Step {
+        uint64_t record_ = 0;
+        uint64_t arena_ = 0;
+    };
+
+    void record(size_t offset, std::string_view erased, std::string_view inserted);
+    void dropRedo();
+    void shrink();
+    Record& recordAt(uint64_t index);
+    std::string_view bytes(uint64_t arena, size_t length) const;
+    uint64_t recordEnd(size_t step) const;
+
+    std::deque<Record> records_;
+    std::deque<Step> steps_;
+    std::string arena_;
+    // absolute index of records_.front() and absolute offset of arena_[0]
+    uint64_t recordBase_ = 0;
+    uint64_t arenaBase_ = 0;
+    uint64_t arenaFront_ = 0;
+
+    size_t current_ = 0;
+    size_t capacity_;
+    int32_t depth_ = 0;
+    bool typing_ = false;
+    bool stepOpen_ = false;
+};
\ No newline at end of file
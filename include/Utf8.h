@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// UTF-8 decoding and grapheme cluster boundaries. A byte that does not start
+// a valid sequence decodes on its own to U+FFFD, so every byte belongs to
+// exactly one code point and no input is rejected.
+struct Utf8 {
+
+static constexpr char32_t replacement = 0xfffd;
+
+// length of the valid sequence at data[0], 0 if there is none
+static size_t sequence(const char* data, size_t size);
+
+// the code point at text[offset]; length gets the bytes it takes
+static char32_t decode(std::string_view text, size_t offset, size_t& length);
+
+// the grapheme cluster boundary after offset, which must be a boundary
+static size_t next(std::string_view text, size_t offset);
+
+// appends every cluster boundary of text, 0 and text.size() included
+static void graphemes(std::string_view text, std::vector<uint32_t>& bounds);
+
+// clusters in text[0, offset)
+static size_t columns(std::string_view text, size_t offset);
+};
\ No newline at end of file
@@ -117,6 +117,7 @@ private:
 
     void processText();
     void updateTexture();
+    int32_t gutter() const;
 
     void input(int key, int scancode, int action, int mods);
     void processInput(int key, int scancode, int mods);
@@ -124,6 +125,7 @@ private:
     void inputInsert(int key, int scancode, int mods);
     void inputCommand(int key, int scandcode, int mods);
     void processCmd(std::string cmd);
+    void previewCmd();
 
     void generateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
     
@@ -216,7 +218,13 @@ private:
 
     std::shared_ptr<Font> font_;
     const std::string fontPath_ = "../fonts/jbMono.ttf";
-    std::unordered_map<char, Font::Character> dictionary_;
+    // ASCII, Latin-1 and Latin Extended-A, dashes and quotes, box drawing and
+    // the U+FFFD every other code point is drawn with; shaders/Font.frag
+    // declares one sampler per glyph
+    static constexpr std::pair<char32_t, char32_t> glyphRanges_[] = {
+        {0x0000, 0x007f}, {0x00a0, 0x017f}, {0x2010, 0x2027}, {0x2500, 0x257f}, {0xfffd, 0xfffd},
+    };
+    std::unordered_map<char32_t, Font::Character> dictionary_;
     std::shared_ptr<PipelineLayout> fontPipelineLayout_;
     std::shared_ptr<Pipeline> fontPipeline_;
     std::shared_ptr<DescriptorPool> fontDescriptorPool_;
@@ -264,6 +272,8 @@ private:
     int inputText_ = 0;
     int capsLock_ = 0;
     std::string text_;
+    // cursor to go back to when a live find is abandoned, x == -1 when none
+    glm::ivec2 searchOrigin_ = {-1, -1};
 
     std::unordered_map<std::string, std::shared_ptr<RenderTarget>> renderTargets_;
 
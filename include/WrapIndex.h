@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// The visual rows of every line when lines wrap at width columns. Each line's
+// columns are kept in blocks of at most 2 * blockLines_ lines, and Fenwick
+// trees over the blocks hold prefix sums of their lines and rows, so finding
+// the first row of a line, the line at a row, or changing a line is O(log n)
+// plus a scan of one block. A new width only divides the stored columns
+// again; the text is measured once, and then only where it is edited.
+class WrapIndex {
+public:
+    // the columns of every line, wrapped at width
+    void assign(const std::vector<uint32_t>& columns, uint32_t width);
+    void setWidth(uint32_t width);
+    // lines [line, line + erase) become lines of the given columns
+    void splice(size_t line, size_t erase, const std::vector<uint32_t>& columns);
+    void clear();
+
+    size_t lines() const;
+    size_t rows() const;
+    uint32_t width() const;
+    uint32_t columns(size_t line) const;
+    // rows line takes, at least one
+    uint32_t height(size_t line) const;
+    // the first row of line; line may be lines(), giving rows()
+    size_t rowOf(size_t line) const;
+    // the line row is on and the row within it; row < rows()
+    std::pair<size_t, uint32_t> lineAt(size_t row) const;
+
+    // the on-screen columns of line, a tab reaching to the next multiple of
+    // tabWidth, as Editor::layout() counts them
+    static uint32_t measure(std::string_view line, int32_t tabWidth);
+    // appends the columns of every line in the concatenated pieces, the last
+    // one ending where the text does
+    static void measure(const std::vector<std::string_view>& pieces, int32_t tabWidth, std::vector<uint32_t>& columns);
+
+    static constexpr size_t blockLines_ = 64;
+
+private:
+    struct Block {
+        std::vector<uint32_t> columns_;
+        size_t rows_ = 0;
+    };
+
+    uint32_t rowsOf(uint32_t columns) const;
+    size_t count(const Block& block) const;
+    // the block holding line and its place in it; line may be lines()
+    std::pair<size_t, size_t> find(size_t line) const;
+    void rebuild();
+    void add(std::vector<size_t>& tree, size_t block, int64_t delta);
+    size_t prefix(const std::vector<size_t>& tree, size_t block) const;
+    size_t descend(const std::vector<size_t>& tree, size_t& rest) const;
+
+    std::vector<Block> blocks_;
+    // Fenwick trees over blocks_, one based
+    std::vector<size_t> lineTree_;
+    std::vector<size_t> rowTree_;
+    size_t lines_ = 0;
+    size_t rows_ = 0;
+    uint32_t width_ = 1;
+};
\ No newline at end of file
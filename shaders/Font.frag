@@ -1,6 +1,6 @@
 #version 450
 
-layout(set = 0, binding = 1) uniform sampler2D fontSampler[26];
+layout(set = 0, binding = 1) uniform sampler2D fontSampler[505];
 
 layout(location = 0) in struct {
     vec3 color;
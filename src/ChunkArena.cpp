@@ -0,0 +1,166 @@
+#include "ChunkArena.h"
+#include "Lz.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+namespace {
+
+// thawing is rare; one lock for every arena keeps copies cheap to make
+std::mutex thawMutex;
+
+}
+
+ChunkArena::ChunkArena(const ChunkArena& other) : chunks_(other.chunks_), size_(other.size_), limit_(other.size_) {
+
+}
+
+ChunkArena& ChunkArena::operator=(const ChunkArena& other) {
+    if (this != &other) {
+        chunks_ = other.chunks_;
+        size_ = limit_ = other.size_;
+    }
+
+    return *this;
+}
+
+ChunkArena::ChunkArena(ChunkArena&& other) noexcept : chunks_(std::move(other.chunks_)), size_(other.size_), limit_(other.limit_) {
+    other.size_ = other.limit_ = 0;
+}
+
+ChunkArena& ChunkArena::operator=(ChunkArena&& other) noexcept {
+    if (this != &other) {
+        chunks_ = std::move(other.chunks_);
+        size_ = other.size_;
+        limit_ = other.limit_;
+        other.size_ = other.limit_ = 0;
+    }
+
+    return *this;
+}
+
+// the list of chunks, copied first if a copy shares it
+ChunkArena::Chunks& ChunkArena::own() {
+    if (!chunks_) {
+        chunks_ = std::make_shared<Chunks>();
+    } else if (chunks_.use_count() > 1) {
+        chunks_ = std::make_shared<Chunks>(*chunks_);
+    }
+
+    return *chunks_;
+}
+
+size_t ChunkArena::append(std::string_view text) {
+    if (text.empty()) {
+        return size_;
+    }
+    text = text.substr(0, maxAppend_);
+
+    // a chunk always ends in padding, so runs in different chunks are never
+    // next to each other and no piece can be extended across two chunks
+    if (size_ + text.size() >= limit_) {
+        // padded all through, so the bytes no append wrote read as padding
+        auto chunk = std::make_shared<Chunk>();
+        chunk->plain_.reset(new char[chunkSize_]);
+        std::memset(chunk->plain_.get(), padding_, chunkSize_);
+        chunk->data_ = chunk->plain_.get();
+        auto& chunks = own();
+        chunks.push_back(std::move(chunk));
+        size_ = (chunks.size() - 1) << chunkShift_;
+        limit_ = chunks.size() << chunkShift_;
+    }
+
+    auto start = size_;
+    std::memcpy((*chunks_)[start >> chunkShift_]->data_.load(std::memory_order_relaxed) + (start & (chunkSize_ - 1)), text.data(), text.size());
+    size_ += text.size();
+
+    return start;
+}
+
+const char* ChunkArena::at(size_t offset) const {
+    auto& chunk = *(*chunks_)[offset >> chunkShift_];
+    auto data = chunk.data_.load(std::memory_order_acquire);
+    if (data == nullptr) {
+        thaw(chunk);
+        data = chunk.data_.load(std::memory_order_acquire);
+    }
+
+    return data + (offset & (chunkSize_ - 1));
+}
+
+void ChunkArena::thaw(Chunk& chunk) const {
+    std::lock_guard lock(thawMutex);
+    if (chunk.data_.load(std::memory_order_relaxed) != nullptr) {
+        return ;
+    }
+
+    chunk.plain_.reset(new char[chunkSize_]);
+    Lz::decompress(*chunk.packed_, chunk.plain_.get(), chunkSize_);
+    chunk.data_.store(chunk.plain_.get(), std::memory_order_release);
+}
+
+size_t ChunkArena::size() const {
+    return size_;
+}
+
+size_t ChunkArena::capacity() const {
+    size_t bytes = 0;
+    if (chunks_) {
+        for (auto& chunk : *chunks_) {
+            bytes += (chunk->data_.load(std::memory_order_acquire) != nullptr ? chunkSize_ : 0) + (chunk->packed_ ? chunk->packed_->size() : 0);
+        }
+    }
+
+    return bytes;
+}
+
+void ChunkArena::clear() {
+    chunks_.reset();
+    size_ = limit_ = 0;
+}
+
+// a chunk stays packed once compressed, so freezing it again after a thaw
+// only drops its plain bytes
+size_t ChunkArena::freeze(const std::vector<std::pair<size_t, size_t>>& hot, size_t pack) {
+    if (!chunks_) {
+        return 0;
+    }
+
+    size_t released = 0, range = 0;
+    for (size_t k = 0; k + 1 < chunks_->size(); k++) {
+        auto begin = k << chunkShift_;
+        auto end = begin + chunkSize_;
+        while (range < hot.size() && hot[range].second <= begin) {
+            range++;
+        }
+        auto& chunk = *(*chunks_)[k];
+        auto data = chunk.data_.load(std::memory_order_acquire);
+        if (data == nullptr || chunk.incompressible_ || (range < hot.size() && hot[range].first < end)) {
+            continue;
+        }
+
+        auto frozen = std::make_shared<Chunk>();
+        frozen->packed_ = chunk.packed_;
+        if (!frozen->packed_) {
+            if (pack == 0) {
+                continue;
+            }
+            pack--;
+            auto packed = Lz::compress({data, chunkSize_});
+            if (packed.size() >= chunkSize_ / 8 * 7) {
+                frozen->plain_ = chunk.plain_;
+                frozen->data_ = data;
+                frozen->incompressible_ = true;
+                own()[k] = std::move(frozen);
+                continue;
+            }
+            packed.shrink_to_fit();
+            frozen->packed_ = std::make_shared<const std::string>(std::move(packed));
+        }
+        own()[k] = std::move(frozen);
+        released += chunkSize_;
+    }
+
+    return released;
+}
\ No newline at end of file
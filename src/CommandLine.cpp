@@ -2,10 +2,11 @@
 #include "Editor.h"
 #include "GLFW/glfw3.h"
 #include "glm/fwd.hpp"
+#include <algorithm>
 #include <cstdlib>
 #include <io.h>
 
-CommandLine::CommandLine(const Editor& editor) : Editor(editor) {
+CommandLine::CommandLine(const Editor& editor) : Editor(editor.screen_.x, editor.screen_.y, editor.lineHeight_, editor.fontAdvance_, editor.showWordsOffset_) {
     whichLine_ = editor.showLines_;
     lineNumberOffset_ = 1;
     onlyLine_.insert(onlyLine_.begin(), ':');
@@ -23,20 +24,40 @@ std::string CommandLine::enter() {
 }
 
 void CommandLine::insertChar(char c) {
-    onlyLine_.insert(onlyLine_.begin() + cursorX_ + lineNumberOffset_, c);
-    cursorX_++;
+    insertRange(cursorX_, std::string_view(&c, 1));
 }
 
 void CommandLine::insertStr(const std::string& str) {
-    for (auto c : str) {
-        insertChar(c);
-    }
+    insertRange(cursorX_, str);
 }
 
 void CommandLine::backspace() {
     if (cursorX_ > 0) {
-        onlyLine_.erase(onlyLine_.begin() + cursorX_ + lineNumberOffset_ - 1);
-        cursorX_--;
+        eraseRange(cursorX_ - 1, 1);
+    }
+}
+
+// offsets are columns of the command after the prompt
+void CommandLine::insertRange(size_t offset, std::string_view text) {
+    offset = std::min(offset, onlyLine_.size() - lineNumberOffset_);
+    onlyLine_.insert(offset + lineNumberOffset_, text);
+    if (cursorX_ >= offset) {
+        cursorX_ += text.size();
+    }
+}
+
+void CommandLine::eraseRange(size_t offset, size_t length) {
+    auto size = onlyLine_.size() - lineNumberOffset_;
+    if (offset >= size) {
+        return ;
+    }
+    length = std::min(length, size - offset);
+
+    onlyLine_.erase(offset + lineNumberOffset_, length);
+    if (cursorX_ >= offset + length) {
+        cursorX_ -= length;
+    } else if (cursorX_ > offset) {
+        cursorX_ = offset;
     }
 }
 
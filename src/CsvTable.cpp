@@ -0,0 +1,319 @@
+#include "CsvTable.h"
+#include "Parallel.h"
+#include "TextScan.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+
+namespace {
+
+// code points, which is what a cell takes on screen for the text it holds
+size_t columnsOf(std::string_view text) {
+    size_t columns = 0;
+    for (auto c : text) {
+        columns += (static_cast<unsigned char>(c) & 0xc0) != 0x80;
+    }
+
+    return columns;
+}
+
+bool number(std::string_view text, double& value) {
+    while (!text.empty() && text.front() == ' ') {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && (text.back() == ' ' || text.back() == '\r')) {
+        text.remove_suffix(1);
+    }
+    if (!text.empty() && text.front() == '+') {
+        text.remove_prefix(1);
+    }
+
+    auto end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, value);
+    return !text.empty() && result.ec == std::errc() && result.ptr == end;
+}
+
+}
+
+CsvTable::CsvTable(std::shared_ptr<const void> owner, std::string_view text, char separator, size_t threads) : owner_(std::move(owner)), text_(text), separator_(separator) {
+    auto chunks = (text.size() + chunkSize_ - 1) / chunkSize_;
+
+    // whether each chunk starts inside quotes
+    std::vector<size_t> quotes(chunks);
+    Parallel::forEach(chunks, threads, [&](size_t i) {
+        auto begin = i * chunkSize_;
+        quotes[i] = TextScan::count(text.data() + begin, std::min(chunkSize_, text.size() - begin), '"');
+    });
+    std::vector<bool> quoted(chunks);
+    for (size_t i = 1; i < chunks; i++) {
+        quoted[i] = quoted[i - 1] != (quotes[i - 1] % 2 == 1);
+    }
+
+    // rows starting in each chunk, after the newlines outside quotes
+    std::vector<std::vector<size_t>> starts(chunks);
+    Parallel::forEach(chunks, threads, [&](size_t i) {
+        auto begin = i * chunkSize_;
+        auto size = std::min(chunkSize_, text.size() - begin);
+        auto& out = starts[i];
+        if (quotes[i] == 0 && !quoted[i]) {
+            TextScan::lineStarts(text.data() + begin, size, begin, out);
+        } else {
+            bool inside = quoted[i];
+            for (size_t k = begin; k < begin + size; k++) {
+                if (text[k] == '"') {
+                    inside = !inside;
+                } else if (text[k] == '\n' && !inside) {
+                    out.push_back(k + 1);
+                }
+            }
+        }
+        // a newline ending the text does not start a row
+        if (!out.empty() && out.back() == text.size()) {
+            out.pop_back();
+        }
+    });
+
+    if (!text.empty()) {
+        rowStarts_.push_back(0);
+    }
+    for (auto& chunk : starts) {
+        rowStarts_.insert(rowStarts_.end(), chunk.begin(), chunk.end());
+        std::vector<size_t>().swap(chunk);
+    }
+    rowStarts_.push_back(text.size());
+
+    // the cells of blocks of rows, and the widest cell of every column
+    auto blocks = (rows() + rowBlock_ - 1) / rowBlock_;
+    std::vector<std::vector<uint32_t>> blockCells(blocks), blockCounts(blocks), blockWidths(blocks);
+    Parallel::forEach(blocks, threads, [&](size_t i) {
+        auto& cells = blockCells[i];
+        auto& counts = blockCounts[i];
+        auto& widths = blockWidths[i];
+        for (auto row = i * rowBlock_; row < std::min(rows(), (i + 1) * rowBlock_); row++) {
+            auto start = rowStarts_[row];
+            auto end = rowEnd(row);
+            auto first = cells.size();
+            cells.push_back(0);
+            auto inside = false;
+            for (auto k = start; k < end; k++) {
+                if (text[k] == '"') {
+                    inside = !inside;
+                } else if (text[k] == separator && !inside) {
+                    cells.push_back(static_cast<uint32_t>(k + 1 - start));
+                }
+            }
+            counts.push_back(static_cast<uint32_t>(cells.size() - first));
+
+            if (widths.size() < cells.size() - first) {
+                widths.resize(cells.size() - first, 0);
+            }
+            for (auto c = first; c < cells.size(); c++) {
+                auto cellEnd = c + 1 < cells.size() ? start + cells[c + 1] - 1 : end;
+                auto width = std::min(columnsOf(text.substr(start + cells[c], cellEnd - start - cells[c])), maxWidth_);
+                widths[c - first] = std::max(widths[c - first], static_cast<uint32_t>(width));
+            }
+        }
+    });
+
+    rowCells_.reserve(rows() + 1);
+    for (size_t i = 0; i < blocks; i++) {
+        for (auto count : blockCounts[i]) {
+            rowCells_.push_back(cellStarts_.size());
+            cellStarts_.resize(cellStarts_.size() + count);
+        }
+        if (widths_.size() < blockWidths[i].size()) {
+            widths_.resize(blockWidths[i].size(), 0);
+        }
+        for (size_t c = 0; c < blockWidths[i].size(); c++) {
+            widths_[c] = std::max(widths_[c], blockWidths[i][c]);
+        }
+    }
+    rowCells_.push_back(cellStarts_.size());
+    Parallel::forEach(blocks, threads, [&](size_t i) {
+        std::copy(blockCells[i].begin(), blockCells[i].end(), cellStarts_.begin() + rowCells_[i * rowBlock_]);
+        std::vector<uint32_t>().swap(blockCells[i]);
+    });
+}
+
+char CsvTable::separator(std::string_view path, std::string_view head) {
+    if (path.ends_with(".tsv") || path.ends_with(".tab")) {
+        return '\t';
+    }
+
+    head = head.substr(0, head.find('\n'));
+    char best = ',';
+    size_t most = 0;
+    for (auto c : {',', ';', '\t', '|'}) {
+        auto count = static_cast<size_t>(std::count(head.begin(), head.end(), c));
+        if (count > most) {
+            best = c;
+            most = count;
+        }
+    }
+
+    return best;
+}
+
+size_t CsvTable::rows() const {
+    return rowStarts_.size() - 1;
+}
+
+size_t CsvTable::columns() const {
+    return widths_.size();
+}
+
+size_t CsvTable::cells(size_t row) const {
+    auto stored = order_.empty() ? row : order_[row];
+    return rowCells_[stored + 1] - rowCells_[stored];
+}
+
+// without the line feed and a carriage return before it
+size_t CsvTable::rowEnd(size_t row) const {
+    auto end = rowStarts_[row + 1];
+    if (end > rowStarts_[row] && text_[end - 1] == '\n') {
+        end--;
+    }
+    if (end > rowStarts_[row] && text_[end - 1] == '\r') {
+        end--;
+    }
+
+    return end;
+}
+
+std::string_view CsvTable::raw(size_t row, size_t column) const {
+    auto stored = order_.empty() ? row : order_[row];
+    auto first = rowCells_[stored];
+    auto count = rowCells_[stored + 1] - first;
+    if (column >= count) {
+        return {};
+    }
+
+    auto start = rowStarts_[stored];
+    auto begin = start + cellStarts_[first + column];
+    auto end = column + 1 < count ? start + cellStarts_[first + column + 1] - 1 : rowEnd(stored);
+
+    return text_.substr(begin, end - begin);
+}
+
+std::string CsvTable::cell(size_t row, size_t column) const {
+    auto text = raw(row, column);
+    if (text.size() < 2 || text.front() != '"' || text.back() != '"') {
+        return std::string(text);
+    }
+
+    std::string cell;
+    for (size_t i = 1; i + 1 < text.size(); i++) {
+        cell += text[i];
+        if (text[i] == '"' && text[i + 1] == '"') {
+            i++;
+        }
+    }
+
+    return cell;
+}
+
+size_t CsvTable::offset(size_t row, size_t column) const {
+    auto text = raw(row, column);
+    if (text.data() == nullptr) {
+        auto stored = order_.empty() ? row : order_[row];
+        return rowStarts_[stored];
+    }
+
+    return text.data() - text_.data();
+}
+
+size_t CsvTable::rowAt(size_t offset) const {
+    auto stored = static_cast<size_t>(std::upper_bound(rowStarts_.begin(), rowStarts_.end() - 1, offset) - rowStarts_.begin());
+    stored = stored == 0 ? 0 : stored - 1;
+    if (order_.empty()) {
+        return stored;
+    }
+
+    return std::find(order_.begin(), order_.end(), stored) - order_.begin();
+}
+
+// cells are padded to their column's width and split by a bar; one that is
+// too wide ends in an ellipsis, line breaks and tabs in it become spaces
+std::string CsvTable::line(size_t row, size_t first, size_t width) const {
+    std::string line;
+    size_t column = 0;
+    for (auto c = first; c < columns() && column < width; c++) {
+        if (c > first) {
+            line += " │ ";
+        }
+        auto text = cell(row, c);
+        auto fits = columnsOf(text) <= widths_[c];
+        size_t taken = 0;
+        for (size_t i = 0; i < text.size(); i++) {
+            auto byte = static_cast<unsigned char>(text[i]);
+            if ((byte & 0xc0) != 0x80) {
+                if (!fits && taken + 1 == widths_[c]) {
+                    break;
+                }
+                taken++;
+            }
+            line += byte == '\n' || byte == '\r' || byte == '\t' ? ' ' : text[i];
+        }
+        if (!fits) {
+            line += "…";
+            taken++;
+        }
+        line.append(widths_[c] - taken, ' ');
+        column += widths_[c] + 3;
+    }
+
+    return line;
+}
+
+size_t CsvTable::cellColumn(size_t column, size_t first) const {
+    size_t x = 0;
+    for (auto c = first; c < column && c < columns(); c++) {
+        x += widths_[c] + 3;
+    }
+
+    return x;
+}
+
+size_t CsvTable::width(size_t column) const {
+    return column < columns() ? widths_[column] : 0;
+}
+
+// a parallel merge sort of row numbers, see Parallel::sort
+void CsvTable::sort(size_t column, bool descending, size_t threads) {
+    if (rows() < 3) {
+        return ;
+    }
+
+    if (order_.empty()) {
+        order_.resize(rows());
+        for (size_t i = 0; i < rows(); i++) {
+            order_[i] = static_cast<uint32_t>(i);
+        }
+    }
+
+    // keys by row of the text; cells stay where they are in the text
+    std::vector<std::string_view> keys(rows());
+    std::vector<double> numbers(rows());
+    std::atomic<bool> numeric = true;
+    auto blocks = (rows() + rowBlock_ - 1) / rowBlock_;
+    Parallel::forEach(blocks, threads, [&](size_t i) {
+        for (auto row = std::max<size_t>(i * rowBlock_, 1); row < std::min(rows(), (i + 1) * rowBlock_); row++) {
+            auto stored = order_[row];
+            keys[stored] = raw(row, column);
+            if (numeric && !keys[stored].empty() && !number(keys[stored], numbers[stored])) {
+                numeric = false;
+            }
+        }
+    });
+
+    auto less = [&](uint32_t a, uint32_t b) {
+        if (numeric) {
+            return descending ? numbers[b] < numbers[a] : numbers[a] < numbers[b];
+        }
+        return descending ? keys[b] < keys[a] : keys[a] < keys[b];
+    };
+
+    // the header stays first
+    Parallel::sort(order_, 1, less, threads);
+}
\ No newline at end of file
@@ -1,44 +1,410 @@
 #include "Editor.h"
 #include "CommandPool.h"
+#include "MappedFile.h"
+#include "Substitute.h"
+#include "TextScan.h"
+#include "Utf8.h"
 #include "glm/fwd.hpp"
 #include <algorithm>
+#include <charconv>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <format>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 
 Editor::Editor(int32_t width, int32_t height, int32_t lineHeight, int32_t fontAdvance, int32_t showWordsOffset) : screen_(width, height), lineHeight_(lineHeight), showLines_(height / lineHeight), fontAdvance_(fontAdvance), showWordsOffset_(showWordsOffset) {
     showLines_ -= showLinesOffset_;
 
-    lines_.resize(1);
-
     if (fontAdvance != 0) {
         showWords_ = width / fontAdvance - showWordsOffset;
     }
+    publish();
+}
+
+// in chunks, dropping each one from memory once it is decoded; the text is
+// kept in the added buffer, where what is far from the screen is compressed
+PieceTable Editor::decode(const MappedFile& file, Transcode::Format format) {
+    constexpr size_t chunk = 1 << 20;
+    Transcode::Stream stream(format.encoding_, Transcode::Utf8);
+    PieceTable document;
+    std::string text;
+    for (size_t offset = Transcode::bom(format).size(); offset < file.size(); offset += chunk) {
+        auto length = std::min(chunk, file.size() - offset);
+        text.clear();
+        stream.convert(file.view().substr(offset, length), text);
+        file.release(offset, length);
+        document.insert(document.size(), text);
+    }
+    text.clear();
+    stream.finish(text);
+    document.insert(document.size(), text);
+
+    return document;
 }
 
 void Editor::init(const std::string& path) {
-    std::fstream file(path);
-    std::string line;
-    if (!file.is_open()) {
+    auto file = std::make_shared<MappedFile>(path);
+    if (!file->valid()) {
+        std::cout << std::format("faield to open file: {}\n", path);
+        return ;
+    }
+
+    // a large file is only sampled; a character cut by the sample is ignored
+    auto large = file->size() >= pagedThreshold_;
+    format_ = Transcode::detect(large ? file->view().substr(0, 1 << 20) : file->view(), !large);
+    if (format_.encoding_ != Transcode::Utf16LE && format_.encoding_ != Transcode::Utf16BE && HexView::binary(file->view())) {
+        // binary bytes have no lines and mostly no glyphs
+        hex(file);
+        return ;
+    }
+    if (large && format_.encoding_ == Transcode::Utf8 && !format_.bom_) {
+        // too big to index up front: read-only, lines are paged in on demand
+        document_.clear();
+        paged_ = std::make_shared<PagedDocument>(file);
+        recovery_.reset();
+        sync_ = std::make_shared<FileSync>(path);
+    } else {
+        // the mapping becomes the original buffer, only line starts are computed
+        paged_.reset();
+        if (format_.encoding_ == Transcode::Utf8) {
+            document_ = PieceTable(file, file->view().substr(Transcode::bom(format_).size()));
+            mapped_ = file->mapped() ? file : nullptr;
+        } else {
+            document_ = decode(*file, format_);
+        }
+        recovery_.reset();
+        recovery_ = std::make_shared<RecoveryJournal>(path + ".journal", RecoveryJournal::fingerprint(path, file->view()));
+        auto recovered = recovery_->replay(document_);
+        if (recovered > 0) {
+            std::cout << std::format("recovered {} unsaved edits from {}.journal\n", recovered, path);
+        }
+        // a change to the mapped bytes is found and merged; decoded text can
+        // only be read again
+        sync_ = std::make_shared<FileSync>(path, format_.encoding_ == Transcode::Utf8 ? file : nullptr, Transcode::bom(format_).size());
+        if (recovered > 0) {
+            sync_->mismatch(document_.size());
+        }
+        if (format_.encoding_ != Transcode::Utf8 || format_.bom_) {
+            std::cout << std::format("opened {} as {}\n", path, Transcode::name(format_));
+        }
+    }
+    tail_.reset();
+    hex_.reset();
+    table_.reset();
+    opened(path);
+}
+
+void Editor::hex(const std::string& path) {
+    auto file = std::make_shared<MappedFile>(path);
+    if (!file->valid()) {
+        std::cout << std::format("faield to open file: {}\n", path);
+        return ;
+    }
+
+    hex(file);
+}
+
+void Editor::hex(std::shared_ptr<MappedFile> file) {
+    document_.clear();
+    paged_.reset();
+    recovery_.reset();
+    tail_.reset();
+    table_.reset();
+    format_ = {};
+    hex_ = std::make_shared<HexView>(file);
+    sync_ = std::make_shared<FileSync>(file->path());
+    opened(file->path());
+}
+
+void Editor::table(const std::string& path) {
+    init(path);
+    if (!hex_) {
+        table(true);
+    }
+}
+
+// a view over the text as it is; an unedited file is parsed in place, an
+// edited one from a copy. The cursor keeps its place in the text
+void Editor::table(bool show) {
+    if (show == (table_ != nullptr) || hex_ || tail_) {
+        return ;
+    }
+
+    auto at = offset(cursorPos_);
+    if (!show) {
+        table_.reset();
+    } else if (paged_) {
+        auto text = paged_->view();
+        table_ = std::make_shared<CsvTable>(paged_, text, CsvTable::separator(fileName_, text.substr(0, 1 << 16)));
+    } else {
+        auto pieces = document_.pieces();
+        std::shared_ptr<const void> owner = document_.originalOwner();
+        std::string_view text = document_.original();
+        if (pieces.size() != 1 || pieces.front() != text) {
+            auto copy = std::make_shared<const std::string>(document_.text());
+            owner = copy;
+            text = *copy;
+        }
+        table_ = std::make_shared<CsvTable>(owner, text, CsvTable::separator(fileName_, text.substr(0, 1 << 16)));
+    }
+
+    tableColumn_ = 0;
+    cursorPos_ = position(std::min(at, stats().bytes_));
+    layouts_.clear();
+    clearCursors();
+    moveLimit();
+    if (table_) {
+        scrollTable();
+    }
+}
+
+// column is a number counted from 1 or a name in the header row
+bool Editor::sortTable(const std::string& column, bool descending) {
+    if (!table_ || table_->rows() == 0) {
+        return false;
+    }
+
+    auto index = table_->columns();
+    size_t number = 0;
+    auto end = column.data() + column.size();
+    auto parsed = std::from_chars(column.data(), end, number);
+    if (!column.empty() && parsed.ptr == end) {
+        // columns count from 1; 0, a number past the last or too long to parse is none
+        if (parsed.ec != std::errc() || number == 0 || number > table_->columns()) {
+            return false;
+        }
+        index = number - 1;
+    } else {
+        for (size_t c = 0; c < table_->columns(); c++) {
+            if (table_->cell(0, c) == column) {
+                index = c;
+                break;
+            }
+        }
+    }
+    if (index >= table_->columns()) {
+        return false;
+    }
+
+    table_->sort(index, descending);
+    cursorPos_ = {static_cast<int32_t>(index), 0};
+    moveLimit();
+    scrollTable();
+
+    return true;
+}
+
+// the first shown column follows the cursor's cell so that cell is on screen
+void Editor::scrollTable() {
+    auto cell = static_cast<size_t>(cursorPos_.x);
+    if (cell < tableColumn_) {
+        tableColumn_ = cell;
+    }
+    while (tableColumn_ < cell && table_->cellColumn(cell, tableColumn_) + table_->width(cell) > static_cast<size_t>(std::max(showWords_, 0))) {
+        tableColumn_++;
+    }
+}
+
+// read-only, taken as UTF-8, and kept up with the file's writer by update()
+void Editor::follow(const std::string& path) {
+    auto file = std::make_shared<MappedFile>(path);
+    if (!file->valid()) {
         std::cout << std::format("faield to open file: {}\n", path);
         return ;
     }
 
-    lines_.clear();
+    follow(file);
+}
+
+void Editor::follow(std::shared_ptr<MappedFile> file) {
+    paged_.reset();
+    hex_.reset();
+    table_.reset();
+    recovery_.reset();
+    sync_.reset();
+    format_ = {};
+    document_ = PieceTable(file, file->view());
+    tail_ = std::make_shared<LogTail>(file->path(), file->size());
+    opened(file->path());
+
+    cursorPos_.y = static_cast<int32_t>(lineCount()) - 1;
+    moveLimit();
+}
+
+void Editor::opened(const std::string& path) {
     cursorPos_.x = cursorPos_.y = 0;
+    tableColumn_ = 0;
+    limit_ = {};
+    journal_.clear();
+    search_.clear();
+    searchPiecesValid_ = false;
+    layouts_.clear();
+    rewrap();
+    folds_.clear();
+    clearCursors();
+    publish();
+    diverged_ = false;
+    saving_ = 0;
 
     fileName_ = path;
-    while (std::getline(file, line)) {
-        insertStr(line);
-        enter();
+
+    moveLimit();
+}
+
+// takes in a change another process made to the open file; true when the
+// document changed. Only the bytes that differ are replaced, as one undo
+// step, and the cursor and the view stay on the text they were on. A change
+// that meets an unsaved edit leaves the document alone
+bool Editor::reload() {
+    FileSync::Change change;
+    auto status = sync_->compare(change);
+    if (status == FileSync::Unchanged) {
+        return false;
+    }
+    if (status == FileSync::Missing) {
+        std::cout << std::format("{} was removed from disk\n", fileName_);
+        return false;
+    }
+
+    size_t begin, end;
+    if (status == FileSync::Truncated) {
+        if (sync_->clean()) {
+            reopen();
+            return true;
+        }
+        // the edits and the recovery journal stay until reload. A copied
+        // original is untouched; a mapped one reads zeros past the file's new
+        // end, and what is left of it is copied before it is cut again
+        diverged_ = true;
+        auto mapping = mapped_.lock();
+        if (!mapping || document_.originalOwner() != mapping) {
+            std::cout << std::format("{} was cut short on disk under unsaved edits; save! writes over it, reload takes it\n", fileName_);
+            return false;
+        }
+        document_.ownOriginal();
+        searchPiecesValid_ = false;
+        std::cout << std::format("{} was cut short on disk under unsaved edits; the text it had past its new end is lost and reads as NUL bytes, reload takes the file\n", fileName_);
+        return false;
     }
+    if (status == FileSync::Rewritten || table_) {
+        // read again from scratch, which only the unedited can be
+        if (!sync_->clean()) {
+            diverged_ = true;
+            std::cout << std::format("{} was rewritten on disk under unsaved edits; save! writes over it, reload takes it\n", fileName_);
+            return false;
+        }
+        reopen();
+        return true;
+    }
+    if (!sync_->merge(change, begin, end)) {
+        diverged_ = true;
+        rebaseRecovery();
+        std::cout << std::format("{} changed on disk where it has unsaved edits; save! writes over it, reload takes it\n", fileName_);
+        return false;
+    }
+
+    auto moved = [&](size_t offset) {
+        return offset < begin ? offset : offset >= end ? offset - (end - begin) + change.text_.size() : begin;
+    };
+    auto cursor = offset(cursorPos_);
+    auto top = document_.lineStart(std::min<size_t>(std::max(limit_.up_, 0), document_.lineCount() - 1));
+    journal_.begin();
+    if (end > begin) {
+        journal_.recordErase(begin, document_.text(begin, end - begin));
+    }
+    if (!change.text_.empty()) {
+        journal_.recordInsert(begin, change.text_);
+    }
+    applyText(begin, end - begin, change.text_, false);
+    journal_.end();
+    rebaseRecovery();
 
-    file.close();
+    limit_.up_ = static_cast<int32_t>(document_.lineOf(moved(top)));
+    limit_.bottom_ = limit_.up_ + showLines_;
+    cursorPos_ = position(moved(cursor));
+    moveLimit();
+
+    return true;
+}
+
+// the file read again from scratch, unsaved edits dropped; the cursor and the
+// view stay on the same line numbers
+void Editor::reopen() {
+    auto cursor = cursorPos_;
+    auto limit = limit_;
+    if (recovery_) {
+        // or the recovery journal would bring them back
+        recovery_->rebase(recovery_->position(), {});
+        recovery_.reset();
+    }
+    if (hex_) {
+        hex(fileName_);
+    } else if (table_) {
+        table(fileName_);
+        cursor.x = 0;
+    } else {
+        init(fileName_);
+    }
+
+    limit_ = limit;
+    limit_.bottom_ = limit.up_ + showLines_;
+    cursorPos_ = cursor;
+    if (paged_) {
+        // its lines are still being counted
+        moveLimit();
+    } else {
+        adjustCursor();
+    }
+}
+
+// the recovery journal restarted on the file as it is now, holding what the
+// document has that the file does not
+void Editor::rebaseRecovery() {
+    if (!recovery_ || !sync_->file()) {
+        return ;
+    }
+
+    recovery_->rebase(recovery_->position(), RecoveryJournal::fingerprint(fileName_, sync_->file()->view()));
+    for (auto& hunk : sync_->hunks()) {
+        recovery_->append(hunk.docBegin_, hunk.baseEnd_ - hunk.baseBegin_, document_.text(hunk.docBegin_, hunk.docEnd_ - hunk.docBegin_));
+    }
+}
+
+// appends what the followed file gained, at most tailBudget_ bytes a frame;
+// the view stays on the end unless the cursor was moved off the last line
+bool Editor::followTail() {
+    tailBuffer_.clear();
+    auto status = tail_->read(tailBuffer_, tailBudget_);
+    if (status == LogTail::Restart) {
+        // a rotated log comes back under the same name; until it does the
+        // old contents stay on screen
+        auto file = std::make_shared<MappedFile>(fileName_);
+        if (!file->valid()) {
+            return false;
+        }
+        follow(file);
+        return true;
+    }
+    if (status != LogTail::Appended) {
+        return false;
+    }
+
+    auto atEnd = cursorPos_.y + 1 >= static_cast<int32_t>(lineCount());
+    // as any edit, so the layouts, wraps, folds and matches take the new text in
+    applyText(document_.size(), 0, tailBuffer_, false);
+    if (atEnd) {
+        cursorPos_ = {0, static_cast<int32_t>(lineCount()) - 1};
+        moveLimit();
+    }
+
+    return true;
 }
 
 Editor::Mode Editor::mode() const {
@@ -46,114 +412,268 @@ Editor::Mode Editor::mode() const {
 }
 
 void Editor::enter() {
-    auto& currLine = lines_[cursorPos_.y];
-    auto newLine = std::string(currLine.begin() + cursorPos_.x + lineNumberOffset_, currLine.end());
-    currLine.erase(currLine.begin() + cursorPos_.x + lineNumberOffset_, currLine.end());
+    if (readOnly()) {
+        return ;
+    }
+
+    if (multiCursor()) {
+        editCursors(0, "\n");
+        return ;
+    }
+
+    journal_.begin();
+    insertText(offset(cursorPos_), "\n");
+    journal_.end();
 
     cursorPos_.y++;
     cursorPos_.x = 0;
-    lines_.insert(lines_.begin() + cursorPos_.y, newLine);
 
     moveLimit();
 }
 
 void Editor::backspace() {
-    auto& currLine = lines_[cursorPos_.y];
+    if (multiCursor()) {
+        editCursors(1, {});
+        return ;
+    }
 
-    if (cursorPos_.x == 0 && cursorPos_.y == 0) {
+    if (readOnly() || (cursorPos_.x == 0 && cursorPos_.y == 0)) {
         return ;
     }
     
-    if (lineEmpty(currLine)) {
-        lines_.erase(lines_.begin() + cursorPos_.y);
+    journal_.begin();
+    if (lineEmpty(cursorPos_.y)) {
+        eraseText(document_.lineStart(cursorPos_.y) - 1, 1);
         cursorPos_.y--;
-        cursorPos_.x = lines_[cursorPos_.y].size() - lineNumberOffset_;
+        cursorPos_.x = lineSize(cursorPos_.y) - lineNumberOffset_;
     } else {
         delteChar();
     }
+    journal_.end();
 
     moveLimit();
 }
 
 void Editor::insertChar(char c) {
-    if (cursorPos_.y >= lines_.size()) {
-        lines_.push_back({});
+    if (readOnly()) {
+        return ;
     }
-    
-    auto& currLine = lines_[cursorPos_.y];
 
-    currLine.insert(currLine.begin() + cursorPos_.x + lineNumberOffset_, c);
-    cursorPos_.x++;
+    if (multiCursor()) {
+        editCursors(0, std::string_view(&c, 1));
+        return ;
+    }
 
-    wordCount_++;
+    journal_.begin(true);
+    if (cursorPos_.y >= static_cast<int64_t>(lineCount())) {
+        insertText(document_.size(), "\n");
+    }
+
+    insertText(offset(cursorPos_), std::string_view(&c, 1));
+    journal_.end();
+    cursorPos_.x++;
 
     moveLimit();
 }
 
 void Editor::insertStr(const std::string& str) {
-    for (size_t i = 0; i < str.size(); i++) {
-        insertChar(str[i]);
+    if (multiCursor()) {
+        editCursors(0, str);
+        return ;
     }
-}
 
-void Editor::delteChar() {
-    auto& currLine = lines_[cursorPos_.y];
+    if (readOnly()) {
+        return ;
+    }
 
-    if (cursorPos_.x == 0) {
-        lines_[cursorPos_.y - 1] += std::string(currLine.begin() + lineNumberOffset_, currLine.end());
-        lines_.erase(lines_.begin() + cursorPos_.y);
-        cursorPos_.y--;
-        cursorPos_.x = lines_[cursorPos_.y].size() - lineNumberOffset_;
-    } else {
-        currLine.erase(currLine.begin() + (cursorPos_.x + lineNumberOffset_ - 1));
-        cursorPos_.x--;
+    journal_.begin();
+    if (cursorPos_.y >= static_cast<int64_t>(lineCount())) {
+        insertText(document_.size(), "\n");
     }
+    insertRange(offset(cursorPos_), str);
+    journal_.end();
+}
 
-    wordCount_--;
+void Editor::delteChar() {
+    if (readOnly()) {
+        return ;
+    }
 
-    moveLimit();
+    // at the start of a line the line feed before it goes, elsewhere the
+    // whole grapheme cluster before the cursor
+    size_t length = 1;
+    if (cursorPos_.x > 0) {
+        auto& bounds = graphemes(cursorPos_.y);
+        auto it = std::lower_bound(bounds.begin(), bounds.end(), static_cast<uint32_t>(cursorPos_.x + lineNumberOffset_));
+        length = cursorPos_.x + lineNumberOffset_ - *std::prev(it);
+    }
+    eraseRange(offset(cursorPos_) - length, length);
 }
 
 void Editor::moveCursor(Editor::Direction dir) {
+    if (hex_) {
+        // a byte left or right, a row up or down, never past the last byte
+        int64_t step = dir == Left ? -1 : dir == Right ? 1 : dir == Up ? -static_cast<int64_t>(HexView::bytesPerRow_) : HexView::bytesPerRow_;
+        auto at = static_cast<int64_t>(offset(cursorPos_)) + step;
+        if (at >= 0 && at < static_cast<int64_t>(hex_->size())) {
+            cursorPos_ = position(at);
+            moveLimit();
+        }
+        return ;
+    }
+
+    if (table_) {
+        // a row up or down, a cell left or right
+        if (dir == Up || dir == Down) {
+            auto row = cursorPos_.y + (dir == Up ? -1 : 1);
+            if (row < 0 || row >= static_cast<int32_t>(table_->rows())) {
+                return ;
+            }
+            cursorPos_.y = row;
+        } else {
+            auto cell = cursorPos_.x + (dir == Left ? -1 : 1);
+            if (cell < 0 || cell >= static_cast<int32_t>(table_->columns())) {
+                return ;
+            }
+            cursorPos_.x = cell;
+            scrollTable();
+        }
+        moveLimit();
+        return ;
+    }
+
     switch (dir) {
     case Up:
-        if (cursorPos_.y == 0) {
+    case Down: {
+        if (dir == Up ? cursorPos_.y <= 0 : cursorPos_.y + 1 >= static_cast<int64_t>(lineCount())) {
             return ;
         }
-        cursorPos_.y--;
-        cursorPos_.x = std::min(cursorPos_.x, static_cast<int32_t>(lines_[cursorPos_.y].size() - lineNumberOffset_));
-        break;
-    case Down:
-        if (cursorPos_.y >= lines_.size() - 1) {
-            return ;
+        auto line = cursorPos_.y + (dir == Up ? -1 : 1);
+        if (folded()) {
+            // past the lines closed folds hide
+            line = static_cast<int32_t>(dir == Up ? folds_.shown(line) : folds_.next(line));
+            if (line >= static_cast<int32_t>(lineCount())) {
+                return ;
+            }
         }
-        cursorPos_.y++;
-        cursorPos_.x = std::min(cursorPos_.x, static_cast<int32_t>(lines_[cursorPos_.y].size() - lineNumberOffset_));
+        // keep the on-screen column rather than the byte column
+        auto at = column(cursorPos_);
+        cursorPos_.y = line;
+        cursorPos_.x = columnOffset(cursorPos_.y, at);
         break;
-    case Right:
-        if (cursorPos_.x + lineNumberOffset_ >= lines_[cursorPos_.y].size()) {
+    }
+    case Right: {
+        auto& bounds = graphemes(cursorPos_.y);
+        auto it = std::upper_bound(bounds.begin(), bounds.end(), static_cast<uint32_t>(cursorPos_.x + lineNumberOffset_));
+        if (it == bounds.end()) {
             return ;
         }
-        cursorPos_.x++;
+        cursorPos_.x = *it - lineNumberOffset_;
         break;
-    case Left:
+    }
+    case Left: {
         if (cursorPos_.x <= 0) {
             return ;
         }
-        cursorPos_.x--;
+        auto& bounds = graphemes(cursorPos_.y);
+        auto it = std::lower_bound(bounds.begin(), bounds.end(), static_cast<uint32_t>(cursorPos_.x + lineNumberOffset_));
+        cursorPos_.x = *std::prev(it) - lineNumberOffset_;
         break;
     }
+    }
 
     moveLimit();
 }
 
 void Editor::setCursor(glm::ivec2 cursorPos) {
     cursorPos_ = cursorPos;
+    journal_.breakTyping();
 
     moveLimit();
 }
 
 void Editor::moveLimit() {
+    if (folded()) {
+        // a fold the cursor got into, by a jump or an edit, opens
+        folds_.reveal(std::max(cursorPos_.y, 0));
+    }
+    if (folded()) {
+        // screen rows are walked one by one past the hidden lines, from the
+        // top to the cursor and from the top to the bottom; a line takes one
+        // row, or its wrapped rows
+        auto lines = static_cast<int32_t>(lineCount());
+        auto height = [this](int32_t line) {
+            return wrapped() ? static_cast<int32_t>(wrap_.height(line)) : 1;
+        };
+        auto down = [&](Row at) -> Row {
+            if (at.row_ + 1 < height(at.line_)) {
+                return {at.line_, at.row_ + 1};
+            }
+            return {static_cast<int32_t>(folds_.next(at.line_ + 1)), 0};
+        };
+        auto up = [&](Row at) -> Row {
+            if (at.row_ > 0) {
+                return {at.line_, at.row_ - 1};
+            }
+            auto line = static_cast<int32_t>(folds_.shown(at.line_ - 1));
+            return {line, height(line) - 1};
+        };
+        auto before = [](Row a, Row b) {
+            return a.line_ < b.line_ || (a.line_ == b.line_ && a.row_ < b.row_);
+        };
+
+        auto line = std::clamp(cursorPos_.y, 0, lines - 1);
+        Row cursor{line, wrapped() ? wrapRow(line, column({cursorPos_.x, line})) : 0};
+        auto first = static_cast<int32_t>(folds_.shown(std::clamp(limit_.up_, 0, lines - 1)));
+        Row top{first, first == limit_.up_ ? std::clamp(limit_.upRow_, 0, height(first) - 1) : 0};
+        auto shown = std::max(showLines_, 1);
+        if (before(cursor, top)) {
+            top = cursor;
+        } else {
+            auto at = top;
+            for (int32_t i = 0; i + 1 < shown && before(at, cursor); i++) {
+                at = down(at);
+            }
+            if (before(at, cursor)) {
+                top = cursor;
+                for (int32_t i = 0; i + 1 < shown && (top.line_ > 0 || top.row_ > 0); i++) {
+                    top = up(top);
+                }
+            }
+        }
+
+        auto bottom = top;
+        for (int32_t i = 0; i + 1 < shown && bottom.line_ < lines; i++) {
+            bottom = down(bottom);
+        }
+        limit_.up_ = top.line_;
+        limit_.upRow_ = top.row_;
+        limit_.bottom_ = std::min(bottom.line_, lines - 1) + 1;
+        return ;
+    }
+    if (wrapped()) {
+        // the same in rows: the window is the lines the showLines_ rows from
+        // the top reach, the first and the last possibly in part
+        auto lines = wrap_.lines();
+        auto up = std::min<size_t>(std::max(limit_.up_, 0), lines - 1);
+        auto top = wrap_.rowOf(up) + std::min<size_t>(std::max(limit_.upRow_, 0), wrap_.height(up) - 1);
+        auto line = static_cast<int32_t>(std::min<size_t>(std::max(cursorPos_.y, 0), lines - 1));
+        auto cursor = wrap_.rowOf(line) + wrapRow(line, column({cursorPos_.x, line}));
+        auto shown = static_cast<size_t>(std::max(showLines_, 1));
+        if (cursor < top) {
+            top = cursor;
+        } else if (cursor >= top + shown) {
+            top = cursor - shown + 1;
+        }
+
+        auto [first, row] = wrap_.lineAt(top);
+        limit_.up_ = static_cast<int32_t>(first);
+        limit_.upRow_ = static_cast<int32_t>(row);
+        limit_.bottom_ = static_cast<int32_t>(wrap_.lineAt(std::min(top + shown, wrap_.rows()) - 1).first) + 1;
+        return ;
+    }
+
+    limit_.upRow_ = 0;
     if (cursorPos_.y < limit_.up_) {
         limit_.up_ = cursorPos_.y;
     } else if (cursorPos_.y >= limit_.bottom_) {
@@ -164,8 +684,581 @@ void Editor::moveLimit() {
     limit_.bottom_ = limit_.up_ + showLines_;
 }
 
-bool Editor::lineEmpty(const std::string& line) {
-    return line.size() - lineNumberOffset_ <= 0;
+bool Editor::lineEmpty(int32_t line) const {
+    return static_cast<int64_t>(lineSize(line)) <= lineNumberOffset_;
+}
+
+// in the hex view a line is a row and cursorPos_.x the byte within it
+size_t Editor::lineCount() const {
+    if (hex_) {
+        return hex_->rows();
+    }
+    if (table_) {
+        return std::max<size_t>(table_->rows(), 1);
+    }
+    return paged_ ? paged_->lineCount() : document_.lineCount();
+}
+
+size_t Editor::lineSize(int32_t line) const {
+    if (hex_) {
+        return hex_->width();
+    }
+    if (table_) {
+        return this->line(line).size();
+    }
+    return paged_ ? paged_->lineLength(line) : document_.lineLength(line);
+}
+
+char Editor::charAt(int32_t line, int32_t column) const {
+    if (hex_) {
+        return hex_->row(line)[column];
+    }
+    if (table_) {
+        return this->line(line)[column];
+    }
+    return paged_ ? paged_->at(line, column) : document_.at(document_.lineStart(line) + column);
+}
+
+std::string Editor::line(int32_t line) const {
+    if (hex_) {
+        return hex_->row(line);
+    }
+    if (table_) {
+        return line < static_cast<int32_t>(table_->rows()) ? table_->line(line, tableColumn_, std::max(showWords_, 0)) : std::string();
+    }
+    return paged_ ? paged_->line(line) : document_.line(line);
+}
+
+std::vector<std::string> Editor::lines(int32_t first, int32_t last) const {
+    if (hex_) {
+        std::vector<std::string> rows;
+        for (auto row = first; row < last && row < static_cast<int32_t>(hex_->rows()); row++) {
+            rows.push_back(hex_->row(row));
+        }
+        return rows;
+    }
+    if (table_) {
+        std::vector<std::string> rows;
+        for (auto row = first; row < last && row < static_cast<int32_t>(table_->rows()); row++) {
+            rows.push_back(line(row));
+        }
+        return rows;
+    }
+    return paged_ ? paged_->lines(first, last) : document_.lines(first, last);
+}
+
+size_t Editor::offset(glm::ivec2 pos) const {
+    if (hex_) {
+        return static_cast<size_t>(pos.y) * HexView::bytesPerRow_ + pos.x;
+    }
+    if (table_) {
+        return table_->rows() == 0 ? 0 : table_->offset(pos.y, pos.x);
+    }
+    return (paged_ ? paged_->lineStart(pos.y) : document_.lineStart(pos.y)) + pos.x + lineNumberOffset_;
+}
+
+bool Editor::readOnly() const {
+    return paged_ != nullptr || tail_ != nullptr || hex_ != nullptr || table_ != nullptr;
+}
+
+// a line's clusters and the column each starts at, a tab reaching to the
+// next multiple of tabWidth_; built when first asked for and kept until an
+// edit touches that line, so moving along a long line never rescans it
+const Editor::Layout& Editor::layout(int32_t line) const {
+    auto it = layouts_.find(line);
+    if (it != layouts_.end()) {
+        return it->second;
+    }
+
+    if (layouts_.size() >= maxLayouts_) {
+        layouts_.clear();
+    }
+    auto text = this->line(line);
+    auto& layout = layouts_[line];
+    Utf8::graphemes(text, layout.bounds_);
+    layout.columns_.resize(layout.bounds_.size());
+    uint32_t column = 0;
+    for (size_t i = 0; i < layout.bounds_.size(); i++) {
+        layout.columns_[i] = column;
+        if (i + 1 < layout.bounds_.size()) {
+            column += text[layout.bounds_[i]] == '\t' ? tabWidth_ - column % tabWidth_ : 1;
+        }
+    }
+
+    return layout;
+}
+
+// boundaries of the clusters on line, the last one is the line's length
+const std::vector<uint32_t>& Editor::graphemes(int32_t line) const {
+    return layout(line).bounds_;
+}
+
+// the on-screen column of pos
+int32_t Editor::column(glm::ivec2 pos) const {
+    if (hex_) {
+        return static_cast<int32_t>(hex_->hexColumn(pos.x));
+    }
+    if (table_) {
+        return static_cast<int32_t>(table_->cellColumn(pos.x, tableColumn_));
+    }
+
+    auto& layout = this->layout(pos.y);
+    auto at = static_cast<uint32_t>(pos.x + lineNumberOffset_);
+    auto i = std::lower_bound(layout.bounds_.begin(), layout.bounds_.end(), at) - layout.bounds_.begin();
+
+    return layout.columns_[std::min<size_t>(i, layout.columns_.size() - 1)];
+}
+
+// the byte column of the last cluster on line starting at or before column
+int32_t Editor::columnOffset(int32_t line, int32_t column) const {
+    auto& layout = this->layout(line);
+    auto it = std::upper_bound(layout.columns_.begin(), layout.columns_.end(), static_cast<uint32_t>(std::max(column, 0)));
+
+    return layout.bounds_[it - layout.columns_.begin() - 1] - lineNumberOffset_;
+}
+
+// lines offset..offset + erase spans are rewritten, cached ones after them
+// are renumbered by the line feeds gained or lost
+void Editor::editLayouts(size_t offset, size_t erase, std::string_view insert) {
+    if (layouts_.empty()) {
+        return ;
+    }
+
+    auto first = static_cast<int32_t>(document_.lineOf(offset));
+    auto last = static_cast<int32_t>(document_.lineOf(offset + erase));
+    auto shift = static_cast<int32_t>(TextScan::count(insert.data(), insert.size(), '\n')) - (last - first);
+    if (shift == 0) {
+        layouts_.erase(layouts_.lower_bound(first), layouts_.upper_bound(last));
+        return ;
+    }
+
+    std::map<int32_t, Layout> moved;
+    for (auto it = layouts_.upper_bound(last); it != layouts_.end(); ++it) {
+        moved.emplace_hint(moved.end(), it->first + shift, std::move(it->second));
+    }
+    layouts_.erase(layouts_.lower_bound(first), layouts_.end());
+    layouts_.merge(moved);
+}
+
+void Editor::setTabWidth(int32_t width) {
+    tabWidth_ = std::clamp(width, 1, maxTabWidth_);
+    layouts_.clear();
+    rewrap();
+    moveLimit();
+}
+
+void Editor::setWrap(bool wrap) {
+    if (wrap && paged_) {
+        std::cout << std::format("{} is too large to wrap\n", fileName_);
+    }
+    wrapping_ = wrap;
+    limit_.upRow_ = 0;
+    rewrap();
+    moveLimit();
+}
+
+// a table lays out its own rows
+bool Editor::wrapped() const {
+    return wrap_.lines() > 0 && !table_;
+}
+
+// every line measured again, for a new document or tab width; a new width
+// only divides the columns again, see adjust(). A paged file is not wrapped:
+// measuring it would read the whole mapping
+void Editor::rewrap() {
+    if (!wrapping_ || hex_ || paged_) {
+        wrap_.clear();
+        return ;
+    }
+
+    std::vector<uint32_t> columns;
+    columns.reserve(lineCount());
+    WrapIndex::measure(document_.pieces(), tabWidth_, columns);
+    wrap_.assign(columns, std::max(showWords_, 1));
+}
+
+// document bytes offset..offset + length were just written over text with
+// shift fewer line feeds; only the lines they are on are measured again, and
+// the folds after them move with the shift
+void Editor::linesEdited(size_t offset, size_t length, int64_t shift) {
+    if (wrap_.lines() == 0 && folds_.empty()) {
+        return ;
+    }
+
+    auto first = document_.lineOf(offset);
+    auto last = document_.lineOf(offset + length);
+    folds_.edited(first, static_cast<size_t>(static_cast<int64_t>(last) - shift), last);
+    if (wrap_.lines() == 0) {
+        return ;
+    }
+
+    std::vector<uint32_t> columns;
+    for (auto& line : document_.lines(first, last + 1)) {
+        columns.push_back(WrapIndex::measure(line, tabWidth_));
+    }
+    wrap_.splice(first, static_cast<size_t>(static_cast<int64_t>(columns.size()) - shift), columns);
+}
+
+// the wrapped row of line that column is on; the end of a line filling its
+// last row stays on that row
+int32_t Editor::wrapRow(int32_t line, int32_t column) const {
+    return static_cast<int32_t>(std::min<uint32_t>(std::max(column, 0) / wrap_.width(), wrap_.height(line) - 1));
+}
+
+// the line and the wrapped row on each screen row, from the top
+std::vector<Editor::Row> Editor::showRows() const {
+    std::vector<Row> rows;
+    auto shown = static_cast<size_t>(std::max(showLines_, 1));
+    auto last = std::min<int64_t>(limit_.bottom_, lineCount());
+    auto row = std::max(limit_.upRow_, 0);
+    auto folded = this->folded();
+    for (auto line = std::max(limit_.up_, 0); line < last && rows.size() < shown; row = 0) {
+        auto height = wrapped() ? static_cast<int32_t>(wrap_.height(line)) : 1;
+        for (; row < height && rows.size() < shown; row++) {
+            rows.push_back({line, row});
+        }
+        line = folded ? static_cast<int32_t>(folds_.next(line + 1)) : line + 1;
+    }
+
+    return rows;
+}
+
+bool Editor::folded() const {
+    return folds_.closed() && !hex_ && !table_;
+}
+
+// opens the folds starting on the cursor's line, or else closes the innermost
+// one around it; the folds come from the text the first time. A paged file
+// only has the folds made with fold(), deriving would read the whole mapping
+bool Editor::toggleFold() {
+    if (hex_ || table_) {
+        return false;
+    }
+
+    if (!folds_.derived() && !paged_) {
+        folds_.derive(document_.pieces(), tabWidth_);
+    }
+    if (!folds_.toggle(cursorPos_.y)) {
+        return false;
+    }
+    // the cursor goes to the line its own is folded into
+    auto line = static_cast<int32_t>(folds_.shown(cursorPos_.y));
+    if (line != cursorPos_.y) {
+        cursorPos_ = {0, line};
+    }
+
+    moveLimit();
+    return true;
+}
+
+void Editor::fold(int32_t first, int32_t last) {
+    auto lines = static_cast<int32_t>(lineCount());
+    first = std::clamp(first, 0, lines - 1);
+    last = std::clamp(last, 0, lines - 1);
+    if (hex_ || table_ || last <= first) {
+        return ;
+    }
+
+    folds_.add(first, last, true, true);
+    if (folds_.hidden(cursorPos_.y)) {
+        cursorPos_ = {0, static_cast<int32_t>(folds_.shown(cursorPos_.y))};
+    }
+
+    moveLimit();
+}
+
+void Editor::unfold() {
+    folds_.openAll();
+
+    moveLimit();
+}
+
+// the lines hidden after line when a closed fold starts there, else 0
+size_t Editor::foldedAt(int32_t line) const {
+    if (!folded() || folds_.hidden(line)) {
+        return 0;
+    }
+
+    return folds_.next(line + 1) - line - 1;
+}
+
+glm::ivec2 Editor::position(size_t offset) const {
+    if (hex_) {
+        return {static_cast<int32_t>(offset % HexView::bytesPerRow_), static_cast<int32_t>(offset / HexView::bytesPerRow_)};
+    }
+    if (table_) {
+        // the last cell of the row starting at or before offset
+        if (table_->rows() == 0) {
+            return {0, 0};
+        }
+        auto row = table_->rowAt(offset);
+        size_t cell = 0;
+        while (cell + 1 < table_->cells(row) && table_->offset(row, cell + 1) <= offset) {
+            cell++;
+        }
+        return {static_cast<int32_t>(cell), static_cast<int32_t>(row)};
+    }
+
+    auto line = paged_ ? paged_->lineOf(offset) : document_.lineOf(offset);
+    auto start = paged_ ? paged_->lineStart(line) : document_.lineStart(line);
+
+    return {static_cast<int32_t>(offset - start) - lineNumberOffset_, static_cast<int32_t>(line)};
+}
+
+// every document mutation goes through these two so it lands in the journal
+void Editor::insertText(size_t offset, std::string_view text) {
+    journal_.recordInsert(offset, text);
+    applyText(offset, 0, text);
+}
+
+void Editor::eraseText(size_t offset, size_t length) {
+    journal_.recordErase(offset, document_.text(offset, length));
+    applyText(offset, length, {});
+}
+
+// the one place document_ changes, edits and undo/redo alike, besides the
+// batched editCursors(). A change that is not local came from the file, which
+// already has it
+void Editor::applyText(size_t offset, size_t erase, std::string_view insert, bool local) {
+    if (recovery_ && local) {
+        recovery_->append(offset, erase, insert);
+    }
+    if (sync_ && local) {
+        sync_->edited(offset, erase, insert.size());
+    }
+
+    auto lines = document_.lineCount();
+    editLayouts(offset, erase, insert);
+    document_.erase(offset, erase);
+    document_.insert(offset, insert);
+    linesEdited(offset, insert.size(), static_cast<int64_t>(document_.lineCount() - lines));
+    searchPiecesValid_ = false;
+    publish();
+    // only editCursors() keeps the other cursors in step with the text
+    cursors_.clear();
+
+    search_.edit(offset, erase, insert.size(), [this](size_t at, size_t length) {
+        return document_.text(at, length);
+    });
+}
+
+// a whole span as one edit and one undo step, whatever its length; a cursor
+// at or after offset moves with the text behind it
+void Editor::insertRange(size_t offset, std::string_view text) {
+    if (readOnly() || text.empty()) {
+        return ;
+    }
+
+    auto cursor = this->offset(cursorPos_);
+    journal_.begin();
+    insertText(offset, text);
+    journal_.end();
+
+    if (cursor >= offset) {
+        cursorPos_ = position(cursor + text.size());
+    }
+    moveLimit();
+}
+
+// a cursor inside the erased bytes ends up where they were
+void Editor::eraseRange(size_t offset, size_t length) {
+    if (readOnly() || offset >= document_.size() || length == 0) {
+        return ;
+    }
+    length = std::min(length, document_.size() - offset);
+
+    auto cursor = this->offset(cursorPos_);
+    journal_.begin();
+    eraseText(offset, length);
+    journal_.end();
+
+    if (cursor >= offset) {
+        cursorPos_ = position(cursor >= offset + length ? cursor - length : offset);
+    }
+    moveLimit();
+}
+
+void Editor::addCursorsAtMatches() {
+    if (readOnly()) {
+        return ;
+    }
+
+    if (!search_.valid()) {
+        if (search_.needle().empty()) {
+            return ;
+        }
+        searchStr(std::string(search_.needle()));
+    }
+
+    cursors_.insert(cursors_.end(), search_.matches().begin(), search_.matches().end());
+    clearCursors(false);
+}
+
+// a cursor on every line in [first, last] at the column of the current one
+void Editor::addCursorsOnLines(int32_t first, int32_t last) {
+    if (readOnly()) {
+        return ;
+    }
+
+    first = std::max(first, 0);
+    last = std::min(last, static_cast<int32_t>(lineCount()) - 1);
+    if (first <= last) {
+        cursors_.reserve(cursors_.size() + (last - first + 1));
+    }
+    for (auto line = first; line <= last; line++) {
+        auto column = std::min<size_t>(cursorPos_.x + lineNumberOffset_, lineSize(line));
+        cursors_.push_back(document_.lineStart(line) + column);
+    }
+    clearCursors(false);
+}
+
+// all removes every other cursor; otherwise cursors_ is only sorted, with
+// duplicates and the one under cursorPos_ dropped
+void Editor::clearCursors(bool all) {
+    if (all) {
+        cursors_.clear();
+        return ;
+    }
+
+    std::sort(cursors_.begin(), cursors_.end());
+    cursors_.erase(std::unique(cursors_.begin(), cursors_.end()), cursors_.end());
+    auto primary = std::lower_bound(cursors_.begin(), cursors_.end(), offset(cursorPos_));
+    if (primary != cursors_.end() && *primary == offset(cursorPos_)) {
+        cursors_.erase(primary);
+    }
+}
+
+bool Editor::multiCursor() const {
+    return !cursors_.empty();
+}
+
+// the other cursors on screen, for drawing
+std::vector<glm::ivec2> Editor::visibleCursors() const {
+    std::vector<glm::ivec2> result;
+    if (cursors_.empty()) {
+        return result;
+    }
+
+    auto up = std::max(limit_.up_, 0);
+    auto bottom = std::min<size_t>(limit_.bottom_, lineCount());
+    auto first = std::lower_bound(cursors_.begin(), cursors_.end(), document_.lineStart(up));
+    auto last = bottom < lineCount() ? std::lower_bound(first, cursors_.end(), document_.lineStart(bottom)) : cursors_.end();
+    result.reserve(last - first);
+    for (auto it = first; it != last; ++it) {
+        auto pos = position(*it);
+        if (!folds_.hidden(pos.y)) {
+            result.push_back(pos);
+        }
+    }
+
+    return result;
+}
+
+// the batched counterpart of applyText: at every cursor the erase bytes before
+// it are replaced by insert in a single pass over the document, with one undo
+// step. A cursor whose erase would reach into the previous cursor's only moves.
+void Editor::editCursors(size_t erase, std::string_view insert) {
+    if (readOnly()) {
+        return ;
+    }
+
+    auto primary = offset(cursorPos_);
+    auto all = cursors_;
+    all.insert(std::lower_bound(all.begin(), all.end(), primary), primary);
+
+    // records and recovery entries are sequential: each offset already
+    // accounts for the edits at the cursors before it
+    std::vector<size_t> starts;
+    starts.reserve(all.size());
+    std::vector<size_t> moved(all.size());
+    // where each edit lands and the line feeds it adds, for the wrap and
+    // fold indexes
+    std::vector<std::pair<size_t, int64_t>> lineEdits;
+    auto feeds = static_cast<int64_t>(TextScan::count(insert.data(), insert.size(), '\n'));
+    size_t primaryAt = 0, previous = 0;
+    journal_.begin();
+    for (size_t k = 0; k < all.size(); k++) {
+        auto cursor = all[k];
+        auto shifted = cursor + starts.size() * insert.size() - starts.size() * erase;
+        if (cursor == primary) {
+            primaryAt = k;
+        }
+        if (cursor < previous + erase) {
+            moved[k] = shifted;
+            previous = cursor;
+            continue;
+        }
+
+        auto at = shifted - erase;
+        int64_t erasedFeeds = 0;
+        if (erase > 0) {
+            auto erased = document_.text(cursor - erase, erase);
+            journal_.recordErase(at, erased);
+            erasedFeeds = static_cast<int64_t>(TextScan::count(erased.data(), erased.size(), '\n'));
+        }
+        if (!insert.empty()) {
+            journal_.recordInsert(at, insert);
+        }
+        if (recovery_) {
+            recovery_->append(at, erase, insert);
+        }
+        if (sync_) {
+            sync_->edited(at, erase, insert.size());
+        }
+        if (wrap_.lines() > 0 || !folds_.empty()) {
+            lineEdits.emplace_back(at, feeds - erasedFeeds);
+        }
+
+        starts.push_back(cursor - erase);
+        moved[k] = at + insert.size();
+        previous = cursor;
+    }
+    journal_.end();
+
+    document_.replaceAt(starts, erase, insert);
+    // in order, each edit's lines are spliced where the ones before it left them
+    for (auto [at, shift] : lineEdits) {
+        linesEdited(at, insert.size(), shift);
+    }
+    searchPiecesValid_ = false;
+    publish();
+    layouts_.clear();
+    // shifting the matches once per cursor would cost more than finding them again
+    search_.clear();
+
+    auto primaryMoved = moved[primaryAt];
+    moved.erase(moved.begin() + primaryAt);
+    cursors_ = std::move(moved);
+    cursorPos_ = position(primaryMoved);
+    clearCursors(false);
+
+    moveLimit();
+}
+
+void Editor::undo() {
+    size_t cursor;
+    auto apply = [this](size_t offset, size_t erase, std::string_view insert) {
+        applyText(offset, erase, insert);
+    };
+    if (readOnly() || !journal_.undo(apply, cursor)) {
+        return ;
+    }
+
+    cursorPos_ = position(cursor);
+    moveLimit();
+}
+
+void Editor::redo() {
+    size_t cursor;
+    auto apply = [this](size_t offset, size_t erase, std::string_view insert) {
+        applyText(offset, erase, insert);
+    };
+    if (readOnly() || !journal_.redo(apply, cursor)) {
+        return ;
+    }
+
+    cursorPos_ = position(cursor);
+    moveLimit();
 }
 
 void Editor::adjust(int32_t width, int32_t height) {
@@ -175,12 +1268,37 @@ void Editor::adjust(int32_t width, int32_t height) {
     limit_.bottom_ = limit_.up_ + showLines_;
    
     showWords_ = width / fontAdvance_ - showWordsOffset_;
+    if (wrap_.lines() > 0) {
+        wrap_.setWidth(std::max(showWords_, 1));
+    }
+    if (wrap_.lines() > 0 || folded()) {
+        moveLimit();
+    }
 }
 
 glm::ivec2 Editor::cursorRenderPos(int32_t offsetX, int32_t fontAdvance) {
+    return renderPos(cursorPos_, offsetX, fontAdvance);
+}
+
+glm::ivec2 Editor::renderPos(glm::ivec2 pos, int32_t offsetX, int32_t fontAdvance) {
     glm::ivec2 xy;
-    xy.x = static_cast<float>(cursorPos_.x);
-    xy.y = static_cast<float>(cursorPos_.y - limit_.up_);
+    xy.x = static_cast<float>(column(pos));
+    xy.y = static_cast<float>(pos.y - limit_.up_);
+    if (folded()) {
+        // the row among the ones shown, a line off screen just past them
+        auto row = wrapped() ? wrapRow(pos.y, xy.x) : 0;
+        xy.x -= row * static_cast<int32_t>(wrap_.width());
+        auto rows = showRows();
+        auto it = std::find_if(rows.begin(), rows.end(), [&](const Row& shown) {
+            return shown.line_ == pos.y && shown.row_ == row;
+        });
+        xy.y = it != rows.end() ? static_cast<float>(it - rows.begin()) : pos.y < limit_.up_ ? -1.0f : static_cast<float>(rows.size());
+    } else if (wrapped()) {
+        // rows counted from the one the screen starts on
+        auto row = wrapRow(pos.y, xy.x);
+        xy.x -= row * static_cast<int32_t>(wrap_.width());
+        xy.y = static_cast<float>(static_cast<int64_t>(wrap_.rowOf(pos.y) + row) - static_cast<int64_t>(wrap_.rowOf(limit_.up_) + limit_.upRow_));
+    }
 
     xy.x += lineNumberOffset_;
     xy.x *= fontAdvance;
@@ -201,8 +1319,8 @@ glm::ivec2 Editor::posToScreenPos(glm::ivec2 pos) {
 }
 
 bool Editor::empty() {
-    for (size_t i = showLimit().up_; i < showLimit().bottom_; i++) {
-        if (!lines_[i].empty()) {
+    for (auto i = showLimit().up_; i < showLimit().bottom_; i++) {
+        if (lineSize(i) != 0) {
             return false;
         }
     }
@@ -212,33 +1330,159 @@ bool Editor::empty() {
 
 Editor::Limit Editor::showLimit() {
     auto up = std::max(limit_.up_, 0);
-    auto bottom = std::min(limit_.bottom_, static_cast<int32_t>(lines_.size()));
+    auto bottom = std::min(limit_.bottom_, static_cast<int32_t>(lineCount()));
 
     return {up, bottom};
 }
 
+// the match set is maintained across calls and edits, so searching as the
+// needle is typed or stepping through the matches never rescans everything
 glm::ivec2 Editor::searchStr(const std::string& str) {
-    auto& currLine = lines_[cursorPos_.y];
-    auto find = currLine.find(str);
-    if (find != std::string::npos) {
-        return {find, cursorPos_.y};
+    if (!searchPiecesValid_) {
+        if (paged_ || hex_) {
+            searchPieces_ = {paged_ ? paged_->view() : hex_->view()};
+        } else {
+            searchPieces_ = document_.pieces();
+        }
+        searchPiecesValid_ = true;
+    }
+    search_.update(searchPieces_, str);
+
+    if (search_.matches().empty()) {
+        return {-1, -1};
     }
 
-    for (size_t i = cursorPos_.y; i < lines_.size(); i++) {
-        find = lines_[i].find(str);
-        if (find != std::string::npos) {
-            return {find, i};
+    auto cursor = offset(cursorPos_);
+    auto it = std::lower_bound(search_.matches().begin(), search_.matches().end(), cursor);
+
+    return position(it == search_.matches().end() ? search_.matches().front() : *it);
+}
+
+glm::ivec2 Editor::searchNext() {
+    if (!search_.valid()) {
+        if (search_.needle().empty()) {
+            return {-1, -1};
         }
+        searchStr(std::string(search_.needle()));
     }
 
-    for (size_t i = 0; i < cursorPos_.y; i++) {
-        find = lines_[i].find(str);
-        if (find != std::string::npos) {
-            return {find, i};
+    auto next = search_.next(offset(cursorPos_));
+
+    return next == TextSearch::npos ? glm::ivec2{-1, -1} : position(next);
+}
+
+glm::ivec2 Editor::searchPrev() {
+    if (!search_.valid()) {
+        if (search_.needle().empty()) {
+            return {-1, -1};
         }
+        searchStr(std::string(search_.needle()));
     }
 
-    return {-1, -1};
+    auto prev = search_.prev(offset(cursorPos_));
+
+    return prev == TextSearch::npos ? glm::ivec2{-1, -1} : position(prev);
+}
+
+// replaces every match in the document as one undo step; returns how many,
+// or -1 when the pattern does not compile
+int64_t Editor::substitute(const std::string& pattern, const std::string& replacement) {
+    if (readOnly()) {
+        return 0;
+    }
+
+    Regex regex(pattern);
+    if (!regex.valid()) {
+        std::cout << std::format("bad pattern {}: {}\n", pattern, regex.error());
+        return -1;
+    }
+
+    auto spans = Substitute::run(document_, regex, replacement);
+
+    // back to front, so the offsets of the spans still to go stay put
+    int64_t count = 0;
+    journal_.begin();
+    for (auto it = spans.rbegin(); it != spans.rend(); ++it) {
+        eraseText(it->offset_, it->length_);
+        insertText(it->offset_, it->text_);
+        count += it->count_;
+    }
+    journal_.end();
+
+    adjustCursor();
+
+    return count;
+}
+
+// lines first..last, or first to the end when last is -1, go through op and
+// come back as one erase and one insert, a single undo step. Returns the
+// lines left in the range, or -1 when the pattern does not compile
+int64_t Editor::lineOp(LineOps::Op op, const std::string& pattern, int32_t first, int32_t last) {
+    if (readOnly()) {
+        return 0;
+    }
+
+    auto lines = static_cast<int32_t>(lineCount());
+    last = last < 0 ? lines - 1 : std::min(last, lines - 1);
+    if (first < 0 || first > last) {
+        return 0;
+    }
+
+    std::unique_ptr<Regex> regex;
+    if (op == LineOps::Grep || op == LineOps::VGrep) {
+        regex = std::make_unique<Regex>(pattern);
+        if (!regex->valid()) {
+            std::cout << std::format("bad pattern {}: {}\n", pattern, regex->error());
+            return -1;
+        }
+    }
+
+    auto begin = document_.lineStart(first);
+    auto end = last + 1 < lines ? document_.lineStart(last + 1) : document_.size();
+    auto text = document_.text(begin, end - begin);
+    auto result = LineOps::run(text, op, regex.get());
+    if (result != text) {
+        // the range was just read, so the journal takes it rather than eraseText()
+        journal_.begin();
+        journal_.recordErase(begin, text);
+        journal_.recordInsert(begin, result);
+        applyText(begin, end - begin, result);
+        journal_.end();
+    }
+
+    adjustCursor();
+
+    return TextScan::count(result.data(), result.size(), '\n') + (!result.empty() && result.back() != '\n');
+}
+
+// counted by the document as it changes, so these are exact after any edit
+Editor::Stats Editor::stats() const {
+    Stats stats;
+    stats.bytes_ = hex_ ? hex_->size() : paged_ ? paged_->size() : document_.size();
+    stats.chars_ = paged_ ? paged_->chars() : document_.chars();
+    stats.words_ = paged_ ? paged_->words() : document_.words();
+    stats.lines_ = lineCount();
+
+    return stats;
+}
+
+std::string Editor::status() const {
+    auto stats = this->stats();
+    auto cursor = offset(cursorPos_);
+    auto percent = stats.bytes_ == 0 ? 100 : cursor * 100 / stats.bytes_;
+    if (hex_) {
+        return std::format("0x{:x}/0x{:x}  {}%  {}B  hex", cursor, stats.bytes_, percent, stats.bytes_);
+    }
+    if (table_) {
+        return std::format("{}:{}/{}x{}  {}%  {}B  table", cursorPos_.y + 1, cursorPos_.x + 1, table_->rows(), table_->columns(), percent, stats.bytes_);
+    }
+
+    auto status = std::format("{}:{}/{}  {}%  {}B {}C {}W", cursorPos_.y + 1, column(cursorPos_) + 1, stats.lines_, percent, stats.bytes_, stats.chars_, stats.words_);
+    if (format_.encoding_ != Transcode::Utf8 || format_.bom_) {
+        status += std::format("  {}", Transcode::name(format_));
+    }
+
+    return status;
 }
 
 bool Editor::save() {
@@ -246,89 +1490,203 @@ bool Editor::save() {
         return false;
     }
 
-    save(fileName_);
-
-    return true;
+    return save(fileName_);
 }
 
-bool Editor::save(const std::string& fileName) {
-    std::ofstream file(fileName);
-    if (!file.is_open()) {
+// the open file is not written over a change another process made to it that
+// could not be merged, unless forced
+bool Editor::save(const std::string& fileName, bool force) {
+    if (readOnly()) {
         return false;
     }
 
-    for (size_t i = 0; i < lines_.size(); i++) {
-        file << lines_[i] << std::endl;
+    auto own = fileName == fileName_;
+    if (own && sync_ && saving_ == 0 && sync_->poll()) {
+        // a change made since the last frame is merged before it is written over
+        reload();
+    }
+    if (own && diverged_ && !force) {
+        std::cout << std::format("{} changed on disk under unsaved edits; save! writes over it, reload takes it\n", fileName);
+        return false;
+    }
+
+    if (!saver_) {
+        saver_ = std::make_shared<SaveEngine>();
+    }
+
+    // copying the table is the snapshot; the original buffer is shared, and it
+    // survives the rename even when it maps the file being replaced
+    // edits made while the save runs stay in the recovery journal, and in the
+    // hunks of sync_ against the saved file
+    auto mark = recovery_ ? recovery_->position() : 0;
+    if (own) {
+        saving_++;
+        diverged_ = false;
+        if (sync_) {
+            sync_->saving();
+        }
     }
-    file.close();
+    saver_->save(document_, fileName, format_, [this, mark](bool ok, const std::string& path) {
+        auto own = path == fileName_;
+        if (own && saving_ > 0) {
+            saving_--;
+        }
+        if (!ok) {
+            std::cout << std::format("failed to save file: {}\n", path);
+            if (own && sync_) {
+                sync_->mismatch(document_.size());
+            }
+        } else if (own && (recovery_ || sync_)) {
+            auto saved = std::make_shared<MappedFile>(path);
+            if (recovery_) {
+                recovery_->rebase(mark, RecoveryJournal::fingerprint(path, saved->view()));
+            }
+            if (sync_ && saving_ == 0) {
+                sync_->reset(format_.encoding_ == Transcode::Utf8 ? saved : nullptr);
+            }
+        }
+        if (onSaved_) {
+            onSaved_(ok, path);
+        }
+    });
 
     return true;
 }
 
+// called once per frame on the main thread; true when the document changed
+bool Editor::update() {
+    if (saver_) {
+        saver_->poll();
+    }
+
+    auto changed = tail_ && followTail();
+    if (sync_ && saving_ == 0 && sync_->poll()) {
+        changed = reload() || changed;
+    }
+    freezeCold();
+
+    return changed;
+}
+
+// the added text more than coldMargin_ bytes off the screen is compressed a
+// few chunks a frame, and thawed again when scrolling or an edit reaches it.
+// The views of a search are kept valid until the next edit
+void Editor::freezeCold() {
+    if (paged_ || hex_ || table_ || searchPiecesValid_) {
+        return ;
+    }
+
+    auto last = document_.lineCount() - 1;
+    auto up = document_.lineStart(std::min<size_t>(std::max(limit_.up_, 0), last));
+    auto bottom = document_.lineStart(std::min<size_t>(std::max(limit_.bottom_, 0), last));
+    if (document_.freeze(up - std::min(up, coldMargin_), bottom + coldMargin_, coldPack_) > 0) {
+        // the last version would keep the frozen chunks' plain bytes alive
+        publish();
+    }
+}
+
+// copying the table is O(1) and the copy shares all it can with it, so every
+// change is published; a reader keeps the version it loaded as long as it
+// holds it
+void Editor::publish() {
+    published_.store(std::make_shared<const PieceTable>(document_), std::memory_order_release);
+}
+
+// the document as of the last change, safe to read on any thread
+std::shared_ptr<const PieceTable> Editor::snapshot() const {
+    return published_.load(std::memory_order_acquire);
+}
+
 void Editor::setMode(Editor::Mode mode) {
     mode_ = mode;
 }
 
 void Editor::rmCopyLine() {
-    if (lines_.size() <= 1) {
-        lines_[0].clear();
+    if (readOnly()) {
+        return ;
+    }
+
+    journal_.begin();
+    if (lineCount() <= 1) {
+        eraseText(0, document_.size());
+        journal_.end();
         adjustCursor();
         return ;
     }
 
-    copyLine_ = lines_[cursorPos_.y];
+    copyLine_ = line(cursorPos_.y);
 
-    lines_.erase(lines_.begin() + cursorPos_.y);
+    auto begin = document_.lineStart(cursorPos_.y);
+    if (cursorPos_.y + 1 < static_cast<int64_t>(lineCount())) {
+        eraseText(begin, lineSize(cursorPos_.y) + 1);
+    } else {
+        eraseText(begin - 1, lineSize(cursorPos_.y) + 1);
+    }
+    journal_.end();
     adjustCursor();
 }
 
 void Editor::adjustCursor() {
-    if (cursorPos_.y >= lines_.size()) {
-        cursorPos_.y = lines_.size() - 1;
-    }
-
-    if (cursorPos_.x >= lines_[cursorPos_.y].size()) {
-        cursorPos_.x = lines_[cursorPos_.y].size();
-    }
+    cursorPos_.y = std::clamp(cursorPos_.y, 0, std::max(static_cast<int32_t>(lineCount()) - 1, 0));
+    cursorPos_.x = std::clamp(cursorPos_.x, 0, static_cast<int32_t>(lineSize(cursorPos_.y)));
 
     moveLimit();
 }
 
 void Editor::copyLine() {
-    copyLine_ = lines_[cursorPos_.y];
+    copyLine_ = line(cursorPos_.y);
 }
 
 void Editor::paste() {
-    if (copyLine_.empty()) {
+    if (readOnly() || copyLine_.empty()) {
+        return ;
+    }
+
+    if (multiCursor()) {
+        editCursors(0, copyLine_);
         return ;
     }
 
-    insertStr(copyLine_);
+    insertRange(offset(cursorPos_), copyLine_);
 }
 
-void Editor::rmSpace() {
-    while (cursorPos_.x > 0) {
-        if (lines_[cursorPos_.y][cursorPos_.x - 1] != ' ') {
-            break;
-        }
+// length of the run right before the cursor on its line whose bytes are all
+// spaces (space) or all not spaces
+size_t Editor::runBefore(bool space) const {
+    auto text = line(cursorPos_.y);
+    size_t end = std::min<size_t>(cursorPos_.x + lineNumberOffset_, text.size());
+    auto begin = end;
+    while (begin > static_cast<size_t>(lineNumberOffset_) && (text[begin - 1] == ' ') == space) {
+        begin--;
+    }
+
+    return end - begin;
+}
 
-        backspace();
+size_t Editor::runAfter(bool space) const {
+    auto text = line(cursorPos_.y);
+    size_t begin = std::min<size_t>(cursorPos_.x + lineNumberOffset_, text.size());
+    auto end = begin;
+    while (end < text.size() && (text[end] == ' ') == space) {
+        end++;
     }
+
+    return end - begin;
 }
 
-void Editor::rmWord() {
-    while (cursorPos_.x > 0) {
-        if (lines_[cursorPos_.y][cursorPos_.x - 1] == ' ') {
-            break;
-        }
+void Editor::rmSpace() {
+    auto length = runBefore(true);
+    eraseRange(offset(cursorPos_) - length, length);
+}
 
-        backspace();
-    }
+void Editor::rmWord() {
+    auto length = runBefore(false);
+    eraseRange(offset(cursorPos_) - length, length);
 }
 
 void Editor::rmSpaceOrWord() {
     if (cursorPos_.x > 0) {
-        if (lines_[cursorPos_.y][cursorPos_.x - 1] == ' ') {
+        if (charAt(cursorPos_.y, cursorPos_.x - 1) == ' ') {
             rmSpace();
         } else {
             rmWord();
@@ -337,8 +1695,8 @@ void Editor::rmSpaceOrWord() {
 }
 
 void Editor::moveRight() {
-    if (cursorPos_.x < lines_[cursorPos_.y].size()) {
-        if (lines_[cursorPos_.y][cursorPos_.x] == ' ') {
+    if (cursorPos_.x < static_cast<int64_t>(lineSize(cursorPos_.y))) {
+        if (charAt(cursorPos_.y, cursorPos_.x) == ' ') {
             moveRightSpace();
         } else {
             moveRightWord();
@@ -347,28 +1705,18 @@ void Editor::moveRight() {
 }
 
 void Editor::moveRightSpace() {
-    while (cursorPos_.x < lines_[cursorPos_.y].size()) {
-        if (lines_[cursorPos_.y][cursorPos_.x] != ' ') {
-            break;
-        }
-
-        moveCursor(Right);
-    }
+    cursorPos_.x += runAfter(true);
+    moveLimit();
 }
 
 void Editor::moveRightWord() {
-    while (cursorPos_.x < lines_[cursorPos_.y].size()) {
-        if (lines_[cursorPos_.y][cursorPos_.x] == ' ') {
-            break;
-        }
-
-        moveCursor(Right);
-    }
+    cursorPos_.x += runAfter(false);
+    moveLimit();
 }
 
 void Editor::moveLeft() {
     if (cursorPos_.x > 0) {
-        if (lines_[cursorPos_.y][cursorPos_.x - 1] == ' ') {
+        if (charAt(cursorPos_.y, cursorPos_.x - 1) == ' ') {
             moveLeftSpace();
         } else {
             moveLeftWord();
@@ -377,27 +1725,23 @@ void Editor::moveLeft() {
 }
 
 void Editor::moveLeftSpace() {
-    while (cursorPos_.x > 0) {
-        if (lines_[cursorPos_.y][cursorPos_.x - 1] != ' ') {
-            break;
-        }
-
-        moveCursor(Left);
-    }
+    cursorPos_.x -= runBefore(true);
+    moveLimit();
 }
 
 void Editor::moveLeftWord() {
-    while (cursorPos_.x > 0) {
-        if (lines_[cursorPos_.y][cursorPos_.x - 1] == ' ') {
-            break;
-        }
-
-        moveCursor(Left);
-    }
+    cursorPos_.x -= runBefore(false);
+    moveLimit();
 }
 
 void Editor::newLine() {
-    lines_.insert(lines_.begin() + cursorPos_.y + 1, std::string());
+    if (readOnly()) {
+        return ;
+    }
+
+    journal_.begin();
+    insertText(document_.lineStart(cursorPos_.y) + lineSize(cursorPos_.y), "\n");
+    journal_.end();
 
     cursorPos_.y++;
     adjustCursor();
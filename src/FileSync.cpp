@@ -0,0 +1,370 @@
+#include "FileSync.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <sys/stat.h>
+
+namespace {
+
+constexpr uint64_t prime1 = 11400714785074694791ull;
+constexpr uint64_t prime2 = 14029467366897019727ull;
+constexpr uint64_t prime3 = 1609587929392839161ull;
+
+uint64_t load64(const char* data) {
+    uint64_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+uint64_t rotl(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// the high and low halves of the product folded together
+uint64_t mix(uint64_t a, uint64_t b) {
+    auto product = static_cast<unsigned __int128>(a) * b;
+    return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+}
+
+}
+
+FileSync::FileSync(const std::string& path, std::shared_ptr<MappedFile> file, size_t skip, size_t threads) : path_(path), skip_(skip), threads_(threads) {
+    reset(std::move(file));
+}
+
+FileSync::~FileSync() {
+    wait();
+}
+
+// a watcher follows the file it was made on, so one is made again for
+// whatever a rename or a delete leaves at the path
+void FileSync::watch() {
+    watcher_ = std::make_unique<FileWatcher>(path_);
+    if (!watcher_->valid()) {
+        watcher_.reset();
+    }
+}
+
+void FileSync::wait() {
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+bool FileSync::identify(Identity& identity) const {
+    struct stat st;
+    if (stat(path_.c_str(), &st) != 0) {
+        return false;
+    }
+    std::error_code error;
+    auto time = std::filesystem::last_write_time(path_, error);
+
+    identity.device_ = static_cast<uint64_t>(st.st_dev);
+    identity.inode_ = static_cast<uint64_t>(st.st_ino);
+    identity.size_ = static_cast<uint64_t>(st.st_size);
+    identity.mtime_ = error ? 0 : time.time_since_epoch().count();
+    return true;
+}
+
+// a file with nothing to be told from is hashed on the worker so opening it
+// does not wait on reading it all
+void FileSync::reset(std::shared_ptr<MappedFile> file) {
+    wait();
+    watch();
+    file_ = std::move(file);
+    chunks_.clear();
+    identity_ = {};
+    identify(identity_);
+    if (file_ != nullptr) {
+        worker_ = std::thread([this]() {
+            chunks_ = hashChunks(file_->view(), 0, file_->size());
+        });
+    }
+}
+
+// a file renamed over is deleted once nothing holds it, which for a large
+// one is long enough to be left to the worker
+void FileSync::replace(std::shared_ptr<MappedFile> file) {
+    worker_ = std::thread([old = std::move(file_)]() {
+    });
+    file_ = std::move(file);
+}
+
+bool FileSync::poll() {
+    if (watcher_ == nullptr) {
+        // nothing was at the path; something is once it can be watched
+        watch();
+        return watcher_ != nullptr;
+    }
+
+    return watcher_->poll() != FileWatcher::None;
+}
+
+FileSync::Status FileSync::compare(Change& change) {
+    watch();
+    wait();
+
+    Identity now;
+    if (!identify(now)) {
+        return Missing;
+    }
+    if (now == identity_) {
+        // only touched, or an event for a change already taken in
+        return Unchanged;
+    }
+    if (file_ == nullptr) {
+        return Rewritten;
+    }
+    auto file = std::make_shared<MappedFile>(path_);
+    if (!file->valid()) {
+        return Missing;
+    }
+
+    auto before = file_->view();
+    auto after = file->view();
+    // the unchanged chunks at the start are where they were, those at the end
+    // moved by the difference in size
+    auto delta = after.size() - before.size();
+    auto inPlace = now.device_ == identity_.device_ && now.inode_ == identity_.inode_;
+    if (inPlace && after.size() < before.size()) {
+        return Truncated;
+    }
+    auto prefix = run(after, 0, chunks_.size(), false, 0, 0);
+    auto begin = prefix > 0 ? chunks_[prefix - 1].offset_ + chunks_[prefix - 1].size_ : 0;
+
+    if (inPlace) {
+        // written in place: the mapping of file_ already shows the new bytes,
+        // so what was there can only be kept when it was appended to
+        if (prefix < chunks_.size()) {
+            return Rewritten;
+        }
+        auto appended = hashChunks(after, before.size(), after.size());
+        chunks_.insert(chunks_.end(), appended.begin(), appended.end());
+        replace(std::move(file));
+        identity_ = now;
+        if (after.size() == before.size()) {
+            return Unchanged;
+        }
+        change = {before.size() - skip_, before.size() - skip_, after.substr(before.size())};
+        return Changed;
+    }
+
+    auto suffix = run(after, prefix, chunks_.size(), true, delta, begin);
+    auto end = suffix > 0 ? chunks_[chunks_.size() - suffix].offset_ : before.size();
+
+    // the chunks that differ narrowed down to the bytes that do
+    auto changeBegin = begin, changeEnd = end, newEnd = end + delta;
+    while (changeBegin < changeEnd && changeBegin < newEnd && before[changeBegin] == after[changeBegin]) {
+        changeBegin++;
+    }
+    while (changeEnd > changeBegin && newEnd > changeBegin && before[changeEnd - 1] == after[newEnd - 1]) {
+        changeEnd--;
+        newEnd--;
+    }
+    if (changeBegin < skip_ && (changeBegin < changeEnd || changeBegin < newEnd)) {
+        return Rewritten;
+    }
+
+    std::vector<Chunk> chunks(chunks_.begin(), chunks_.begin() + prefix);
+    auto middle = hashChunks(after, begin, end + delta);
+    chunks.insert(chunks.end(), middle.begin(), middle.end());
+    for (auto i = chunks_.size() - suffix; i < chunks_.size(); i++) {
+        chunks.push_back(chunks_[i]);
+        chunks.back().offset_ += delta;
+    }
+    chunks_ = std::move(chunks);
+    replace(std::move(file));
+    identity_ = now;
+
+    if (changeBegin == changeEnd && changeBegin == newEnd) {
+        return Unchanged;
+    }
+    change = {changeBegin - skip_, changeEnd - skip_, after.substr(changeBegin, newEnd - changeBegin)};
+    return Changed;
+}
+
+// how many chunks in a row, from the first or from the last of chunks_[begin,
+// end), data holds delta bytes further on and not before floor. Hashed a batch
+// at a time on every thread, the batches growing, so a change near either end
+// costs little more than the bytes up to it. A batch is read front to back
+// either way, which is the order read-ahead fetches a file not in memory in
+size_t FileSync::run(std::string_view data, size_t begin, size_t end, bool backward, size_t delta, size_t floor) const {
+    auto batch = Parallel::threads(threads_) * 4;
+    size_t found = 0;
+    while (found < end - begin) {
+        auto count = std::min(batch, end - begin - found);
+        auto first = backward ? end - found - count : begin + found;
+        std::vector<uint8_t> same(count);
+        Parallel::forEach(count, threads_, [&](size_t i) {
+            auto& chunk = chunks_[first + i];
+            auto at = chunk.offset_ + delta;
+            same[i] = at >= floor && at <= data.size() && chunk.size_ <= data.size() - at && hash(data.data() + at, chunk.size_) == chunk.hash_;
+        });
+        for (size_t i = 0; i < count; i++) {
+            if (!same[backward ? count - 1 - i : i]) {
+                return found + i;
+            }
+        }
+        found += count;
+        batch = std::min(batch * 2, maxBatch_);
+    }
+
+    return found;
+}
+
+std::vector<FileSync::Chunk> FileSync::hashChunks(std::string_view data, size_t begin, size_t end) const {
+    std::vector<Chunk> chunks((end - begin + chunkSize_ - 1) / chunkSize_);
+    Parallel::forEach(chunks.size(), threads_, [&](size_t i) {
+        auto& chunk = chunks[i];
+        chunk.offset_ = begin + i * chunkSize_;
+        chunk.size_ = std::min(chunkSize_, end - chunk.offset_);
+        chunk.hash_ = hash(data.data() + chunk.offset_, chunk.size_);
+    });
+
+    return chunks;
+}
+
+// every 16 bytes folded into a 128 bit product with a key that depends on
+// their position, and the products summed: the multiplies do not wait on
+// each other, so hashing keeps up with reading
+uint64_t FileSync::hash(const char* data, size_t size) {
+    uint64_t sums[2] = {prime1, prime2};
+    uint64_t key = prime3;
+    size_t i = 0;
+    for ( ; i + 32 <= size; i += 32, key += prime3) {
+        sums[0] += mix(load64(data + i) ^ key, load64(data + i + 8) ^ (key + prime1));
+        sums[1] += mix(load64(data + i + 16) ^ (key + prime2), load64(data + i + 24) ^ rotl(key, 29));
+    }
+    for ( ; i + 8 <= size; i += 8, key += prime3) {
+        sums[0] += mix(load64(data + i) ^ key, prime1);
+    }
+    uint64_t last = 0;
+    std::memcpy(&last, data + i, size - i);
+
+    return mix(sums[0] ^ mix(last ^ key, prime2), sums[1] ^ size);
+}
+
+// doc offset - base offset past hunks_[index - 1], wrapping when negative
+size_t FileSync::shift(size_t index) const {
+    return index == 0 ? 0 : hunks_[index - 1].docEnd_ - hunks_[index - 1].baseEnd_;
+}
+
+// the hunks the edit overlaps or touches become one with it
+void FileSync::edited(size_t offset, size_t erase, size_t insert) {
+    if (erase == 0 && insert == 0) {
+        return ;
+    }
+
+    auto end = offset + erase;
+    auto lo = static_cast<size_t>(std::lower_bound(hunks_.begin(), hunks_.end(), offset, [](const Hunk& hunk, size_t offset) {
+        return hunk.docEnd_ < offset;
+    }) - hunks_.begin());
+    auto hi = lo;
+    while (hi < hunks_.size() && hunks_[hi].docBegin_ <= end) {
+        hi++;
+    }
+
+    Hunk hunk;
+    if (lo < hi && hunks_[lo].docBegin_ <= offset) {
+        hunk.docBegin_ = hunks_[lo].docBegin_;
+        hunk.baseBegin_ = hunks_[lo].baseBegin_;
+    } else {
+        hunk.docBegin_ = offset;
+        hunk.baseBegin_ = offset - shift(lo);
+    }
+    if (lo < hi && hunks_[hi - 1].docEnd_ >= end) {
+        hunk.docEnd_ = hunks_[hi - 1].docEnd_;
+        hunk.baseEnd_ = hunks_[hi - 1].baseEnd_;
+    } else {
+        hunk.docEnd_ = end;
+        hunk.baseEnd_ = end - shift(hi);
+    }
+    hunk.docEnd_ = hunk.docEnd_ - erase + insert;
+
+    hunks_.erase(hunks_.begin() + lo, hunks_.begin() + hi);
+    hunks_.insert(hunks_.begin() + lo, hunk);
+    for (auto i = lo + 1; i < hunks_.size(); i++) {
+        hunks_[i].docBegin_ += insert - erase;
+        hunks_[i].docEnd_ += insert - erase;
+    }
+}
+
+// a change meets a hunk it overlaps; one that only touches it meets it too
+// when either of them inserts, as then which goes first is unknown
+bool FileSync::merge(const Change& change, size_t& docBegin, size_t& docEnd) {
+    auto begin = change.begin_, end = change.end_;
+    auto delta = change.text_.size() - (end - begin);
+    auto meets = [&](const Hunk& hunk) {
+        if (hunk.baseBegin_ < end && begin < hunk.baseEnd_) {
+            return true;
+        }
+        return (begin == end || hunk.baseBegin_ == hunk.baseEnd_) && hunk.baseBegin_ <= end && begin <= hunk.baseEnd_;
+    };
+
+    auto lo = static_cast<size_t>(std::lower_bound(hunks_.begin(), hunks_.end(), begin, [](const Hunk& hunk, size_t offset) {
+        return hunk.baseEnd_ < offset;
+    }) - hunks_.begin());
+    if (lo < hunks_.size() && !meets(hunks_[lo])) {
+        lo += hunks_[lo].baseEnd_ <= begin;
+    }
+    auto hi = lo;
+    while (hi < hunks_.size() && meets(hunks_[hi])) {
+        hi++;
+    }
+
+    if (lo == hi) {
+        docBegin = begin + shift(lo);
+        docEnd = end + shift(lo);
+        for (auto i = lo; i < hunks_.size(); i++) {
+            hunks_[i].baseBegin_ += delta;
+            hunks_[i].baseEnd_ += delta;
+            hunks_[i].docBegin_ += delta;
+            hunks_[i].docEnd_ += delta;
+        }
+        return true;
+    }
+
+    // the document keeps its text; it differs from the file over the hunks
+    // and the change together
+    Hunk hunk;
+    auto& first = hunks_[lo];
+    auto& last = hunks_[hi - 1];
+    hunk.baseBegin_ = std::min(begin, first.baseBegin_);
+    hunk.docBegin_ = begin < first.baseBegin_ ? begin + shift(lo) : first.docBegin_;
+    hunk.baseEnd_ = std::max(end, last.baseEnd_) + delta;
+    hunk.docEnd_ = end > last.baseEnd_ ? end + shift(hi) : last.docEnd_;
+    docBegin = hunk.docBegin_;
+    docEnd = hunk.docEnd_;
+
+    hunks_.erase(hunks_.begin() + lo, hunks_.begin() + hi);
+    hunks_.insert(hunks_.begin() + lo, hunk);
+    for (auto i = lo + 1; i < hunks_.size(); i++) {
+        hunks_[i].baseBegin_ += delta;
+        hunks_[i].baseEnd_ += delta;
+    }
+    return false;
+}
+
+void FileSync::saving() {
+    hunks_.clear();
+}
+
+void FileSync::mismatch(size_t documentSize) {
+    wait();
+    auto size = file_ != nullptr ? file_->size() : 0;
+    hunks_ = {{0, size - std::min(size, skip_), 0, documentSize}};
+}
+
+bool FileSync::clean() const {
+    return hunks_.empty();
+}
+
+const std::vector<FileSync::Hunk>& FileSync::hunks() const {
+    return hunks_;
+}
+
+const std::shared_ptr<MappedFile>& FileSync::file() const {
+    return file_;
+}
\ No newline at end of file
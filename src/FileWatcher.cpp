@@ -0,0 +1,110 @@
+#include "FileWatcher.h"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#else
+#include <filesystem>
+#endif
+
+#ifdef __linux__
+
+FileWatcher::FileWatcher(const std::string& path) : path_(path) {
+    fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd_ >= 0) {
+        watch_ = inotify_add_watch(fd_, path.c_str(), IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVE_SELF | IN_DELETE_SELF);
+    }
+}
+
+FileWatcher::~FileWatcher() {
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+bool FileWatcher::valid() const {
+    return watch_ >= 0;
+}
+
+// drains the queue, so a burst of writes between two frames is one event
+uint8_t FileWatcher::poll() {
+    uint8_t events = None;
+    if (watch_ < 0) {
+        return events;
+    }
+
+    alignas(inotify_event) char buffer[4096];
+    while (true) {
+        auto n = read(fd_, buffer, sizeof(buffer));
+        if (n <= 0) {
+            break;
+        }
+        for (ssize_t i = 0; i < n; ) {
+            auto event = reinterpret_cast<const inotify_event*>(buffer + i);
+            if (event->mask & (IN_MOVE_SELF | IN_DELETE_SELF | IN_IGNORED)) {
+                events |= Replaced;
+            } else {
+                events |= Modified;
+            }
+            i += sizeof(inotify_event) + event->len;
+        }
+    }
+
+    return events;
+}
+
+#else
+
+namespace {
+
+bool look(const std::string& path, uint64_t& size, int64_t& mtime) {
+    std::error_code error;
+    auto bytes = std::filesystem::file_size(path, error);
+    if (error) {
+        return false;
+    }
+    auto time = std::filesystem::last_write_time(path, error);
+    if (error) {
+        return false;
+    }
+
+    size = bytes;
+    mtime = time.time_since_epoch().count();
+    return true;
+}
+
+}
+
+FileWatcher::FileWatcher(const std::string& path) : path_(path) {
+    exists_ = look(path, size_, mtime_);
+}
+
+FileWatcher::~FileWatcher() {
+
+}
+
+bool FileWatcher::valid() const {
+    return exists_;
+}
+
+uint8_t FileWatcher::poll() {
+    uint64_t size;
+    int64_t mtime;
+    if (!look(path_, size, mtime)) {
+        auto existed = exists_;
+        exists_ = false;
+        return existed ? Replaced : None;
+    }
+
+    uint8_t events = exists_ ? None : Replaced;
+    if (size != size_ || mtime != mtime_) {
+        events |= Modified;
+    }
+    exists_ = true;
+    size_ = size;
+    mtime_ = mtime;
+
+    return events;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,512 @@
+#include "FoldIndex.h"
+
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+#include <utility>
+
+namespace {
+
+// outer folds before the inner ones starting on the same line
+bool before(const FoldIndex::Fold& a, const FoldIndex::Fold& b) {
+    return a.first_ < b.first_ || (a.first_ == b.first_ && a.last_ > b.last_);
+}
+
+size_t shifted(size_t value, int64_t shift) {
+    return value == 0 ? 0 : static_cast<size_t>(static_cast<int64_t>(value) + shift);
+}
+
+}
+
+void FoldIndex::add(size_t first, size_t last, bool closed, bool manual) {
+    if (last <= first) {
+        return ;
+    }
+
+    place({first, last, closed, manual}, true);
+}
+
+bool FoldIndex::toggle(size_t line) {
+    return openAt(root_.get(), line) || closeAround(root_.get(), line);
+}
+
+void FoldIndex::reveal(size_t line) {
+    reveal(root_.get(), line);
+}
+
+void FoldIndex::openAll() {
+    auto folds = this->folds();
+    for (auto& fold : folds) {
+        fold.closed_ = false;
+    }
+    build(folds);
+}
+
+void FoldIndex::clear() {
+    root_.reset();
+    derived_ = false;
+}
+
+// a fold derived before and found again keeps whether it was closed
+void FoldIndex::derive(const std::vector<std::string_view>& pieces, int32_t tabWidth) {
+    auto folds = braces(pieces);
+    if (folds.empty()) {
+        folds = indents(pieces, tabWidth);
+    }
+
+    std::vector<Fold> kept;
+    for (auto& fold : this->folds()) {
+        if (fold.manual_ || fold.closed_) {
+            kept.push_back(fold);
+        }
+    }
+    std::vector<Fold> merged;
+    merged.reserve(folds.size() + kept.size());
+    std::merge(folds.begin(), folds.end(), kept.begin(), kept.end(), std::back_inserter(merged), before);
+    std::vector<Fold> unique;
+    unique.reserve(merged.size());
+    for (auto& fold : merged) {
+        if (!unique.empty() && unique.back().first_ == fold.first_ && unique.back().last_ == fold.last_) {
+            unique.back().closed_ = unique.back().closed_ || fold.closed_;
+            unique.back().manual_ = unique.back().manual_ || fold.manual_;
+            continue;
+        }
+        if (fold.manual_ || std::binary_search(folds.begin(), folds.end(), fold, before)) {
+            unique.push_back(fold);
+        }
+    }
+    build(unique);
+    derived_ = true;
+}
+
+bool FoldIndex::derived() const {
+    return derived_;
+}
+
+// the folds starting after lo move by the shift as a whole; those starting
+// or ending in the rewritten lines are taken out and placed again, merged
+// with one they now match, and dropped when left with no line to hide
+void FoldIndex::edited(size_t first, size_t lo, size_t ln) {
+    if (!root_ || lo == ln) {
+        return ;
+    }
+
+    Tree left, rest, middle, right;
+    split(std::move(root_), first + 1, SIZE_MAX, left, rest);
+    split(std::move(rest), lo + 1, SIZE_MAX, middle, right);
+    if (right) {
+        apply(*right, static_cast<int64_t>(ln) - static_cast<int64_t>(lo));
+    }
+
+    std::vector<Fold> moved;
+    collect(middle.get(), 0, moved);
+    middle.reset();
+    root_ = merge(cut(std::move(left), first, lo, ln, moved), std::move(right));
+    for (auto fold : moved) {
+        fold.first_ = std::min(fold.first_, ln);
+        fold.last_ = fold.last_ > lo ? fold.last_ + ln - lo : std::min(fold.last_, ln);
+        place(fold);
+    }
+}
+
+bool FoldIndex::empty() const {
+    return root_ == nullptr;
+}
+
+bool FoldIndex::closed() const {
+    return root_ && root_->maxClosedLast_ != 0;
+}
+
+bool FoldIndex::hidden(size_t line) const {
+    auto to = hiddenTo(line);
+
+    return to != 0 && to >= line;
+}
+
+size_t FoldIndex::next(size_t line) const {
+    for (auto to = hiddenTo(line); to != 0 && to >= line; to = hiddenTo(line)) {
+        line = to + 1;
+    }
+
+    return line;
+}
+
+size_t FoldIndex::shown(size_t line) const {
+    while (hidden(line)) {
+        line = header(root_.get(), 0, line);
+    }
+
+    return line;
+}
+
+std::vector<FoldIndex::Fold> FoldIndex::folds() const {
+    std::vector<Fold> result;
+    collect(root_.get(), 0, result);
+
+    return result;
+}
+
+std::vector<FoldIndex::Fold> FoldIndex::braces(const std::vector<std::string_view>& pieces) {
+    enum State : uint8_t {
+        Code,
+        LineComment,
+        BlockComment,
+        Literal,
+    };
+
+    std::vector<Fold> folds;
+    std::vector<size_t> open;
+    auto state = Code;
+    char quote = 0, previous = 0;
+    bool escaped = false;
+    size_t line = 0;
+    for (auto piece : pieces) {
+        for (auto c : piece) {
+            switch (state) {
+            case Code:
+                if (previous == '/' && (c == '/' || c == '*')) {
+                    state = c == '/' ? LineComment : BlockComment;
+                    c = 0;
+                } else if (c == '"' || (c == '\'' && !std::isalnum(static_cast<unsigned char>(previous)))) {
+                    // a quote after a digit separates digits
+                    state = Literal;
+                    quote = c;
+                } else if (c == '{') {
+                    open.push_back(line);
+                } else if (c == '}' && !open.empty()) {
+                    // the line of the closing brace stays shown
+                    if (line > open.back() + 1) {
+                        folds.push_back({open.back(), line - 1});
+                    }
+                    open.pop_back();
+                }
+                break;
+            case LineComment:
+                if (c == '\n') {
+                    state = Code;
+                }
+                break;
+            case BlockComment:
+                if (previous == '*' && c == '/') {
+                    state = Code;
+                    c = 0;
+                }
+                break;
+            case Literal:
+                if (escaped) {
+                    escaped = false;
+                } else if (c == '\\') {
+                    escaped = true;
+                } else if (c == quote || c == '\n') {
+                    state = Code;
+                }
+                break;
+            }
+            line += c == '\n';
+            previous = c;
+        }
+    }
+    std::sort(folds.begin(), folds.end(), before);
+
+    return folds;
+}
+
+std::vector<FoldIndex::Fold> FoldIndex::indents(const std::vector<std::string_view>& pieces, int32_t tabWidth) {
+    std::vector<Fold> folds;
+    // lines still taking in deeper ones, by indentation
+    std::vector<std::pair<size_t, size_t>> open;
+    size_t line = 0, indent = 0, lastShown = 0;
+    bool leading = true;
+    auto close = [&](size_t depth) {
+        while (!open.empty() && open.back().first >= depth) {
+            if (lastShown > open.back().second) {
+                folds.push_back({open.back().second, lastShown});
+            }
+            open.pop_back();
+        }
+    };
+
+    for (auto piece : pieces) {
+        for (auto c : piece) {
+            if (c == '\n') {
+                line++;
+                indent = 0;
+                leading = true;
+            } else if (leading && (c == ' ' || c == '\t')) {
+                indent += c == '\t' ? tabWidth - indent % tabWidth : 1;
+            } else if (leading && c != '\r') {
+                // the first thing on a line that is not blank
+                leading = false;
+                close(indent);
+                open.push_back({indent, line});
+                lastShown = line;
+            }
+        }
+    }
+    close(0);
+    std::sort(folds.begin(), folds.end(), before);
+
+    return folds;
+}
+
+FoldIndex::Tree FoldIndex::newNode(const Fold& fold) {
+    auto node = std::make_unique<Node>();
+    node->fold_ = fold;
+
+    seed_ ^= seed_ << 13;
+    seed_ ^= seed_ >> 17;
+    seed_ ^= seed_ << 5;
+    node->priority_ = seed_;
+    update(*node);
+
+    return node;
+}
+
+void FoldIndex::apply(Node& node, int64_t shift) {
+    node.fold_.first_ = shifted(node.fold_.first_, shift);
+    node.fold_.last_ = shifted(node.fold_.last_, shift);
+    node.maxLast_ = shifted(node.maxLast_, shift);
+    node.maxClosedLast_ = shifted(node.maxClosedLast_, shift);
+    node.shift_ += shift;
+}
+
+void FoldIndex::push(Node& node) {
+    if (node.shift_ == 0) {
+        return ;
+    }
+
+    if (node.left_) {
+        apply(*node.left_, node.shift_);
+    }
+    if (node.right_) {
+        apply(*node.right_, node.shift_);
+    }
+    node.shift_ = 0;
+}
+
+// the children carry no shift of node's
+void FoldIndex::update(Node& node) {
+    node.maxLast_ = node.fold_.last_;
+    node.maxClosedLast_ = node.fold_.closed_ ? node.fold_.last_ : 0;
+    for (auto* child : {node.left_.get(), node.right_.get()}) {
+        if (child) {
+            node.maxLast_ = std::max(node.maxLast_, child->maxLast_);
+            node.maxClosedLast_ = std::max(node.maxClosedLast_, child->maxClosedLast_);
+        }
+    }
+}
+
+FoldIndex::Tree FoldIndex::merge(Tree a, Tree b) {
+    if (!a) {
+        return b;
+    }
+    if (!b) {
+        return a;
+    }
+
+    if (a->priority_ > b->priority_) {
+        push(*a);
+        a->right_ = merge(std::move(a->right_), std::move(b));
+        update(*a);
+        return a;
+    }
+
+    push(*b);
+    b->left_ = merge(std::move(a), std::move(b->left_));
+    update(*b);
+    return b;
+}
+
+void FoldIndex::split(Tree t, size_t first, size_t last, Tree& l, Tree& r) {
+    if (!t) {
+        l = nullptr;
+        r = nullptr;
+        return ;
+    }
+
+    push(*t);
+    if (before(t->fold_, {first, last})) {
+        Tree right;
+        split(std::move(t->right_), first, last, right, r);
+        t->right_ = std::move(right);
+        update(*t);
+        l = std::move(t);
+    } else {
+        Tree left;
+        split(std::move(t->left_), first, last, l, left);
+        t->left_ = std::move(left);
+        update(*t);
+        r = std::move(t);
+    }
+}
+
+// a subtree is only entered when a closed fold in it ends after line; one
+// with every fold starting after line is only passed through to the left
+bool FoldIndex::openAt(Node* t, size_t line) {
+    if (!t || t->maxClosedLast_ <= line) {
+        return false;
+    }
+
+    push(*t);
+    auto opened = false;
+    if (t->fold_.first_ >= line) {
+        opened = openAt(t->left_.get(), line);
+    }
+    if (t->fold_.first_ == line && t->fold_.closed_) {
+        t->fold_.closed_ = false;
+        opened = true;
+    }
+    if (t->fold_.first_ <= line) {
+        opened = openAt(t->right_.get(), line) || opened;
+    }
+    if (opened) {
+        update(*t);
+    }
+
+    return opened;
+}
+
+// the innermost fold is the last in order starting at or before line
+bool FoldIndex::closeAround(Node* t, size_t line) {
+    if (!t || t->maxLast_ < line) {
+        return false;
+    }
+
+    push(*t);
+    auto closed = t->fold_.first_ <= line && closeAround(t->right_.get(), line);
+    if (!closed && t->fold_.first_ <= line && t->fold_.last_ >= line) {
+        t->fold_.closed_ = true;
+        closed = true;
+    }
+    if (!closed) {
+        closed = closeAround(t->left_.get(), line);
+    }
+    if (closed) {
+        update(*t);
+    }
+
+    return closed;
+}
+
+void FoldIndex::reveal(Node* t, size_t line) {
+    if (!t || t->maxClosedLast_ < line) {
+        return ;
+    }
+
+    push(*t);
+    reveal(t->left_.get(), line);
+    if (t->fold_.first_ < line) {
+        if (t->fold_.closed_ && t->fold_.last_ >= line) {
+            t->fold_.closed_ = false;
+        }
+        reveal(t->right_.get(), line);
+    }
+    update(*t);
+}
+
+// the folds starting at or before first that reach past it, which are the
+// ones around the edit: those ending after lo move with the shift, the ones
+// ending in the rewritten lines are taken out into moved
+FoldIndex::Tree FoldIndex::cut(Tree t, size_t first, size_t lo, size_t ln, std::vector<Fold>& moved) {
+    if (!t || t->maxLast_ <= first) {
+        return t;
+    }
+
+    push(*t);
+    t->left_ = cut(std::move(t->left_), first, lo, ln, moved);
+    t->right_ = cut(std::move(t->right_), first, lo, ln, moved);
+    if (t->fold_.last_ > lo) {
+        t->fold_.last_ += ln - lo;
+    } else if (t->fold_.last_ > first) {
+        moved.push_back(t->fold_);
+        return merge(std::move(t->left_), std::move(t->right_));
+    }
+    update(*t);
+
+    return t;
+}
+
+// a fold already there takes the new one's state when set, or else is closed
+// or manual when either was
+void FoldIndex::place(const Fold& fold, bool set) {
+    if (fold.last_ <= fold.first_) {
+        return ;
+    }
+
+    Tree left, rest, same, right;
+    split(std::move(root_), fold.first_, fold.last_, left, rest);
+    split(std::move(rest), fold.first_, fold.last_ - 1, same, right);
+    if (same) {
+        same->fold_.closed_ = set ? fold.closed_ : same->fold_.closed_ || fold.closed_;
+        same->fold_.manual_ = same->fold_.manual_ || fold.manual_;
+        update(*same);
+    } else {
+        same = newNode(fold);
+    }
+    root_ = merge(merge(std::move(left), std::move(same)), std::move(right));
+}
+
+// shifts still pending on the way down are added as it goes
+void FoldIndex::collect(const Node* t, int64_t shift, std::vector<Fold>& out) {
+    if (!t) {
+        return ;
+    }
+
+    collect(t->left_.get(), shift + t->shift_, out);
+    auto fold = t->fold_;
+    fold.first_ = shifted(fold.first_, shift);
+    fold.last_ = shifted(fold.last_, shift);
+    out.push_back(fold);
+    collect(t->right_.get(), shift + t->shift_, out);
+}
+
+// the last line of the closed folds starting before line, 0 if there are none
+size_t FoldIndex::hiddenTo(size_t line) const {
+    size_t to = 0;
+    int64_t shift = 0;
+    for (auto* t = root_.get(); t != nullptr; ) {
+        if (shifted(t->fold_.first_, shift) < line) {
+            if (t->fold_.closed_) {
+                to = std::max(to, shifted(t->fold_.last_, shift));
+            }
+            if (t->left_) {
+                to = std::max(to, shifted(t->left_->maxClosedLast_, shift + t->shift_));
+            }
+            shift += t->shift_;
+            t = t->right_.get();
+        } else {
+            shift += t->shift_;
+            t = t->left_.get();
+        }
+    }
+
+    return to;
+}
+
+// the first line of the outermost closed fold hiding line
+size_t FoldIndex::header(const Node* t, int64_t shift, size_t line) {
+    if (!t || shifted(t->maxClosedLast_, shift) < line) {
+        return line;
+    }
+
+    auto found = header(t->left_.get(), shift + t->shift_, line);
+    if (found != line) {
+        return found;
+    }
+    auto first = shifted(t->fold_.first_, shift);
+    if (first >= line) {
+        return line;
+    }
+    if (t->fold_.closed_ && shifted(t->fold_.last_, shift) >= line) {
+        return first;
+    }
+
+    return header(t->right_.get(), shift + t->shift_, line);
+}
+
+void FoldIndex::build(const std::vector<Fold>& folds) {
+    root_.reset();
+    for (auto& fold : folds) {
+        root_ = merge(std::move(root_), newNode(fold));
+    }
+}
\ No newline at end of file
@@ -13,7 +13,7 @@ Font::Font(const std::string& path, uint32_t size) {
     check(FT_Set_Pixel_Sizes(face_, 0, size));
 }
 
-void Font::loadChar(char c) {
+void Font::loadChar(char32_t c) {
     if (FT_Load_Char(face_, c, FT_LOAD_RENDER)) {
         throw std::runtime_error("faield to load char");
     }
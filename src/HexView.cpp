@@ -0,0 +1,74 @@
+#include "HexView.h"
+
+#include <algorithm>
+
+namespace {
+
+constexpr char digits[] = "0123456789abcdef";
+
+}
+
+HexView::HexView(std::shared_ptr<MappedFile> file) : file_(std::move(file)) {
+    // wide enough for the offset of the last byte
+    auto last = std::max<size_t>(file_->size(), 1) - 1;
+    while ((last >> (4 * digits_)) != 0) {
+        digits_++;
+    }
+}
+
+size_t HexView::size() const {
+    return file_->size();
+}
+
+size_t HexView::rows() const {
+    return std::max<size_t>((size() + bytesPerRow_ - 1) / bytesPerRow_, 1);
+}
+
+std::string_view HexView::view() const {
+    return file_->view();
+}
+
+const std::string& HexView::path() const {
+    return file_->path();
+}
+
+size_t HexView::width() const {
+    return asciiColumn(bytesPerRow_);
+}
+
+size_t HexView::hexColumn(size_t i) const {
+    return digits_ + 2 + 3 * i + (i >= bytesPerRow_ / 2);
+}
+
+size_t HexView::asciiColumn(size_t i) const {
+    return hexColumn(bytesPerRow_) + 1 + i;
+}
+
+size_t HexView::format(size_t row, char* out) const {
+    auto begin = row * bytesPerRow_;
+    auto bytes = view().substr(std::min(begin, size()), bytesPerRow_);
+    std::fill(out, out + width(), ' ');
+
+    for (size_t k = 0; k < digits_; k++) {
+        out[digits_ - 1 - k] = digits[begin >> (4 * k) & 0xf];
+    }
+    for (size_t i = 0; i < bytes.size(); i++) {
+        auto byte = static_cast<unsigned char>(bytes[i]);
+        out[hexColumn(i)] = digits[byte >> 4];
+        out[hexColumn(i) + 1] = digits[byte & 0xf];
+        out[asciiColumn(i)] = byte >= 0x20 && byte < 0x7f ? static_cast<char>(byte) : '.';
+    }
+
+    return bytes.size() == bytesPerRow_ ? width() : asciiColumn(bytes.size());
+}
+
+std::string HexView::row(size_t row) const {
+    std::string text(width(), ' ');
+    text.resize(format(row, text.data()));
+
+    return text;
+}
+
+bool HexView::binary(std::string_view head) {
+    return head.substr(0, 8 << 10).find('\0') != std::string_view::npos;
+}
\ No newline at end of file
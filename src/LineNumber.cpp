@@ -1,13 +1,11 @@
 #include "LineNumber.h"
 #include "Editor.h"
 #include "glm/fwd.hpp"
+#include <algorithm>
 #include <iostream>
 
 LineNumber::LineNumber(const Editor& editor) : Editor(editor.screen_.x, editor.screen_.y, editor.lineHeight_) {
-    lines_.clear();
-    lines_.push_back({});
-    addLineNumber(lines_.back(), lines_.size());
-    wordCount_ = lines_.size() * 5;
+    wordCount_ = lineCount_ * 5;
     
     adjust(editor);
 }
@@ -15,24 +13,52 @@ LineNumber::LineNumber(const Editor& editor) : Editor(editor.screen_.x, editor.s
 void LineNumber::adjust(const Editor& editor) {
     adjustCursor(editor);
     limit_ = editor.limit_;
+    rows_.clear();
+    if (editor.wrapped() || editor.folded()) {
+        rows_ = editor.showRows();
+    }
 }
 
 void LineNumber::adjustCursor(const Editor& editor) {
     cursorPos_ = editor.cursorPos_;
-    while (lines_.size() < editor.lines_.size()) {
-        lines_.push_back({});
-        addLineNumber(lines_.back(), lines_.size());
+    lineCount_ = editor.lineCount();
+
+    wordCount_ = lineCount_ * 5;
+}
+
+Editor::Limit LineNumber::showLimit() {
+    auto up = std::max(limit_.up_, 0);
+    auto bottom = std::min(limit_.bottom_, static_cast<int32_t>(lineCount_));
+
+    return {up, bottom};
+}
+
+// labels are only formatted for the visible window; a wrapped line is
+// numbered on its first row, and lines after a fold keep their own numbers
+std::vector<std::string> LineNumber::showLines() {
+    std::vector<std::string> result;
+    if (!rows_.empty()) {
+        for (auto& row : rows_) {
+            result.push_back({});
+            if (row.row_ == 0) {
+                addLineNumber(result.back(), row.line_ + 1);
+            }
+        }
+        return result;
     }
 
-    while (lines_.size() > editor.lines_.size()) {
-        lines_.pop_back();
+    auto limit = showLimit();
+
+    for (auto i = limit.up_; i < limit.bottom_; i++) {
+        result.push_back({});
+        addLineNumber(result.back(), i + 1);
     }
 
-    wordCount_ = lines_.size() * 5;
+    return result;
 }
 
 void LineNumber::addLineNumber(std::string& line, int32_t lineNumber) {
-    char s[10];
-    snprintf(s, 10, "%4d ", lineNumber);
+    char s[16];
+    snprintf(s, 16, "%4d ", lineNumber);
     line = s;
 }
\ No newline at end of file
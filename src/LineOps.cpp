@@ -0,0 +1,109 @@
+#include "LineOps.h"
+#include "Parallel.h"
+#include "TextScan.h"
+
+#include <algorithm>
+#include <vector>
+
+std::string LineOps::run(std::string_view text, Op op, const Regex* regex, size_t threads) {
+    if (text.empty() || ((op == Grep || op == VGrep) && (regex == nullptr || !regex->valid()))) {
+        return std::string(text);
+    }
+
+    // the line feed ending the text is put back after the last line
+    auto ended = text.back() == '\n';
+    auto body = ended ? text.substr(0, text.size() - 1) : text;
+
+    // line starts found chunk by chunk
+    auto chunks = std::max<size_t>((body.size() + chunkSize_ - 1) / chunkSize_, 1);
+    std::vector<std::vector<size_t>> chunkStarts(chunks);
+    Parallel::forEach(chunks, threads, [&](size_t i) {
+        auto begin = std::min(i * chunkSize_, body.size());
+        TextScan::lineStarts(body.data() + begin, std::min(chunkSize_, body.size() - begin), begin, chunkStarts[i]);
+    });
+    std::vector<size_t> starts = {0};
+    for (auto& chunk : chunkStarts) {
+        starts.insert(starts.end(), chunk.begin(), chunk.end());
+        std::vector<size_t>().swap(chunk);
+    }
+    starts.push_back(body.size() + 1);
+
+    auto count = starts.size() - 1;
+    auto blocks = [](size_t count) {
+        return (count + lineBlock_ - 1) / lineBlock_;
+    };
+    std::vector<std::string_view> lines(count);
+    Parallel::forEach(blocks(count), threads, [&](size_t i) {
+        for (auto line = i * lineBlock_; line < std::min(count, (i + 1) * lineBlock_); line++) {
+            lines[line] = body.substr(starts[line], starts[line + 1] - 1 - starts[line]);
+        }
+    });
+    std::vector<size_t>().swap(starts);
+
+    switch (op) {
+    case Sort:
+        Parallel::sort(lines, 0, std::less<std::string_view>(), threads);
+        break;
+    case Reverse:
+        std::reverse(lines.begin(), lines.end());
+        break;
+    case Uniq:
+    case Grep:
+    case VGrep: {
+        // marked on worker threads, then compacted in order
+        std::vector<uint8_t> keep(count);
+        Parallel::forEach(blocks(count), threads, [&](size_t i) {
+            auto first = i * lineBlock_;
+            auto last = std::min(count, (i + 1) * lineBlock_);
+            if (op == Uniq) {
+                for (auto line = first; line < last; line++) {
+                    keep[line] = line == 0 || lines[line] != lines[line - 1];
+                }
+                return ;
+            }
+            Regex::Matcher matcher(*regex);
+            size_t begin, end;
+            for (auto line = first; line < last; line++) {
+                keep[line] = matcher.find(lines[line], 0, begin, end) == (op == Grep);
+            }
+        });
+        size_t kept = 0;
+        for (size_t line = 0; line < count; line++) {
+            if (keep[line]) {
+                lines[kept++] = lines[line];
+            }
+        }
+        lines.resize(kept);
+        count = kept;
+        break;
+    }
+    }
+
+    // every block of lines copied to where the sizes before it put it
+    std::vector<size_t> offsets(blocks(count) + 1);
+    Parallel::forEach(blocks(count), threads, [&](size_t i) {
+        for (auto line = i * lineBlock_; line < std::min(count, (i + 1) * lineBlock_); line++) {
+            offsets[i + 1] += lines[line].size() + 1;
+        }
+    });
+    for (size_t i = 1; i < offsets.size(); i++) {
+        offsets[i] += offsets[i - 1];
+    }
+
+    std::string result;
+    if (count == 0) {
+        return result;
+    }
+    result.resize(offsets.back() - (ended ? 0 : 1));
+    Parallel::forEach(blocks(count), threads, [&](size_t i) {
+        auto out = result.data() + offsets[i];
+        for (auto line = i * lineBlock_; line < std::min(count, (i + 1) * lineBlock_); line++) {
+            out = std::copy(lines[line].begin(), lines[line].end(), out);
+            if (ended || line + 1 < count) {
+                *out++ = '\n';
+            }
+        }
+    });
+
+    return result;
+}
\ No newline at end of file
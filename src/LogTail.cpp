@@ -0,0 +1,167 @@
+#include "LogTail.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+LogTail::LogTail(const std::string& path, size_t offset) : path_(path), watcher_(path), offset_(offset) {
+    // the writer keeps the file open, so every kind of sharing is allowed
+    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE) {
+        file_ = nullptr;
+    }
+}
+
+LogTail::~LogTail() {
+    if (file_ != nullptr) {
+        CloseHandle(file_);
+    }
+}
+
+bool LogTail::valid() const {
+    return file_ != nullptr;
+}
+
+bool LogTail::size(size_t& size) const {
+    LARGE_INTEGER bytes;
+    if (!GetFileSizeEx(file_, &bytes)) {
+        return false;
+    }
+
+    size = static_cast<size_t>(bytes.QuadPart);
+    return true;
+}
+
+bool LogTail::replaced() const {
+    return false;
+}
+
+bool LogTail::readAt(char* data, size_t length, size_t offset) const {
+    while (length > 0) {
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = static_cast<DWORD>(offset);
+        overlapped.OffsetHigh = static_cast<DWORD>(static_cast<uint64_t>(offset) >> 32);
+        DWORD read = 0;
+        if (!ReadFile(file_, data, static_cast<DWORD>(std::min<size_t>(length, 1u << 30)), &read, &overlapped) || read == 0) {
+            return false;
+        }
+        data += read;
+        offset += read;
+        length -= read;
+    }
+
+    return true;
+}
+
+#else
+
+LogTail::LogTail(const std::string& path, size_t offset) : path_(path), watcher_(path), offset_(offset) {
+    fd_ = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+}
+
+LogTail::~LogTail() {
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+bool LogTail::valid() const {
+    return fd_ >= 0;
+}
+
+bool LogTail::size(size_t& size) const {
+    struct stat st;
+    if (fstat(fd_, &st) != 0) {
+        return false;
+    }
+
+    size = static_cast<size_t>(st.st_size);
+    return true;
+}
+
+// renaming another file over the path only unlinks the one held open here,
+// which inotify reports as an attribute change
+bool LogTail::replaced() const {
+    struct stat held, named;
+    if (fstat(fd_, &held) != 0 || stat(path_.c_str(), &named) != 0) {
+        return true;
+    }
+
+    return held.st_ino != named.st_ino || held.st_dev != named.st_dev;
+}
+
+bool LogTail::readAt(char* data, size_t length, size_t offset) const {
+    while (length > 0) {
+        auto n = pread(fd_, data, length, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        offset += n;
+        length -= n;
+    }
+
+    return true;
+}
+
+#endif
+
+// the size is only looked at after an event, so an idle log costs one
+// non-blocking poll per frame
+LogTail::Status LogTail::read(std::string& out, size_t budget) {
+    if (!valid()) {
+        return Idle;
+    }
+
+    auto events = watcher_.poll();
+    if (restart_ || events & FileWatcher::Replaced || (events != FileWatcher::None && replaced())) {
+        restart_ = true;
+        return Restart;
+    }
+    if (events == FileWatcher::None && !behind_) {
+        return Idle;
+    }
+
+    size_t size;
+    if (!this->size(size)) {
+        return Idle;
+    }
+    if (size < offset_) {
+        // truncated, as by copytruncate log rotation
+        restart_ = true;
+        return Restart;
+    }
+
+    auto length = std::min(size - offset_, budget);
+    behind_ = offset_ + length < size;
+    if (length == 0) {
+        return Idle;
+    }
+
+    auto begin = out.size();
+    out.resize(begin + length);
+    if (!readAt(out.data() + begin, length, offset_)) {
+        out.resize(begin);
+        return Idle;
+    }
+    offset_ += length;
+
+    return Appended;
+}
+
+size_t LogTail::offset() const {
+    return offset_;
+}
\ No newline at end of file
@@ -0,0 +1,178 @@
+#include "Lz.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+uint32_t load32(const char* data) {
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+uint64_t load64(const char* data) {
+    uint64_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+size_t hash(uint32_t value) {
+    return (value * 2654435761u) >> (32 - Lz::hashBits_);
+}
+
+// the part of a length past the 15 its nibble holds
+void putLength(std::string& out, size_t length) {
+    for ( ; length >= 255; length -= 255) {
+        out += static_cast<char>(255);
+    }
+    out += static_cast<char>(length);
+}
+
+void putSequence(std::string& out, std::string_view literals, size_t offset, size_t match) {
+    auto token = std::min<size_t>(literals.size(), 15) << 4;
+    if (match != 0) {
+        token |= std::min<size_t>(match - Lz::minMatch_, 15);
+    }
+    out += static_cast<char>(token);
+    if (literals.size() >= 15) {
+        putLength(out, literals.size() - 15);
+    }
+    out += literals;
+    if (match == 0) {
+        return ;
+    }
+
+    out += static_cast<char>(offset & 0xff);
+    out += static_cast<char>(offset >> 8);
+    if (match - Lz::minMatch_ >= 15) {
+        putLength(out, match - Lz::minMatch_ - 15);
+    }
+}
+
+}
+
+// greedy, over the last ways_ positions seen with the same hash of four
+// bytes; runs without matches are skipped through faster and faster
+std::string Lz::compress(std::string_view data) {
+    std::string out;
+    out.reserve(data.size() / 2 + 16);
+    // position + 1 of the last four byte strings hashing to each bucket
+    std::vector<uint32_t> table((size_t(1) << hashBits_) * ways_, 0);
+
+    auto text = data.data();
+    auto matchLength = [&](size_t from, size_t i) {
+        size_t length = 0;
+        while (i + length + 8 <= data.size()) {
+            auto diff = load64(text + from + length) ^ load64(text + i + length);
+            if (diff != 0) {
+                return length + __builtin_ctzll(diff) / 8;
+            }
+            length += 8;
+        }
+        while (i + length < data.size() && text[from + length] == text[i + length]) {
+            length++;
+        }
+        return length;
+    };
+    auto insert = [&](size_t i) {
+        auto bucket = table.data() + hash(load32(text + i)) * ways_;
+        std::memmove(bucket + 1, bucket, (ways_ - 1) * sizeof(uint32_t));
+        bucket[0] = static_cast<uint32_t>(i + 1);
+    };
+
+    size_t anchor = 0, i = 0;
+    while (i + minMatch_ <= data.size()) {
+        auto bucket = table.data() + hash(load32(text + i)) * ways_;
+        size_t best = 0, from = 0;
+        for (size_t way = 0; way < ways_ && bucket[way] != 0 && i - (bucket[way] - 1) <= window_; way++) {
+            auto length = matchLength(bucket[way] - 1, i);
+            if (length > best) {
+                best = length;
+                from = bucket[way] - 1;
+            }
+        }
+        insert(i);
+        if (best < minMatch_) {
+            i += 1 + ((i - anchor) >> 6);
+            continue;
+        }
+
+        putSequence(out, data.substr(anchor, i - anchor), i - from, best);
+        for (auto end = i + best, k = i + 1; k < end && k + minMatch_ <= data.size(); k += 3) {
+            insert(k);
+        }
+        i += best;
+        anchor = i;
+    }
+    if (anchor < data.size()) {
+        putSequence(out, data.substr(anchor), 0, 0);
+    }
+
+    return out;
+}
+
+bool Lz::decompress(std::string_view packed, char* out, size_t size) {
+    auto in = reinterpret_cast<const unsigned char*>(packed.data());
+    auto end = in + packed.size();
+    auto more = [&](size_t& length) {
+        unsigned char byte;
+        do {
+            if (in == end) {
+                return false;
+            }
+            byte = *in++;
+            length += byte;
+        } while (byte == 255);
+        return true;
+    };
+
+    size_t at = 0;
+    while (at < size) {
+        if (in == end) {
+            return false;
+        }
+        auto token = *in++;
+
+        size_t literals = token >> 4;
+        if (literals == 15 && !more(literals)) {
+            return false;
+        }
+        if (literals > size - at || literals > static_cast<size_t>(end - in)) {
+            return false;
+        }
+        std::memcpy(out + at, in, literals);
+        in += literals;
+        at += literals;
+        if (at == size) {
+            break;
+        }
+
+        if (end - in < 2) {
+            return false;
+        }
+        size_t offset = in[0] | in[1] << 8;
+        in += 2;
+        size_t match = token & 15;
+        if (match == 15 && !more(match)) {
+            return false;
+        }
+        match += minMatch_;
+        if (offset == 0 || offset > at || match > size - at) {
+            return false;
+        }
+
+        // a match may overlap the bytes it is producing
+        if (offset >= match) {
+            std::memcpy(out + at, out + at - offset, match);
+        } else {
+            for (size_t k = 0; k < match; k++) {
+                out[at + k] = out[at + k - offset];
+            }
+        }
+        at += match;
+    }
+
+    return at == size && in == end;
+}
\ No newline at end of file
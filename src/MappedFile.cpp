@@ -0,0 +1,217 @@
+#include "MappedFile.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <csignal>
+#include <fcntl.h>
+#include <mutex>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path) : path_(path) {
+    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE) {
+        file_ = nullptr;
+        return ;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file_, &size)) {
+        return ;
+    }
+    size_ = static_cast<size_t>(size.QuadPart);
+    valid_ = true;
+
+    if (size_ == 0) {
+        return ;
+    }
+
+    if (size_ <= copyLimit_) {
+        copy_.reset(new char[size_]);
+        for (size_t done = 0; done < size_; ) {
+            DWORD read = 0;
+            auto want = static_cast<DWORD>(std::min<size_t>(size_ - done, 1u << 30));
+            if (!ReadFile(file_, copy_.get() + done, want, &read, nullptr) || read == 0) {
+                copy_.reset();
+                size_ = 0;
+                valid_ = false;
+                return ;
+            }
+            done += read;
+        }
+        data_ = copy_.get();
+        return ;
+    }
+
+    mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_ == nullptr) {
+        valid_ = false;
+        return ;
+    }
+
+    data_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    valid_ = data_ != nullptr;
+}
+
+MappedFile::~MappedFile() {
+    if (data_ != nullptr && copy_ == nullptr) {
+        UnmapViewOfFile(data_);
+    }
+    if (mapping_ != nullptr) {
+        CloseHandle(mapping_);
+    }
+    if (file_ != nullptr) {
+        CloseHandle(file_);
+    }
+}
+
+void MappedFile::release(size_t offset, size_t length) const {
+    // clean file-backed pages are simply dropped from the working set
+    if (data_ != nullptr && copy_ == nullptr && offset < size_) {
+        VirtualUnlock(const_cast<char*>(data_) + offset, std::min(length, size_ - offset));
+    }
+}
+
+#else
+
+namespace {
+
+// a mapping a SIGBUS may come from; empty while end_ is 0
+struct Guard {
+    std::atomic<bool> used_ = false;
+    std::atomic<uintptr_t> begin_ = 0;
+    std::atomic<uintptr_t> end_ = 0;
+    std::atomic<std::atomic<bool>*> truncated_ = nullptr;
+};
+
+Guard guards[64];
+struct sigaction previous;
+size_t pageSize;
+
+// a read past the end of a file made shorter: the page becomes one of zeros
+// and the read is done again. A fault anywhere else goes to the handler there
+// was before
+void onBus(int, siginfo_t* info, void*) {
+    auto at = reinterpret_cast<uintptr_t>(info->si_addr);
+    for (auto& guard : guards) {
+        if (at < guard.begin_ || at >= guard.end_) {
+            continue;
+        }
+        auto page = reinterpret_cast<void*>(at / pageSize * pageSize);
+        if (mmap(page, pageSize, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) != MAP_FAILED) {
+            if (auto truncated = guard.truncated_.load()) {
+                truncated->store(true);
+            }
+            return ;
+        }
+    }
+    sigaction(SIGBUS, &previous, nullptr);
+}
+
+void guard(const char* data, size_t size, std::atomic<bool>* truncated) {
+    static std::once_flag installed;
+    std::call_once(installed, [] {
+        pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        struct sigaction action = {};
+        action.sa_sigaction = onBus;
+        action.sa_flags = SA_SIGINFO;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGBUS, &action, &previous);
+    });
+
+    for (auto& guard : guards) {
+        if (!guard.used_.exchange(true)) {
+            guard.truncated_ = truncated;
+            guard.begin_ = reinterpret_cast<uintptr_t>(data);
+            guard.end_ = reinterpret_cast<uintptr_t>(data) + size;
+            return ;
+        }
+    }
+    // more mappings than guards: this one is left unguarded
+}
+
+void unguard(const char* data) {
+    for (auto& guard : guards) {
+        if (guard.used_ && guard.begin_ == reinterpret_cast<uintptr_t>(data)) {
+            guard.end_ = 0;
+            guard.begin_ = 0;
+            guard.truncated_ = nullptr;
+            guard.used_ = false;
+            return ;
+        }
+    }
+}
+
+}
+
+MappedFile::MappedFile(const std::string& path) : path_(path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return ;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return ;
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    valid_ = true;
+
+    if (size_ > 0 && size_ <= copyLimit_) {
+        copy_.reset(new char[size_]);
+        for (size_t done = 0; done < size_; ) {
+            auto read = pread(fd, copy_.get() + done, size_ - done, static_cast<off_t>(done));
+            if (read <= 0) {
+                copy_.reset();
+                size_ = 0;
+                valid_ = false;
+                break;
+            }
+            done += static_cast<size_t>(read);
+        }
+        data_ = copy_.get();
+    } else if (size_ > 0) {
+        auto data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            valid_ = false;
+            size_ = 0;
+        } else {
+            data_ = static_cast<const char*>(data);
+            madvise(data, size_, MADV_SEQUENTIAL);
+            guard(data_, size_, &truncated_);
+        }
+    }
+
+    // the mapping keeps the file referenced
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data_ != nullptr && copy_ == nullptr) {
+        unguard(data_);
+        munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+// drops resident pages of [offset, offset + length); they are faulted back in
+// from the file on the next access
+void MappedFile::release(size_t offset, size_t length) const {
+    if (data_ == nullptr || copy_ != nullptr || offset >= size_) {
+        return ;
+    }
+
+    static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    auto begin = offset / pageSize * pageSize;
+    auto end = std::min(offset + length, size_);
+    madvise(const_cast<char*>(data_) + begin, end - begin, MADV_DONTNEED);
+}
+
+#endif
\ No newline at end of file
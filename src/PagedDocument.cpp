@@ -0,0 +1,222 @@
+#include "PagedDocument.h"
+#include "TextScan.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr size_t chunkSize = 4 << 20;
+// guards against files without line feeds turning one page into the whole file
+constexpr size_t maxPageBytes = 64 << 20;
+
+}
+
+PagedDocument::PagedDocument(std::shared_ptr<MappedFile> file, size_t maxPages) : file_(std::move(file)), maxPages_(maxPages) {
+    pageStarts_.push_back(0);
+
+    // index the head synchronously so the first screen never waits on the thread
+    std::vector<size_t> scratch;
+    auto head = std::min(chunkSize, file_->size());
+    indexChunk(0, head, scratch);
+
+    if (head == file_->size()) {
+        indexed_ = true;
+    } else {
+        indexer_ = std::thread(&PagedDocument::index, this);
+    }
+}
+
+PagedDocument::~PagedDocument() {
+    stop_ = true;
+    if (indexer_.joinable()) {
+        indexer_.join();
+    }
+}
+
+bool PagedDocument::indexed() const {
+    return indexed_;
+}
+
+size_t PagedDocument::size() const {
+    return file_->size();
+}
+
+// lines are only counted once their line feed has been seen; the last one is
+// added when indexing finishes
+size_t PagedDocument::lineCount() const {
+    return lineFeeds_ + (indexed_ ? 1 : 0);
+}
+
+size_t PagedDocument::chars() const {
+    return chars_;
+}
+
+size_t PagedDocument::words() const {
+    return words_;
+}
+
+size_t PagedDocument::lineLength(size_t line) {
+    auto& p = page(line / pageLines_);
+    auto i = line % pageLines_;
+    if (i + 1 >= p.starts_.size()) {
+        return 0;
+    }
+
+    return p.starts_[i + 1] - p.starts_[i] - 1;
+}
+
+char PagedDocument::at(size_t line, size_t column) {
+    auto& p = page(line / pageLines_);
+    auto i = line % pageLines_;
+
+    return p.text_[p.starts_[i] + column];
+}
+
+std::string PagedDocument::line(size_t line) {
+    auto& p = page(line / pageLines_);
+    auto i = line % pageLines_;
+    if (i + 1 >= p.starts_.size()) {
+        return {};
+    }
+
+    return p.text_.substr(p.starts_[i], p.starts_[i + 1] - p.starts_[i] - 1);
+}
+
+std::vector<std::string> PagedDocument::lines(size_t first, size_t last) {
+    std::vector<std::string> result;
+    last = std::min(last, lineCount());
+    if (first < last) {
+        result.reserve(last - first);
+    }
+
+    for (auto i = first; i < last; i++) {
+        result.push_back(line(i));
+    }
+
+    return result;
+}
+
+size_t PagedDocument::lineStart(size_t line) {
+    auto& p = page(line / pageLines_);
+    auto i = line % pageLines_;
+    if (i >= p.starts_.size()) {
+        return size();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pageStarts_[line / pageLines_] + p.starts_[i];
+}
+
+// counts line feeds from the closest indexed page start
+size_t PagedDocument::lineOf(size_t offset) {
+    offset = std::min(offset, size());
+
+    size_t number, begin;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        number = std::upper_bound(pageStarts_.begin(), pageStarts_.end(), offset) - pageStarts_.begin() - 1;
+        begin = pageStarts_[number];
+    }
+
+    return number * pageLines_ + TextScan::count(file_->data() + begin, offset - begin, '\n');
+}
+
+std::string_view PagedDocument::view() const {
+    return file_->view();
+}
+
+const std::string& PagedDocument::path() const {
+    return file_->path();
+}
+
+void PagedDocument::index() {
+    std::vector<size_t> scratch;
+    for (auto begin = chunkSize; begin < file_->size() && !stop_; begin += chunkSize) {
+        auto end = std::min(begin + chunkSize, file_->size());
+        indexChunk(begin, end, scratch);
+
+        // the scan touched every page of the chunk, give them back
+        file_->release(begin, end - begin);
+    }
+
+    indexed_ = !stop_;
+}
+
+void PagedDocument::indexChunk(size_t begin, size_t end, std::vector<size_t>& scratch) {
+    scratch.clear();
+    auto data = file_->data();
+    TextScan::lineStarts(data + begin, end - begin, begin, scratch);
+
+    size_t chars = 0, words = 0;
+    TextScan::stats(data + begin, end - begin, begin == 0 || TextScan::space(data[begin - 1]), chars, words);
+    chars_ += chars;
+    words_ += words;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto start : scratch) {
+        if (++pendingLines_ == pageLines_) {
+            pendingLines_ = 0;
+            pageStarts_.push_back(start);
+        }
+    }
+    lineFeeds_ += scratch.size();
+}
+
+PagedDocument::Page& PagedDocument::page(size_t number) {
+    auto it = pages_.find(number);
+    if (it != pages_.end()) {
+        it->second.lastUse_ = ++tick_;
+        return it->second;
+    }
+
+    size_t begin, end;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (number >= pageStarts_.size()) {
+            static Page empty;
+            return empty;
+        }
+        begin = pageStarts_[number];
+        end = number + 1 < pageStarts_.size() ? pageStarts_[number + 1] : file_->size();
+    }
+
+    // when the next page start is still unknown, stop after pageLines_ lines
+    Page page;
+    page.starts_.reserve(pageLines_ + 1);
+    page.starts_.push_back(0);
+    auto data = file_->data() + begin;
+    auto size = std::min(end - begin, maxPageBytes);
+    for (size_t pos = 0; pos < size && page.starts_.size() <= pageLines_; ) {
+        auto lf = static_cast<const char*>(memchr(data + pos, '\n', size - pos));
+        pos = lf == nullptr ? size : lf - data + 1;
+        if (lf == nullptr) {
+            // unterminated last line
+            page.starts_.push_back(static_cast<uint32_t>(size + 1));
+            break;
+        }
+        page.starts_.push_back(static_cast<uint32_t>(pos));
+    }
+
+    auto length = std::min<size_t>(page.starts_.back(), size);
+    page.text_.assign(data, length);
+    page.lastUse_ = ++tick_;
+
+    // the page owns a copy now; keeping the mapped range resident would make
+    // memory grow with every page ever viewed
+    file_->release(begin, length);
+
+    evict();
+
+    return pages_[number] = std::move(page);
+}
+
+void PagedDocument::evict() {
+    while (pages_.size() >= maxPages_) {
+        auto victim = std::min_element(pages_.begin(), pages_.end(), [](auto& a, auto& b) {
+            return a.second.lastUse_ < b.second.lastUse_;
+        });
+
+        pages_.erase(victim);
+    }
+}
\ No newline at end of file
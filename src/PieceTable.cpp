@@ -0,0 +1,758 @@
+#include "PieceTable.h"
+#include "TextScan.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+PieceTable::PieceTable() {
+
+}
+
+PieceTable::PieceTable(std::string text) {
+    auto owner = std::make_shared<const std::string>(std::move(text));
+    *this = PieceTable(owner, *owner);
+}
+
+PieceTable::PieceTable(std::shared_ptr<const void> owner, std::string_view text) {
+    std::vector<size_t> starts;
+    appendLineStarts(starts, text, 0);
+    *this = PieceTable(std::move(owner), text, std::move(starts));
+}
+
+PieceTable::PieceTable(std::shared_ptr<const void> owner, std::string_view text, std::vector<size_t> lineStarts)
+    : originalOwner_(std::move(owner)), original_(text) {
+    originalLineStarts_.append(lineStarts.data(), lineStarts.size());
+    appendCounts(Original);
+    if (!original_.empty()) {
+        Piece piece;
+        piece.source_ = Original;
+        piece.start_ = 0;
+        piece.length_ = original_.size();
+        piece.lineFeeds_ = originalLineStarts_.size();
+        count(piece);
+        root_ = newNode(piece);
+    }
+}
+
+void PieceTable::insert(size_t offset, std::string_view text) {
+    if (text.empty()) {
+        return ;
+    }
+    offset = std::min(offset, size());
+
+    auto pieces = add(text);
+    Tree l, r;
+    split(std::move(root_), offset, l, r);
+
+    // typing appends to the piece that ended where the added buffer ended
+    if (!extendLast(l, pieces.front())) {
+        l = merge(std::move(l), newNode(pieces.front()));
+    }
+    for (size_t i = 1; i < pieces.size(); i++) {
+        l = merge(std::move(l), newNode(pieces[i]));
+    }
+
+    root_ = merge(std::move(l), std::move(r));
+}
+
+void PieceTable::erase(size_t offset, size_t length) {
+    if (offset >= size() || length == 0) {
+        return ;
+    }
+    length = std::min(length, size() - offset);
+
+    Tree l, m, r;
+    split(std::move(root_), offset, l, m);
+    split(std::move(m), length, m, r);
+
+    root_ = merge(std::move(l), std::move(r));
+}
+
+// at every offset (ascending, ranges not overlapping) replaces erase bytes with
+// insert, in one walk over the pieces; the tree is rebuilt from the result. The
+// inserted bytes are stored once and shared by all the new pieces, so typing at
+// many cursors keeps extending the same pieces.
+void PieceTable::replaceAt(const std::vector<size_t>& offsets, size_t erase, std::string_view insert) {
+    if (offsets.empty()) {
+        return ;
+    }
+
+    auto added = add(insert);
+
+    std::vector<Piece> in;
+    in.reserve(root_ ? root_->pieces_ : 0);
+    collectPieces(root_, in);
+
+    std::vector<Piece> out;
+    out.reserve(in.size() + offsets.size() * (added.size() + 1) + 1);
+    auto emit = [this, &out](const Piece& piece) {
+        if (piece.length_ == 0) {
+            return ;
+        }
+
+        if (!out.empty()) {
+            auto& last = out.back();
+            if (last.source_ == piece.source_ && last.start_ + last.length_ == piece.start_) {
+                join(last, piece);
+                return ;
+            }
+        }
+        out.push_back(piece);
+    };
+
+    // pos is the document offset of in[i] plus used
+    size_t pos = 0, i = 0, used = 0;
+    auto advance = [&](size_t target, bool keep) {
+        while (pos < target && i < in.size()) {
+            auto n = std::min(in[i].length_ - used, target - pos);
+            if (keep) {
+                emit(slice(in[i], used, n));
+            }
+            used += n;
+            pos += n;
+            if (used == in[i].length_) {
+                i++;
+                used = 0;
+            }
+        }
+    };
+
+    auto total = size();
+    for (auto offset : offsets) {
+        advance(offset, true);
+        advance(std::min(offset + erase, total), false);
+        for (auto& piece : added) {
+            emit(piece);
+        }
+    }
+    advance(total, true);
+
+    build(out);
+}
+
+void PieceTable::clear() {
+    originalOwner_.reset();
+    original_ = {};
+    added_.clear();
+    originalLineStarts_.clear();
+    addedLineStarts_.clear();
+    originalCounts_ = {};
+    addedCounts_ = {};
+    root_.reset();
+}
+
+void PieceTable::ownOriginal() {
+    auto owner = std::make_shared<const std::string>(original_);
+    original_ = *owner;
+    originalOwner_ = std::move(owner);
+}
+
+size_t PieceTable::size() const {
+    return length(root_);
+}
+
+size_t PieceTable::lineCount() const {
+    return lineFeeds(root_) + 1;
+}
+
+size_t PieceTable::chars() const {
+    return root_ ? root_->chars_ : 0;
+}
+
+size_t PieceTable::words() const {
+    return root_ ? root_->words_ : 0;
+}
+
+size_t PieceTable::lineStart(size_t line) const {
+    if (line == 0) {
+        return 0;
+    }
+    if (line >= lineCount()) {
+        return size();
+    }
+
+    size_t base = 0;
+    auto t = root_.get();
+    while (t != nullptr) {
+        auto& node = *t;
+        auto leftLineFeeds = lineFeeds(node.left_);
+        if (line <= leftLineFeeds) {
+            t = node.left_.get();
+            continue;
+        }
+
+        line -= leftLineFeeds;
+        base += length(node.left_);
+        if (line <= node.piece_.lineFeeds_) {
+            return base + lineFeedEnd(node.piece_, line);
+        }
+
+        line -= node.piece_.lineFeeds_;
+        base += node.piece_.length_;
+        t = node.right_.get();
+    }
+
+    return size();
+}
+
+size_t PieceTable::lineLength(size_t line) const {
+    if (line >= lineCount()) {
+        return 0;
+    }
+
+    auto begin = lineStart(line);
+    auto end = line + 1 < lineCount() ? lineStart(line + 1) - 1 : size();
+
+    return end - begin;
+}
+
+size_t PieceTable::lineOf(size_t offset) const {
+    offset = std::min(offset, size());
+
+    size_t line = 0;
+    auto t = root_.get();
+    while (t != nullptr) {
+        auto& node = *t;
+        auto leftLength = length(node.left_);
+        if (offset < leftLength) {
+            t = node.left_.get();
+            continue;
+        }
+
+        line += lineFeeds(node.left_);
+        offset -= leftLength;
+        if (offset <= node.piece_.length_) {
+            return line + countLineFeeds(node.piece_.source_, node.piece_.start_, offset);
+        }
+
+        line += node.piece_.lineFeeds_;
+        offset -= node.piece_.length_;
+        t = node.right_.get();
+    }
+
+    return line;
+}
+
+char PieceTable::at(size_t offset) const {
+    auto t = root_.get();
+    while (t != nullptr) {
+        auto& node = *t;
+        auto leftLength = length(node.left_);
+        if (offset < leftLength) {
+            t = node.left_.get();
+        } else if (offset < leftLength + node.piece_.length_) {
+            return *data(node.piece_.source_, node.piece_.start_ + offset - leftLength);
+        } else {
+            offset -= leftLength + node.piece_.length_;
+            t = node.right_.get();
+        }
+    }
+
+    throw std::out_of_range("piece table offset out of range");
+}
+
+std::string PieceTable::line(size_t line) const {
+    return text(lineStart(line), lineLength(line));
+}
+
+std::vector<std::string> PieceTable::lines(size_t first, size_t last) const {
+    std::vector<std::string> result;
+    last = std::min(last, lineCount());
+    if (first >= last) {
+        return result;
+    }
+
+    // one descent for the window, then a single in-order copy
+    auto begin = lineStart(first);
+    auto end = last < lineCount() ? lineStart(last) : size();
+    auto block = text(begin, end - begin);
+
+    result.reserve(last - first);
+    size_t pos = 0;
+    for (auto i = first; i < last; i++) {
+        auto lf = block.find('\n', pos);
+        if (lf == std::string::npos) {
+            lf = block.size();
+        }
+        result.emplace_back(block, pos, lf - pos);
+        pos = lf + 1;
+    }
+
+    return result;
+}
+
+std::string PieceTable::text(size_t offset, size_t length) const {
+    std::string result;
+    if (offset >= size()) {
+        return result;
+    }
+    length = std::min(length, size() - offset);
+
+    result.reserve(length);
+    collect(root_, offset, length, result);
+
+    return result;
+}
+
+std::string PieceTable::text() const {
+    return text(0, size());
+}
+
+// views stay valid until the table is modified or destroyed
+std::vector<std::string_view> PieceTable::pieces() const {
+    std::vector<std::string_view> result;
+    result.reserve(root_ ? root_->pieces_ : 0);
+    collectPieces(root_, result);
+
+    return result;
+}
+
+const std::shared_ptr<const void>& PieceTable::originalOwner() const {
+    return originalOwner_;
+}
+
+std::string_view PieceTable::original() const {
+    return original_;
+}
+
+size_t PieceTable::memory() const {
+    auto memory = added_.capacity();
+    memory += originalLineStarts_.memory() + addedLineStarts_.memory();
+    for (auto counts : {&originalCounts_, &addedCounts_}) {
+        memory += counts->chars_.memory() + counts->words_.memory();
+    }
+    // a node and the control block make_shared puts next to it
+    memory += (root_ ? root_->pieces_ : 0) * (sizeof(Node) + 2 * sizeof(void*));
+
+    return memory;
+}
+
+// the added text outside [begin, end) of the document, erased text included,
+// is kept compressed until it is read again
+size_t PieceTable::freeze(size_t begin, size_t end, size_t pack) {
+    std::vector<std::pair<size_t, size_t>> hot;
+    begin = std::min(begin, size());
+    collectRanges(root_, begin, std::min(end, size()) - begin, hot);
+    std::sort(hot.begin(), hot.end());
+
+    return added_.freeze(hot, pack);
+}
+
+PieceTable::Tree PieceTable::newNode(const Piece& piece) {
+    auto node = std::make_shared<Node>();
+    node->piece_ = piece;
+    node->length_ = piece.length_;
+    node->lineFeeds_ = piece.lineFeeds_;
+    node->chars_ = piece.chars_;
+    node->words_ = piece.words_;
+    node->pieces_ = 1;
+    node->head_ = piece.head_;
+    node->tail_ = piece.tail_;
+
+    seed_ ^= seed_ << 13;
+    seed_ ^= seed_ >> 17;
+    seed_ ^= seed_ << 5;
+    node->priority_ = seed_;
+
+    return node;
+}
+
+// the node of t, copied first if a copy of the table shares it. Going down
+// from the root, a node reached only through nodes owned so far is shared
+// exactly when its count says so: copying a parent adds a reference to each
+// child
+PieceTable::Node& PieceTable::own(Tree& t) {
+    if (t.use_count() > 1) {
+        t = std::make_shared<Node>(*t);
+    }
+
+    return *t;
+}
+
+// a word cut by a piece boundary is counted on both sides, the join takes one off
+void PieceTable::update(Node& node) {
+    auto& piece = node.piece_;
+    node.length_ = piece.length_ + length(node.left_) + length(node.right_);
+    node.lineFeeds_ = piece.lineFeeds_ + lineFeeds(node.left_) + lineFeeds(node.right_);
+    node.chars_ = piece.chars_;
+    node.words_ = piece.words_;
+    node.pieces_ = 1;
+
+    node.head_ = piece.head_;
+    node.tail_ = piece.tail_;
+    if (node.left_) {
+        auto& left = *node.left_;
+        node.chars_ += left.chars_;
+        node.words_ += left.words_ - (left.tail_ && piece.head_);
+        node.pieces_ += left.pieces_;
+        node.head_ = left.head_;
+    }
+    if (node.right_) {
+        auto& right = *node.right_;
+        node.chars_ += right.chars_;
+        node.words_ += right.words_ - (piece.tail_ && right.head_);
+        node.pieces_ += right.pieces_;
+        node.tail_ = right.tail_;
+    }
+}
+
+size_t PieceTable::length(const Tree& t) {
+    return t ? t->length_ : 0;
+}
+
+size_t PieceTable::lineFeeds(const Tree& t) {
+    return t ? t->lineFeeds_ : 0;
+}
+
+// the trees are passed by value and moved in, so a node's count only holds
+// the references that share it
+PieceTable::Tree PieceTable::merge(Tree a, Tree b) {
+    if (!a) {
+        return b;
+    }
+    if (!b) {
+        return a;
+    }
+
+    if (a->priority_ > b->priority_) {
+        auto& node = own(a);
+        node.right_ = merge(std::move(node.right_), std::move(b));
+        update(node);
+        return a;
+    }
+
+    auto& node = own(b);
+    node.left_ = merge(std::move(a), std::move(node.left_));
+    update(node);
+    return b;
+}
+
+// l receives the first `offset` bytes of t, r the rest; a piece straddling the
+// boundary is cut in two
+void PieceTable::split(Tree t, size_t offset, Tree& l, Tree& r) {
+    if (!t) {
+        l = r = nullptr;
+        return ;
+    }
+
+    auto& node = own(t);
+    auto leftLength = length(node.left_);
+    auto pieceLength = node.piece_.length_;
+
+    if (offset <= leftLength) {
+        Tree left;
+        split(std::move(node.left_), offset, l, left);
+        node.left_ = std::move(left);
+        update(node);
+        r = std::move(t);
+    } else if (offset >= leftLength + pieceLength) {
+        Tree right;
+        split(std::move(node.right_), offset - leftLength - pieceLength, right, r);
+        node.right_ = std::move(right);
+        update(node);
+        l = std::move(t);
+    } else {
+        auto cut = offset - leftLength;
+        auto head = node.piece_;
+        Piece tail = head;
+        tail.start_ = head.start_ + cut;
+        tail.length_ = head.length_ - cut;
+        tail.lineFeeds_ = countLineFeeds(tail.source_, tail.start_, tail.length_);
+        count(tail);
+        head.length_ = cut;
+        head.lineFeeds_ -= tail.lineFeeds_;
+        head.chars_ -= tail.chars_;
+        head.words_ -= tail.words_;
+        head.tail_ = wordAt(head.source_, tail.start_ - 1);
+        head.words_ += tail.head_ && head.tail_;
+
+        auto right = std::move(node.right_);
+        node.piece_ = head;
+        update(node);
+
+        l = std::move(t);
+        r = merge(newNode(tail), std::move(right));
+    }
+}
+
+// the last piece is looked at before anything is copied
+bool PieceTable::extendLast(Tree& t, const Piece& next) {
+    auto last = t.get();
+    while (last != nullptr && last->right_) {
+        last = last->right_.get();
+    }
+    if (last == nullptr || last->piece_.source_ != next.source_ || last->piece_.start_ + last->piece_.length_ != next.start_) {
+        return false;
+    }
+
+    std::vector<Node*> spine;
+    for (auto tree = &t; *tree; tree = &(*tree)->right_) {
+        spine.push_back(&own(*tree));
+    }
+    join(spine.back()->piece_, next);
+    for (auto it = spine.rbegin(); it != spine.rend(); ++it) {
+        update(**it);
+    }
+
+    return true;
+}
+
+void PieceTable::collect(const Tree& t, size_t offset, size_t length, std::string& out) const {
+    if (!t || length == 0) {
+        return ;
+    }
+
+    auto& node = *t;
+    auto leftLength = this->length(node.left_);
+    auto pieceLength = node.piece_.length_;
+
+    if (offset < leftLength) {
+        auto n = std::min(length, leftLength - offset);
+        collect(node.left_, offset, n, out);
+        offset = leftLength;
+        length -= n;
+    }
+
+    if (length > 0 && offset < leftLength + pieceLength) {
+        auto begin = offset - leftLength;
+        auto n = std::min(length, pieceLength - begin);
+        out.append(data(node.piece_.source_, node.piece_.start_ + begin), n);
+        offset += n;
+        length -= n;
+    }
+
+    if (length > 0) {
+        collect(node.right_, offset - leftLength - pieceLength, length, out);
+    }
+}
+
+void PieceTable::collectRanges(const Tree& t, size_t offset, size_t length, std::vector<std::pair<size_t, size_t>>& out) const {
+    if (!t || length == 0) {
+        return ;
+    }
+
+    auto& node = *t;
+    auto leftLength = this->length(node.left_);
+    auto pieceLength = node.piece_.length_;
+
+    if (offset < leftLength) {
+        auto n = std::min(length, leftLength - offset);
+        collectRanges(node.left_, offset, n, out);
+        offset = leftLength;
+        length -= n;
+    }
+
+    if (length > 0 && offset < leftLength + pieceLength) {
+        auto begin = offset - leftLength;
+        auto n = std::min(length, pieceLength - begin);
+        if (node.piece_.source_ == Added) {
+            out.emplace_back(node.piece_.start_ + begin, node.piece_.start_ + begin + n);
+        }
+        offset += n;
+        length -= n;
+    }
+
+    if (length > 0) {
+        collectRanges(node.right_, offset - leftLength - pieceLength, length, out);
+    }
+}
+
+void PieceTable::collectPieces(const Tree& t, std::vector<std::string_view>& out) const {
+    if (!t) {
+        return ;
+    }
+
+    auto& node = *t;
+    collectPieces(node.left_, out);
+    out.emplace_back(data(node.piece_.source_, node.piece_.start_), node.piece_.length_);
+    collectPieces(node.right_, out);
+}
+
+void PieceTable::collectPieces(const Tree& t, std::vector<Piece>& out) const {
+    if (!t) {
+        return ;
+    }
+
+    collectPieces(t->left_, out);
+    out.push_back(t->piece_);
+    collectPieces(t->right_, out);
+}
+
+PieceTable::Piece PieceTable::slice(const Piece& piece, size_t begin, size_t length) const {
+    if (begin == 0 && length == piece.length_) {
+        return piece;
+    }
+
+    Piece result = piece;
+    result.start_ = piece.start_ + begin;
+    result.length_ = length;
+    result.lineFeeds_ = countLineFeeds(piece.source_, result.start_, length);
+    count(result);
+
+    return result;
+}
+
+// replaces the tree with the pieces in order: a Cartesian tree over fresh
+// priorities, built with a stack in linear time
+void PieceTable::build(const std::vector<Piece>& pieces) {
+    std::vector<Tree> stack;
+    for (auto& piece : pieces) {
+        auto t = newNode(piece);
+        Tree last;
+        while (!stack.empty() && stack.back()->priority_ < t->priority_) {
+            last = std::move(stack.back());
+            stack.pop_back();
+        }
+
+        t->left_ = std::move(last);
+        if (!stack.empty()) {
+            stack.back()->right_ = t;
+        }
+        stack.push_back(std::move(t));
+    }
+
+    root_ = stack.empty() ? nullptr : stack.front();
+    stack.clear();
+    if (root_) {
+        refresh(*root_);
+    }
+}
+
+void PieceTable::refresh(Node& node) {
+    if (node.left_) {
+        refresh(*node.left_);
+    }
+    if (node.right_) {
+        refresh(*node.right_);
+    }
+    update(node);
+}
+
+// text stored in the added buffer as pieces of at most a chunk each
+std::vector<PieceTable::Piece> PieceTable::add(std::string_view text) {
+    std::vector<Piece> pieces;
+    std::vector<size_t> starts;
+    for (size_t done = 0; done < text.size(); ) {
+        auto part = text.substr(done, ChunkArena::maxAppend_);
+        Piece piece;
+        piece.source_ = Added;
+        auto end = added_.size();
+        piece.start_ = added_.append(part);
+        piece.length_ = part.size();
+        starts.clear();
+        TextScan::lineStarts(part.data(), part.size(), piece.start_, starts);
+        addedLineStarts_.append(starts.data(), starts.size());
+        piece.lineFeeds_ = starts.size();
+        appendCounts(Added, end, piece.start_);
+        count(piece);
+        pieces.push_back(piece);
+        done += part.size();
+    }
+
+    return pieces;
+}
+
+// a piece's bytes are contiguous in either buffer, so data(source, start_)
+// can be read for length_ bytes
+const char* PieceTable::data(Source source, size_t offset) const {
+    return source == Original ? original_.data() + offset : added_.at(offset);
+}
+
+size_t PieceTable::bufferSize(Source source) const {
+    return source == Original ? original_.size() : added_.size();
+}
+
+const AppendVector<size_t>& PieceTable::lineStarts(Source source) const {
+    return source == Original ? originalLineStarts_ : addedLineStarts_;
+}
+
+size_t PieceTable::countLineFeeds(Source source, size_t start, size_t length) const {
+    auto& starts = lineStarts(source);
+    auto first = starts.upperBound(start);
+
+    return starts.upperBound(start + length, first) - first;
+}
+
+// offset, relative to the piece, just past its k-th line feed (k >= 1)
+size_t PieceTable::lineFeedEnd(const Piece& piece, size_t k) const {
+    auto& starts = lineStarts(piece.source_);
+
+    return starts[starts.upperBound(piece.start_) + k - 1] - piece.start_;
+}
+
+// line starts are stored as the offset just past each '\n'
+void PieceTable::appendLineStarts(std::vector<size_t>& starts, std::string_view buffer, size_t from) {
+    TextScan::lineStarts(buffer.data() + from, buffer.size() - from, from, starts);
+}
+
+bool PieceTable::wordAt(Source source, size_t offset) const {
+    return !TextScan::space(*data(source, offset));
+}
+
+// code points and word starts in the first offset bytes of source
+void PieceTable::countBefore(Source source, size_t offset, size_t& chars, size_t& words) const {
+    auto& counts = source == Original ? originalCounts_ : addedCounts_;
+    auto block = offset / countBlock_;
+    auto begin = block * countBlock_;
+    chars = counts.chars_[block];
+    words = counts.words_[block];
+    TextScan::stats(data(source, begin), offset - begin, begin == 0 || TextScan::space(*data(source, begin - 1)), chars, words);
+}
+
+// a piece counts a word it starts in the middle of as well; short pieces are
+// cheaper to scan than to look up
+void PieceTable::count(Piece& piece) const {
+    piece.head_ = wordAt(piece.source_, piece.start_);
+    piece.tail_ = wordAt(piece.source_, piece.start_ + piece.length_ - 1);
+    piece.chars_ = piece.words_ = 0;
+    if (piece.length_ <= countBlock_) {
+        TextScan::stats(data(piece.source_, piece.start_), piece.length_, true, piece.chars_, piece.words_);
+        return ;
+    }
+
+    size_t charsBegin, wordsBegin, charsEnd, wordsEnd;
+    countBefore(piece.source_, piece.start_, charsBegin, wordsBegin);
+    countBefore(piece.source_, piece.start_ + piece.length_, charsEnd, wordsEnd);
+    piece.chars_ = charsEnd - charsBegin;
+    piece.words_ = wordsEnd - wordsBegin;
+    if (piece.start_ > 0 && piece.head_ && wordAt(piece.source_, piece.start_ - 1)) {
+        piece.words_++;
+    }
+}
+
+// next starts where piece ends in the same buffer
+void PieceTable::join(Piece& piece, const Piece& next) const {
+    piece.length_ += next.length_;
+    piece.lineFeeds_ += next.lineFeeds_;
+    piece.chars_ += next.chars_;
+    piece.words_ += next.words_;
+    piece.words_ -= piece.tail_ && next.head_;
+    piece.tail_ = next.tail_;
+}
+
+// extends the block counts to every whole block of the buffer. The bytes from
+// gapBegin to gapEnd, the end of a chunk this table stopped writing, count as
+// the padding they are to it unread: the table it was copied from may be
+// writing there
+void PieceTable::appendCounts(Source source, size_t gapBegin, size_t gapEnd) {
+    auto& counts = source == Original ? originalCounts_ : addedCounts_;
+    // a block never crosses a chunk of the added buffer
+    for (auto begin = (counts.chars_.size() - 1) * countBlock_; begin + countBlock_ <= bufferSize(source); begin += countBlock_) {
+        auto chars = counts.chars_.back();
+        auto words = counts.words_.back();
+        auto read = countBlock_;
+        if (gapBegin < gapEnd && begin < gapEnd && begin + countBlock_ > gapBegin) {
+            read = begin < gapBegin ? gapBegin - begin : 0;
+        }
+        if (read > 0) {
+            TextScan::stats(data(source, begin), read, begin == 0 || TextScan::space(*data(source, begin - 1)), chars, words);
+        }
+        chars += countBlock_ - read;
+        counts.chars_.push_back(chars);
+        counts.words_.push_back(words);
+    }
+}
\ No newline at end of file
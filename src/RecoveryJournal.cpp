@@ -0,0 +1,305 @@
+#include "RecoveryJournal.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr char magic[8] = {'E', 'D', 'J', 'R', 'N', 'L', '0', '1'};
+constexpr size_t fingerprintBytes = 64 << 10;
+
+uint64_t fnv1a(uint64_t hash, const void* data, size_t size) {
+    auto bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+
+    return hash;
+}
+
+}
+
+RecoveryJournal::RecoveryJournal(const std::string& path, const Fingerprint& base, uint32_t intervalMs) : path_(path), intervalMs_(intervalMs) {
+    // find where the valid records of an existing log end
+    {
+        MappedFile existing(path_);
+        Header header;
+        if (existing.valid() && existing.size() >= sizeof(Header)) {
+            memcpy(&header, existing.data(), sizeof(Header));
+        }
+
+        if (existing.valid() && existing.size() >= sizeof(Header) && memcmp(header.magic_, magic, sizeof(magic)) == 0 && header.base_ == base) {
+            used_ = sizeof(Header);
+            while (used_ + sizeof(Record) <= existing.size()) {
+                Record record;
+                memcpy(&record, existing.data() + used_, sizeof(Record));
+                auto end = used_ + sizeof(Record) + record.insert_;
+                if (end > existing.size() || checksum(record, {existing.data() + used_ + sizeof(Record), record.insert_}) != record.checksum_) {
+                    // a torn tail from a crash mid-append
+                    break;
+                }
+                used_ = end;
+            }
+        }
+    }
+
+#ifdef _WIN32
+    file_ = std::fopen(path_.c_str(), used_ > 0 ? "r+b" : "w+b");
+    if (file_ != nullptr) {
+        _chsize_s(_fileno(file_), used_);
+    }
+#else
+    fd_ = open(path_.c_str(), O_RDWR | O_CREAT, 0600);
+    if (fd_ >= 0) {
+        // anything past the last valid record must not survive as stale records
+        if (ftruncate(fd_, used_) != 0) {
+            used_ = 0;
+        }
+        reserve(std::max<size_t>(used_, 1 << 20));
+    }
+#endif
+
+    if (used_ == 0) {
+        reset(base);
+    }
+
+    flusher_ = std::thread([this]() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_) {
+            cond_.wait_for(lock, std::chrono::milliseconds(intervalMs_));
+            if (dirty_.exchange(false)) {
+                lock.unlock();
+                flush();
+                lock.lock();
+            }
+        }
+    });
+}
+
+RecoveryJournal::~RecoveryJournal() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cond_.notify_all();
+    flusher_.join();
+
+    // nothing unsaved, nothing to recover; a log that was never opened is
+    // not ours to remove
+    auto empty = valid() && used_ <= sizeof(Header);
+    flush();
+
+#ifdef _WIN32
+    if (file_ != nullptr) {
+        std::fclose(file_);
+    }
+#else
+    if (data_ != nullptr) {
+        munmap(data_, capacity_);
+    }
+    if (fd_ >= 0) {
+        ftruncate(fd_, used_);
+        close(fd_);
+    }
+#endif
+
+    if (empty) {
+        std::remove(path_.c_str());
+    }
+}
+
+bool RecoveryJournal::valid() const {
+#ifdef _WIN32
+    return file_ != nullptr;
+#else
+    return data_ != nullptr;
+#endif
+}
+
+size_t RecoveryJournal::replay(PieceTable& document) {
+    MappedFile log(path_);
+    if (!log.valid() || log.size() < used_) {
+        return 0;
+    }
+
+    size_t count = 0;
+    for (auto at = sizeof(Header); at < used_; count++) {
+        Record record;
+        memcpy(&record, log.data() + at, sizeof(Record));
+        at += sizeof(Record);
+
+        document.erase(record.offset_, record.erase_);
+        document.insert(record.offset_, {log.data() + at, record.insert_});
+        at += record.insert_;
+    }
+
+    return count;
+}
+
+void RecoveryJournal::append(size_t offset, size_t erase, std::string_view insert) {
+    constexpr size_t limit = std::numeric_limits<uint32_t>::max();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!valid()) {
+        return ;
+    }
+    do {
+        Record record{};
+        record.erase_ = static_cast<uint32_t>(std::min(erase, limit));
+        record.insert_ = static_cast<uint32_t>(std::min(insert.size(), limit));
+        record.offset_ = offset;
+        auto bytes = insert.substr(0, record.insert_);
+        record.checksum_ = checksum(record, bytes);
+
+        // only bytes that made it into the log are counted
+        if (!write(used_, &record, sizeof(Record)) || !write(used_ + sizeof(Record), bytes.data(), bytes.size())) {
+            return ;
+        }
+        used_ += sizeof(Record) + bytes.size();
+
+        erase -= record.erase_;
+        offset += record.insert_;
+        insert.remove_prefix(record.insert_);
+    } while (erase > 0 || !insert.empty());
+
+    dirty_ = true;
+}
+
+size_t RecoveryJournal::position() const {
+    return used_;
+}
+
+// the document was saved as of `position`: later records move up behind a new
+// header describing the saved file
+void RecoveryJournal::rebase(size_t position, const Fingerprint& base) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!valid()) {
+        return ;
+    }
+
+    position = std::clamp(position, sizeof(Header), used_);
+    auto tail = used_ - position;
+    auto end = sizeof(Header) + tail;
+
+#ifdef _WIN32
+    std::string bytes(tail, '\0');
+    std::fseek(file_, static_cast<long>(position), SEEK_SET);
+    std::fread(bytes.data(), 1, tail, file_);
+    write(sizeof(Header), bytes.data(), bytes.size());
+    std::fflush(file_);
+    _chsize_s(_fileno(file_), end);
+#else
+    memmove(data_ + sizeof(Header), data_ + position, tail);
+    memset(data_ + end, 0, used_ - end);
+#endif
+
+    used_ = end;
+    Header header;
+    memcpy(header.magic_, magic, sizeof(magic));
+    header.base_ = base;
+    write(0, &header, sizeof(Header));
+    dirty_ = true;
+}
+
+RecoveryJournal::Fingerprint RecoveryJournal::fingerprint(const std::string& path, std::string_view contents) {
+    Fingerprint result;
+    result.size_ = contents.size();
+
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0) {
+        result.mtime_ = static_cast<int64_t>(st.st_mtime);
+    }
+
+    auto head = contents.substr(0, fingerprintBytes);
+    auto tail = contents.substr(contents.size() - std::min(contents.size(), fingerprintBytes));
+    result.hash_ = fnv1a(fnv1a(14695981039346656037ull, head.data(), head.size()), tail.data(), tail.size());
+
+    return result;
+}
+
+void RecoveryJournal::reset(const Fingerprint& base) {
+    Header header;
+    memcpy(header.magic_, magic, sizeof(magic));
+    header.base_ = base;
+
+    used_ = write(0, &header, sizeof(Header)) ? sizeof(Header) : 0;
+}
+
+bool RecoveryJournal::write(size_t at, const void* data, size_t size) {
+#ifdef _WIN32
+    if (file_ == nullptr || std::fseek(file_, static_cast<long>(at), SEEK_SET) != 0) {
+        return false;
+    }
+    return std::fwrite(data, 1, size, file_) == size;
+#else
+    reserve(at + size);
+    if (data_ == nullptr) {
+        return false;
+    }
+    memcpy(data_ + at, data, size);
+    return true;
+#endif
+}
+
+void RecoveryJournal::reserve(size_t size) {
+#ifndef _WIN32
+    if (fd_ < 0 || size <= capacity_) {
+        return ;
+    }
+
+    auto capacity = std::max<size_t>(capacity_, 1 << 20);
+    while (capacity < size) {
+        capacity *= 2;
+    }
+
+    if (data_ != nullptr) {
+        munmap(data_, capacity_);
+        data_ = nullptr;
+    }
+    if (ftruncate(fd_, capacity) != 0) {
+        capacity_ = 0;
+        return ;
+    }
+
+    auto data = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (data == MAP_FAILED) {
+        capacity_ = 0;
+        return ;
+    }
+    data_ = static_cast<char*>(data);
+    capacity_ = capacity;
+#endif
+}
+
+void RecoveryJournal::flush() {
+#ifdef _WIN32
+    if (file_ != nullptr) {
+        std::fflush(file_);
+        _commit(_fileno(file_));
+    }
+#else
+    // also writes back the pages dirtied through the mapping
+    if (fd_ >= 0) {
+        fdatasync(fd_);
+    }
+#endif
+}
+
+uint32_t RecoveryJournal::checksum(const Record& record, std::string_view bytes) {
+    auto hash = fnv1a(14695981039346656037ull, &record.erase_, sizeof(uint32_t) * 3 + sizeof(uint64_t));
+    hash = fnv1a(hash, bytes.data(), bytes.size());
+
+    return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
\ No newline at end of file
@@ -0,0 +1,661 @@
+#include "Regex.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// DFA states kept per direction before the cache starts over
+constexpr size_t maxStates = 4096;
+constexpr int32_t unknown = -1;
+constexpr int32_t dead = 0;
+// first element of the key of a state entered at the start of a line
+constexpr int32_t beginMark = -2;
+
+std::bitset<256> range(unsigned char first, unsigned char last) {
+    std::bitset<256> set;
+    for (auto c = static_cast<size_t>(first); c <= last; c++) {
+        set.set(c);
+    }
+
+    return set;
+}
+
+std::bitset<256> word() {
+    auto set = range('a', 'z') | range('A', 'Z') | range('0', '9');
+    set.set('_');
+
+    return set;
+}
+
+std::bitset<256> space() {
+    std::bitset<256> set;
+    for (auto c : {' ', '\t', '\r', '\v', '\f'}) {
+        set.set(static_cast<unsigned char>(c));
+    }
+
+    return set;
+}
+
+}
+
+Regex::Regex(std::string_view pattern) : pattern_(pattern) {
+    if (pattern_.empty()) {
+        error_ = "empty pattern";
+        return ;
+    }
+
+    auto ast = parseAlt();
+    if (error_.empty() && pos_ < pattern_.size()) {
+        error_ = "unmatched )";
+    }
+    if (!error_.empty()) {
+        return ;
+    }
+
+    classify();
+    findLiteral(*ast);
+
+    auto match = addNode(Node::Match);
+    forward_ = compile(*ast, match, false);
+
+    auto any = addSet(std::bitset<256>().set());
+    search_ = addNode(Node::Split, -1, forward_);
+    nodes_[search_].out_ = addNode(Node::Set, search_, -1, any);
+
+    reverse_ = addNode(Node::Split, -1, compile(*ast, match, true));
+    nodes_[reverse_].out_ = addNode(Node::Set, reverse_, -1, any);
+}
+
+bool Regex::valid() const {
+    return error_.empty();
+}
+
+const std::string& Regex::error() const {
+    return error_;
+}
+
+std::unique_ptr<Regex::Ast> Regex::parseAlt() {
+    auto left = parseConcat();
+    while (error_.empty() && pos_ < pattern_.size() && pattern_[pos_] == '|') {
+        pos_++;
+        auto alt = std::make_unique<Ast>();
+        alt->kind_ = Ast::Alt;
+        alt->children_.push_back(std::move(left));
+        alt->children_.push_back(parseConcat());
+        left = std::move(alt);
+    }
+
+    return left;
+}
+
+std::unique_ptr<Regex::Ast> Regex::parseConcat() {
+    auto concat = std::make_unique<Ast>();
+    concat->kind_ = Ast::Concat;
+    while (error_.empty() && pos_ < pattern_.size() && pattern_[pos_] != '|' && pattern_[pos_] != ')') {
+        concat->children_.push_back(parseRepeat());
+    }
+
+    return concat;
+}
+
+std::unique_ptr<Regex::Ast> Regex::parseRepeat() {
+    auto atom = parseAtom();
+    while (error_.empty() && pos_ < pattern_.size()) {
+        auto c = pattern_[pos_];
+        auto kind = c == '*' ? Ast::Star : c == '+' ? Ast::Plus : c == '?' ? Ast::Quest : Ast::Empty;
+        if (kind == Ast::Empty) {
+            break;
+        }
+        pos_++;
+
+        auto repeat = std::make_unique<Ast>();
+        repeat->kind_ = kind;
+        repeat->children_.push_back(std::move(atom));
+        atom = std::move(repeat);
+    }
+
+    return atom;
+}
+
+std::unique_ptr<Regex::Ast> Regex::parseAtom() {
+    auto atom = std::make_unique<Ast>();
+    auto c = pattern_[pos_++];
+    switch (c) {
+    case '(':
+        atom = parseAlt();
+        if (error_.empty() && (pos_ >= pattern_.size() || pattern_[pos_] != ')')) {
+            error_ = "missing )";
+        }
+        pos_++;
+        break;
+    case '[':
+        atom = parseClass();
+        break;
+    case '.':
+        atom->kind_ = Ast::Set;
+        atom->set_ = addSet(~std::bitset<256>().set('\n'));
+        break;
+    case '^':
+        atom->kind_ = Ast::Begin;
+        break;
+    case '$':
+        atom->kind_ = Ast::End;
+        break;
+    case '*':
+    case '+':
+    case '?':
+        error_ = std::string("nothing to repeat before ") + c;
+        break;
+    case '\\': {
+        std::bitset<256> set;
+        if (parseEscape(set)) {
+            atom->kind_ = Ast::Set;
+            atom->set_ = addSet(set);
+        }
+        break;
+    }
+    default:
+        atom->kind_ = Ast::Set;
+        atom->set_ = addSet(std::bitset<256>().set(static_cast<unsigned char>(c)));
+        break;
+    }
+
+    return atom;
+}
+
+// after the [
+std::unique_ptr<Regex::Ast> Regex::parseClass() {
+    std::bitset<256> set;
+    auto negate = pos_ < pattern_.size() && pattern_[pos_] == '^';
+    if (negate) {
+        pos_++;
+    }
+
+    for (auto first = true; ; first = false) {
+        if (pos_ >= pattern_.size()) {
+            error_ = "missing ]";
+            return std::make_unique<Ast>();
+        }
+
+        auto c = static_cast<unsigned char>(pattern_[pos_++]);
+        if (c == ']' && !first) {
+            break;
+        }
+        if (c == '\\') {
+            if (!parseEscape(set)) {
+                return std::make_unique<Ast>();
+            }
+            continue;
+        }
+
+        if (pos_ + 1 < pattern_.size() && pattern_[pos_] == '-' && pattern_[pos_ + 1] != ']') {
+            auto last = static_cast<unsigned char>(pattern_[pos_ + 1]);
+            pos_ += 2;
+            if (last < c) {
+                error_ = "bad range in []";
+                return std::make_unique<Ast>();
+            }
+            set |= range(c, last);
+        } else {
+            set.set(c);
+        }
+    }
+
+    if (negate) {
+        set = ~set;
+        set.reset('\n');
+    }
+
+    auto atom = std::make_unique<Ast>();
+    atom->kind_ = Ast::Set;
+    atom->set_ = addSet(set);
+
+    return atom;
+}
+
+// after the backslash; adds what it stands for to set
+bool Regex::parseEscape(std::bitset<256>& set) {
+    if (pos_ >= pattern_.size()) {
+        error_ = "trailing \\";
+        return false;
+    }
+
+    auto c = pattern_[pos_++];
+    switch (c) {
+    case 'd': set |= range('0', '9'); break;
+    case 'D': set |= ~range('0', '9'); break;
+    case 'w': set |= word(); break;
+    case 'W': set |= ~word(); break;
+    case 's': set |= space(); break;
+    case 'S': set |= ~space(); break;
+    case 't': set.set('\t'); break;
+    default: set.set(static_cast<unsigned char>(c)); break;
+    }
+    set.reset('\n');
+
+    return true;
+}
+
+int32_t Regex::addSet(const std::bitset<256>& set) {
+    sets_.push_back(set);
+
+    return static_cast<int32_t>(sets_.size() - 1);
+}
+
+int32_t Regex::addNode(Node::Kind kind, int32_t out, int32_t out1, int32_t set) {
+    Node node;
+    node.kind_ = kind;
+    node.out_ = out;
+    node.out1_ = out1;
+    node.set_ = set;
+    nodes_.push_back(node);
+
+    return static_cast<int32_t>(nodes_.size() - 1);
+}
+
+// Thompson construction back to front: returns the entry of ast, which
+// continues to next. The reversed automaton matches the mirrored strings.
+int32_t Regex::compile(const Ast& ast, int32_t next, bool reverse) {
+    switch (ast.kind_) {
+    case Ast::Empty:
+        return next;
+    case Ast::Set:
+        return addNode(Node::Set, next, -1, ast.set_);
+    case Ast::Begin:
+        return addNode(reverse ? Node::End : Node::Begin, next);
+    case Ast::End:
+        return addNode(reverse ? Node::Begin : Node::End, next);
+    case Ast::Concat:
+        if (reverse) {
+            for (auto& child : ast.children_) {
+                next = compile(*child, next, reverse);
+            }
+        } else {
+            for (auto it = ast.children_.rbegin(); it != ast.children_.rend(); ++it) {
+                next = compile(**it, next, reverse);
+            }
+        }
+        return next;
+    case Ast::Alt: {
+        auto left = compile(*ast.children_[0], next, reverse);
+        auto right = compile(*ast.children_[1], next, reverse);
+        return addNode(Node::Split, left, right);
+    }
+    case Ast::Quest: {
+        auto body = compile(*ast.children_[0], next, reverse);
+        return addNode(Node::Split, body, next);
+    }
+    case Ast::Star:
+    case Ast::Plus: {
+        auto split = addNode(Node::Split, -1, next);
+        auto body = compile(*ast.children_[0], split, reverse);
+        nodes_[split].out_ = body;
+        return ast.kind_ == Ast::Star ? split : body;
+    }
+    }
+
+    return next;
+}
+
+void Regex::classify() {
+    classOf_.fill(0);
+    classes_ = 1;
+    for (auto& set : sets_) {
+        // split every class into its bytes inside and outside the set
+        std::array<int32_t, 512> renamed;
+        renamed.fill(-1);
+        size_t count = 0;
+        for (size_t c = 0; c < 256; c++) {
+            auto& id = renamed[classOf_[c] * 2 + set[c]];
+            if (id < 0) {
+                id = static_cast<int32_t>(count++);
+            }
+            classOf_[c] = static_cast<uint8_t>(id);
+        }
+        classes_ = count;
+    }
+}
+
+// the longest run of single bytes at the top level of the pattern
+void Regex::findLiteral(const Ast& ast) {
+    if (ast.kind_ != Ast::Concat) {
+        return ;
+    }
+
+    std::string run;
+    for (auto& child : ast.children_) {
+        if (child->kind_ == Ast::Set && sets_[child->set_].count() == 1) {
+            for (size_t c = 0; c < 256; c++) {
+                if (sets_[child->set_][c]) {
+                    run.push_back(static_cast<char>(c));
+                }
+            }
+        } else {
+            run.clear();
+        }
+
+        if (run.size() > literal_.size()) {
+            literal_ = run;
+        }
+    }
+}
+
+Regex::Matcher::Matcher(const Regex& regex) : regex_(regex) {
+    search_.entry_ = regex_.search_;
+    forward_.entry_ = regex_.forward_;
+    reverse_.entry_ = regex_.reverse_;
+    reset(search_);
+    reset(forward_);
+    reset(reverse_);
+    seen_.assign(regex_.nodes_.size(), 0);
+}
+
+bool Regex::Matcher::find(std::string_view line, size_t from, size_t& begin, size_t& end) {
+    if (!regex_.valid()) {
+        return false;
+    }
+
+    starts(line);
+    for (auto i = from; i <= line.size(); i++) {
+        if (starts_[i]) {
+            begin = i;
+            end = longest(line, i);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+size_t Regex::Matcher::replace(std::string_view text, std::string_view replacement, std::string& out, size_t& first, size_t& last) {
+    size_t count = 0;
+    first = last = 0;
+    if (!regex_.valid()) {
+        return 0;
+    }
+
+    std::function<void(size_t, size_t)> emit = [&](size_t begin, size_t end) {
+        if (count++ == 0) {
+            // the output is about as long as the rest of the text
+            first = begin;
+            out.reserve(out.size() + text.size() - begin);
+        } else {
+            out.append(text.substr(last, begin - last));
+        }
+
+        for (size_t i = 0; i < replacement.size(); i++) {
+            if (replacement[i] == '&') {
+                out.append(text.substr(begin, end - begin));
+            } else if (replacement[i] == '\\' && i + 1 < replacement.size()) {
+                out.push_back(replacement[++i]);
+            } else {
+                out.push_back(replacement[i]);
+            }
+        }
+        last = end;
+    };
+
+    // lines end at line feeds; nothing follows a trailing one
+    auto scan = [&](size_t lineBegin, size_t lineEnd) {
+        auto line = text.substr(lineBegin, lineEnd - lineBegin);
+        if (matches(line)) {
+            matchLine(line, lineBegin, emit);
+        }
+    };
+
+    if (!regex_.literal_.empty()) {
+        // only lines holding the literal can match
+        for (size_t at = text.find(regex_.literal_); at != std::string_view::npos; at = text.find(regex_.literal_, at)) {
+            auto lineBegin = at;
+            while (lineBegin > 0 && text[lineBegin - 1] != '\n') {
+                lineBegin--;
+            }
+            auto lf = static_cast<const char*>(memchr(text.data() + at, '\n', text.size() - at));
+            at = lf == nullptr ? text.size() : lf - text.data();
+            scan(lineBegin, at);
+        }
+
+        return count;
+    }
+
+    // nothing follows a trailing line feed
+    for (size_t lineBegin = 0; ; ) {
+        auto lf = static_cast<const char*>(memchr(text.data() + lineBegin, '\n', text.size() - lineBegin));
+        auto lineEnd = lf == nullptr ? text.size() : lf - text.data();
+        scan(lineBegin, lineEnd);
+
+        if (lineEnd + 1 >= text.size()) {
+            break;
+        }
+        lineBegin = lineEnd + 1;
+    }
+
+    return count;
+}
+
+// whether the line has a match anywhere, by the unanchored DFA
+bool Regex::Matcher::matches(std::string_view line) {
+    auto s = start(search_, true);
+    for (size_t i = 0; ; i++) {
+        {
+            // table lookups until a match or a transition not built yet
+            auto table = search_.next_.data();
+            auto accept = search_.accept_.data();
+            auto classOf = regex_.classOf_.data();
+            while (i < line.size() && !accept[s]) {
+                auto to = table[s + classOf[static_cast<unsigned char>(line[i])]];
+                if (to == unknown) {
+                    break;
+                }
+                s = to;
+                i++;
+            }
+        }
+
+        if (i == line.size()) {
+            return search_.acceptAtEnd_[s];
+        }
+        if (search_.accept_[s]) {
+            return true;
+        }
+        s = step(search_, s, static_cast<unsigned char>(line[i]));
+    }
+}
+
+void Regex::Matcher::matchLine(std::string_view line, size_t lineBegin, const std::function<void(size_t, size_t)>& emit) {
+    starts(line);
+    // an empty match right after a non-empty one does not count
+    auto previous = std::string_view::npos;
+    for (size_t i = 0; i <= line.size(); ) {
+        if (!starts_[i]) {
+            i++;
+            continue;
+        }
+
+        auto end = longest(line, i);
+        if (end == i && i == previous) {
+            i++;
+            continue;
+        }
+
+        emit(lineBegin + i, lineBegin + end);
+        if (end > i) {
+            previous = i = end;
+        } else {
+            i++;
+        }
+    }
+}
+
+void Regex::Matcher::reset(Dfa& dfa) {
+    dfa.sets_.clear();
+    dfa.ids_.clear();
+    dfa.next_.clear();
+    dfa.accept_.clear();
+    dfa.acceptAtEnd_.clear();
+    dfa.start_ = {unknown, unknown};
+
+    // state 0 is dead: it has no threads and loops to itself
+    dfa.sets_.emplace_back();
+    dfa.next_.assign(regex_.classes_, dead);
+    dfa.accept_.assign(regex_.classes_, 0);
+    dfa.acceptAtEnd_.assign(regex_.classes_, 0);
+}
+
+// the state for a closed set of nodes; only Set, End and Match nodes are kept.
+// A state is the offset of its row in next_, saving a multiply per byte
+int32_t Regex::Matcher::state(Dfa& dfa, std::vector<int32_t>& set, bool atBegin) {
+    if (set.empty()) {
+        return dead;
+    }
+
+    std::sort(set.begin(), set.end());
+    if (atBegin) {
+        set.insert(set.begin(), beginMark);
+    }
+
+    auto it = dfa.ids_.find(set);
+    if (it != dfa.ids_.end()) {
+        return it->second;
+    }
+
+    auto id = static_cast<int32_t>(dfa.next_.size());
+    auto accept = false;
+    for (auto node : set) {
+        accept |= node >= 0 && regex_.nodes_[node].kind_ == Node::Match;
+    }
+
+    // reaching the end of the line lets End nodes through
+    std::vector<int32_t> end;
+    for (auto node : set) {
+        if (node >= 0 && regex_.nodes_[node].kind_ == Node::End) {
+            end.push_back(regex_.nodes_[node].out_);
+        }
+    }
+    closure(end, atBegin, true);
+    auto acceptAtEnd = accept || std::any_of(end.begin(), end.end(), [&](int32_t node) {
+        return regex_.nodes_[node].kind_ == Node::Match;
+    });
+
+    dfa.ids_.emplace(set, id);
+    dfa.sets_.push_back(std::move(set));
+    dfa.next_.resize(dfa.next_.size() + regex_.classes_, unknown);
+    dfa.accept_.resize(dfa.next_.size(), 0);
+    dfa.acceptAtEnd_.resize(dfa.next_.size(), 0);
+    dfa.accept_[id] = accept;
+    dfa.acceptAtEnd_[id] = acceptAtEnd;
+
+    return id;
+}
+
+int32_t Regex::Matcher::start(Dfa& dfa, bool atBegin) {
+    auto& id = dfa.start_[atBegin];
+    if (id == unknown) {
+        std::vector<int32_t> set = {dfa.entry_};
+        closure(set, atBegin, false);
+        id = state(dfa, set, atBegin);
+    }
+
+    return id;
+}
+
+int32_t Regex::Matcher::next(Dfa& dfa, int32_t from, unsigned char c) {
+    auto to = dfa.next_[from + regex_.classOf_[c]];
+
+    return to != unknown ? to : step(dfa, from, c);
+}
+
+// builds the transition next() did not find
+int32_t Regex::Matcher::step(Dfa& dfa, int32_t from, unsigned char c) {
+    std::vector<int32_t> set;
+    for (auto node : dfa.sets_[from / regex_.classes_]) {
+        if (node >= 0 && regex_.nodes_[node].kind_ == Node::Set && regex_.sets_[regex_.nodes_[node].set_][c]) {
+            set.push_back(regex_.nodes_[node].out_);
+        }
+    }
+    closure(set, false, false);
+
+    if (dfa.sets_.size() >= maxStates) {
+        // start over rather than grow without bound; from and known are gone
+        reset(dfa);
+        return state(dfa, set, false);
+    }
+
+    auto to = state(dfa, set, false);
+    dfa.next_[from + regex_.classOf_[c]] = to;
+
+    return to;
+}
+
+// replaces set by the Set, End and Match nodes reachable from it without input
+void Regex::Matcher::closure(std::vector<int32_t>& set, bool atBegin, bool atEnd) {
+    stack_.assign(set.begin(), set.end());
+    set.clear();
+    std::fill(seen_.begin(), seen_.end(), 0);
+
+    while (!stack_.empty()) {
+        auto node = stack_.back();
+        stack_.pop_back();
+        if (node < 0 || seen_[node]) {
+            continue;
+        }
+        seen_[node] = 1;
+
+        auto& n = regex_.nodes_[node];
+        switch (n.kind_) {
+        case Node::Split:
+            stack_.push_back(n.out1_);
+            stack_.push_back(n.out_);
+            break;
+        case Node::Begin:
+            if (atBegin) {
+                stack_.push_back(n.out_);
+            }
+            break;
+        case Node::End:
+            if (atEnd) {
+                stack_.push_back(n.out_);
+            } else {
+                set.push_back(node);
+            }
+            break;
+        default:
+            set.push_back(node);
+            break;
+        }
+    }
+}
+
+// runs the reversed pattern from the end of the line back to its start
+void Regex::Matcher::starts(std::string_view line) {
+    starts_.assign(line.size() + 1, 0);
+
+    auto s = start(reverse_, true);
+    for (auto i = line.size(); ; i--) {
+        starts_[i] = i == 0 ? reverse_.acceptAtEnd_[s] : reverse_.accept_[s];
+        if (i == 0) {
+            break;
+        }
+
+        auto to = reverse_.next_[s + regex_.classOf_[static_cast<unsigned char>(line[i - 1])]];
+        s = to != unknown ? to : step(reverse_, s, static_cast<unsigned char>(line[i - 1]));
+    }
+}
+
+// end of the longest match beginning at begin, which must be a match start
+size_t Regex::Matcher::longest(std::string_view line, size_t begin) {
+    auto s = start(forward_, begin == 0);
+    auto end = begin;
+    for (auto i = begin; ; i++) {
+        if (i == line.size() ? forward_.acceptAtEnd_[s] : forward_.accept_[s]) {
+            end = i;
+        }
+        if (i == line.size() || s == dead) {
+            break;
+        }
+        s = next(forward_, s, static_cast<unsigned char>(line[i]));
+    }
+
+    return end;
+}
\ No newline at end of file
@@ -0,0 +1,296 @@
+#include "SaveEngine.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// pieces below this size are copied into a staging buffer so that a document
+// fragmented by typing is still written in large blocks
+constexpr size_t smallPiece = 4096;
+constexpr size_t stagingSize = 1 << 20;
+
+// hands emit the byte order mark and then the text in the file's encoding;
+// transient data is an encoded chunk whose buffer is reused once emit returns
+template <typename Emit>
+bool encode(const std::vector<std::string_view>& pieces, Transcode::Format format, Emit emit) {
+    if (!emit(Transcode::bom(format), false)) {
+        return false;
+    }
+
+    if (format.encoding_ == Transcode::Utf8) {
+        for (auto piece : pieces) {
+            if (!emit(piece, false)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    Transcode::Stream stream(Transcode::Utf8, format.encoding_);
+    std::string chunk;
+    for (auto piece : pieces) {
+        for (size_t offset = 0; offset < piece.size(); offset += stagingSize) {
+            stream.convert(piece.substr(offset, stagingSize), chunk);
+            if (chunk.size() >= stagingSize) {
+                if (!emit(chunk, true)) {
+                    return false;
+                }
+                chunk.clear();
+            }
+        }
+    }
+    stream.finish(chunk);
+
+    return emit(chunk, true);
+}
+
+#ifdef _WIN32
+
+bool writeAll(HANDLE file, const char* data, size_t size) {
+    while (size > 0) {
+        DWORD written = 0;
+        auto chunk = static_cast<DWORD>(std::min<size_t>(size, 1u << 30));
+        if (!WriteFile(file, data, chunk, &written, nullptr)) {
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+
+    return true;
+}
+
+bool writeFile(const std::vector<std::string_view>& pieces, const std::string& tmp, Transcode::Format format) {
+    auto file = CreateFileA(tmp.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    std::string staging;
+    staging.reserve(stagingSize);
+    // transient chunks need no care here, they are written or copied at once
+    auto ok = encode(pieces, format, [&](std::string_view piece, bool) {
+        if (staging.size() + piece.size() > stagingSize) {
+            if (!writeAll(file, staging.data(), staging.size())) {
+                return false;
+            }
+            staging.clear();
+        }
+        if (piece.size() >= smallPiece) {
+            return writeAll(file, piece.data(), piece.size());
+        }
+        staging.append(piece);
+        return true;
+    });
+    ok = ok && writeAll(file, staging.data(), staging.size());
+    ok = ok && FlushFileBuffers(file);
+    CloseHandle(file);
+
+    return ok;
+}
+
+bool replace(const std::string& tmp, const std::string& path) {
+    return MoveFileExA(tmp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+}
+
+#else
+
+class GatherWriter {
+public:
+    GatherWriter(int fd) : fd_(fd) {
+        staging_.reserve(stagingSize);
+    }
+
+    bool add(std::string_view piece) {
+        if (piece.empty()) {
+            return true;
+        }
+
+        if (piece.size() < smallPiece) {
+            if (staging_.size() + piece.size() > staging_.capacity() && !flush()) {
+                return false;
+            }
+
+            // runs of small pieces become one iovec over the staging buffer
+            auto begin = staging_.data() + staging_.size();
+            staging_.append(piece);
+            if (!iov_.empty() && static_cast<char*>(iov_.back().iov_base) + iov_.back().iov_len == begin) {
+                iov_.back().iov_len += piece.size();
+                return true;
+            }
+            iov_.push_back({begin, piece.size()});
+        } else {
+            iov_.push_back({const_cast<char*>(piece.data()), piece.size()});
+        }
+
+        return iov_.size() < IOV_MAX || flush();
+    }
+
+    bool flush() {
+        size_t first = 0;
+        while (first < iov_.size()) {
+            auto count = static_cast<int>(std::min<size_t>(iov_.size() - first, IOV_MAX));
+            auto written = writev(fd_, iov_.data() + first, count);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+
+            // skip what went out, trimming a partially written iovec
+            auto n = static_cast<size_t>(written);
+            while (first < iov_.size() && n >= iov_[first].iov_len) {
+                n -= iov_[first].iov_len;
+                first++;
+            }
+            if (n > 0) {
+                iov_[first].iov_base = static_cast<char*>(iov_[first].iov_base) + n;
+                iov_[first].iov_len -= n;
+            }
+        }
+
+        iov_.clear();
+        staging_.clear();
+        return true;
+    }
+
+private:
+    int fd_;
+    std::vector<iovec> iov_;
+    std::string staging_;
+};
+
+bool writeFile(const std::vector<std::string_view>& pieces, const std::string& tmp, Transcode::Format format, mode_t mode) {
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, mode);
+    if (fd < 0) {
+        return false;
+    }
+
+    GatherWriter writer(fd);
+    auto ok = encode(pieces, format, [&](std::string_view piece, bool transient) {
+        return writer.add(piece) && (!transient || writer.flush());
+    });
+    ok = ok && writer.flush();
+    ok = ok && fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+
+    return ok;
+}
+
+bool replace(const std::string& tmp, const std::string& path) {
+    if (rename(tmp.c_str(), path.c_str()) != 0) {
+        return false;
+    }
+
+    // make the rename itself durable
+    auto slash = path.find_last_of('/');
+    auto dir = slash == std::string::npos ? std::string(".") : path.substr(0, std::max<size_t>(slash, 1));
+    int fd = open(dir.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+
+    return true;
+}
+
+#endif
+
+}
+
+SaveEngine::SaveEngine() : worker_(&SaveEngine::work, this) {
+
+}
+
+// pending saves are finished, not dropped
+SaveEngine::~SaveEngine() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cond_.notify_all();
+    worker_.join();
+}
+
+void SaveEngine::save(PieceTable snapshot, const std::string& path, Transcode::Format format, Callback callback) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.push_back({std::move(snapshot), path, format, std::move(callback)});
+    }
+    cond_.notify_one();
+}
+
+bool SaveEngine::busy() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return writing_ || !pending_.empty();
+}
+
+void SaveEngine::poll() {
+    std::deque<Job> done;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        done.swap(done_);
+    }
+
+    for (auto& job : done) {
+        if (job.callback_) {
+            job.callback_(job.ok_, job.path_);
+        }
+    }
+}
+
+bool SaveEngine::write(const std::vector<std::string_view>& pieces, const std::string& path, Transcode::Format format) {
+    auto tmp = path + ".tmp";
+
+#ifdef _WIN32
+    auto ok = writeFile(pieces, tmp, format);
+#else
+    struct stat st;
+    auto mode = stat(path.c_str(), &st) == 0 ? st.st_mode & 07777 : 0644;
+    auto ok = writeFile(pieces, tmp, format, mode);
+#endif
+
+    // the old file stays untouched until the new one is complete on disk
+    ok = ok && replace(tmp, path);
+    if (!ok) {
+        std::remove(tmp.c_str());
+    }
+
+    return ok;
+}
+
+void SaveEngine::work() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait(lock, [this]() { return stop_ || !pending_.empty(); });
+            if (pending_.empty()) {
+                return ;
+            }
+            job = std::move(pending_.front());
+            pending_.pop_front();
+            writing_ = true;
+        }
+
+        job.ok_ = write(job.snapshot_.pieces(), job.path_, job.format_);
+        job.snapshot_ = PieceTable();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        done_.push_back(std::move(job));
+        writing_ = false;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#include "Substitute.h"
+#include "Parallel.h"
+
+#include <algorithm>
+
+std::vector<Substitute::Span> Substitute::run(const PieceTable& document, const Regex& regex, std::string_view replacement, size_t threads) {
+    if (!regex.valid() || document.size() == 0) {
+        return {};
+    }
+
+    // chunk ends are line starts, so no match is cut in two
+    std::vector<size_t> bounds = {0};
+    for (auto at = chunkSize_; at < document.size(); at += chunkSize_) {
+        auto start = document.lineStart(document.lineOf(at));
+        if (start > bounds.back()) {
+            bounds.push_back(start);
+        }
+    }
+    bounds.push_back(document.size());
+
+    std::vector<Span> spans(bounds.size() - 1);
+    Parallel::forEach(spans.size(), threads, [&] {
+        return Regex::Matcher(regex);
+    }, [&](Regex::Matcher& matcher, size_t i) {
+        auto text = document.text(bounds[i], bounds[i + 1] - bounds[i]);
+
+        auto& span = spans[i];
+        size_t first, last;
+        span.count_ = matcher.replace(text, replacement, span.text_, first, last);
+        span.offset_ = bounds[i] + first;
+        span.length_ = last - first;
+    });
+
+    spans.erase(std::remove_if(spans.begin(), spans.end(), [](const Span& span) {
+        return span.count_ == 0;
+    }), spans.end());
+
+    return spans;
+}
\ No newline at end of file
@@ -0,0 +1,360 @@
+#include "TextScan.h"
+#include "Utf8.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#define TEXT_SCAN_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+#ifdef TEXT_SCAN_X86
+
+__attribute__((target("avx2")))
+size_t lineStartsAvx2(const char* data, size_t size, size_t base, std::vector<size_t>& starts) {
+    const auto lf = _mm256_set1_epi8('\n');
+    size_t i = 0;
+    for ( ; i + 32 <= size; i += 32) {
+        auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, lf)));
+        while (mask) {
+            starts.push_back(base + i + __builtin_ctz(mask) + 1);
+            mask &= mask - 1;
+        }
+    }
+
+    return i;
+}
+
+// candidates are positions where both the first and the last byte of the
+// needle line up, only those are compared in full
+__attribute__((target("avx2")))
+size_t findAvx2(const char* data, size_t size, std::string_view needle, size_t base, std::vector<size_t>& matches) {
+    auto n = needle.size();
+    const auto first = _mm256_set1_epi8(needle.front());
+    const auto last = _mm256_set1_epi8(needle.back());
+    size_t i = 0;
+    for ( ; i + n - 1 + 32 <= size; i += 32) {
+        auto head = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        auto tail = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + n - 1));
+        auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(head, first), _mm256_cmpeq_epi8(tail, last))));
+        while (mask) {
+            auto at = i + __builtin_ctz(mask);
+            if (n <= 2 || memcmp(data + at + 1, needle.data() + 1, n - 2) == 0) {
+                matches.push_back(base + at);
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    return i;
+}
+
+__attribute__((target("avx2")))
+size_t countAvx2(const char* data, size_t size, char c, size_t& result) {
+    const auto v = _mm256_set1_epi8(c);
+    size_t i = 0;
+    for ( ; i + 32 <= size; i += 32) {
+        auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        result += __builtin_popcount(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, v))));
+    }
+
+    return i;
+}
+
+// continuation bytes are 0x80..0xbf, below -65 as signed; whitespace is ' '
+// and '\t'..'\r'. A word starts at a non-space byte after a space byte
+__attribute__((target("avx2")))
+size_t statsAvx2(const char* data, size_t size, bool& afterSpace, size_t& chars, size_t& words) {
+    const auto lead = _mm256_set1_epi8(-65);
+    const auto space = _mm256_set1_epi8(' ');
+    const auto tab = _mm256_set1_epi8('\t');
+    const auto four = _mm256_set1_epi8(4);
+    uint32_t carry = afterSpace;
+    size_t i = 0;
+    for ( ; i + 32 <= size; i += 32) {
+        auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        chars += __builtin_popcount(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpgt_epi8(block, lead))));
+        auto control = _mm256_sub_epi8(block, tab);
+        auto blank = _mm256_or_si256(_mm256_cmpeq_epi8(block, space), _mm256_cmpeq_epi8(_mm256_min_epu8(control, four), control));
+        auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(blank));
+        words += __builtin_popcount(~mask & ((mask << 1) | carry));
+        carry = mask >> 31;
+    }
+    afterSpace = carry;
+
+    return i;
+}
+
+// Keiser and Lemire's lookup validation: three 16-entry tables indexed by
+// the high and low nibble of each byte and the high nibble of the next one
+// flag every malformed pair, and continuation counts are checked from the
+// leads two and three bytes back. All-ASCII blocks only check that no
+// sequence was cut off before them. Returns where the caller must resume:
+// every sequence ending before it is well-formed
+__attribute__((target("avx2")))
+size_t utf8Avx2(const char* data, size_t size) {
+    constexpr char tooShort = 1 << 0, tooLong = 1 << 1, overlong3 = 1 << 2, tooLarge = 1 << 3;
+    constexpr char surrogate = 1 << 4, overlong2 = 1 << 5, tooLarge1000 = 1 << 6, overlong4 = 1 << 6;
+    constexpr char twoConts = static_cast<char>(1 << 7), carry = tooShort | tooLong | twoConts;
+    const auto high1 = _mm256_setr_epi8(
+        tooLong, tooLong, tooLong, tooLong, tooLong, tooLong, tooLong, tooLong,
+        twoConts, twoConts, twoConts, twoConts,
+        tooShort | overlong2, tooShort, tooShort | overlong3 | surrogate, tooShort | tooLarge | tooLarge1000 | overlong4,
+        tooLong, tooLong, tooLong, tooLong, tooLong, tooLong, tooLong, tooLong,
+        twoConts, twoConts, twoConts, twoConts,
+        tooShort | overlong2, tooShort, tooShort | overlong3 | surrogate, tooShort | tooLarge | tooLarge1000 | overlong4);
+    constexpr char large = carry | tooLarge | tooLarge1000;
+    const auto low1 = _mm256_setr_epi8(
+        carry | overlong3 | overlong2 | overlong4, carry | overlong2, carry, carry,
+        carry | tooLarge, large, large, large, large, large, large, large, large, large | surrogate, large, large,
+        carry | overlong3 | overlong2 | overlong4, carry | overlong2, carry, carry,
+        carry | tooLarge, large, large, large, large, large, large, large, large, large | surrogate, large, large);
+    constexpr char cont8 = tooLong | overlong2 | twoConts | overlong3 | tooLarge1000 | overlong4;
+    constexpr char cont9 = tooLong | overlong2 | twoConts | overlong3 | tooLarge;
+    constexpr char contA = tooLong | overlong2 | twoConts | surrogate | tooLarge;
+    const auto high2 = _mm256_setr_epi8(
+        tooShort, tooShort, tooShort, tooShort, tooShort, tooShort, tooShort, tooShort,
+        cont8, cont9, contA, contA, tooShort, tooShort, tooShort, tooShort,
+        tooShort, tooShort, tooShort, tooShort, tooShort, tooShort, tooShort, tooShort,
+        cont8, cont9, contA, contA, tooShort, tooShort, tooShort, tooShort);
+    const auto nibble = _mm256_set1_epi8(0x0f);
+    const auto top = _mm256_set1_epi8(static_cast<char>(0x80));
+    const auto third = _mm256_set1_epi8(static_cast<char>(0xe0 - 0x80));
+    const auto fourth = _mm256_set1_epi8(static_cast<char>(0xf0 - 0x80));
+    // a lead in the last three bytes still needs continuations from the next block
+    const auto unfinished = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        static_cast<char>(0xf0 - 1), static_cast<char>(0xe0 - 1), static_cast<char>(0xc0 - 1));
+
+    auto previous = _mm256_setzero_si256();
+    auto incomplete = _mm256_setzero_si256();
+    size_t i = 0;
+    for ( ; i + 32 <= size; i += 32) {
+        auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        if (_mm256_movemask_epi8(block) == 0) {
+            if (!_mm256_testz_si256(incomplete, incomplete)) {
+                break;
+            }
+            previous = block;
+            continue;
+        }
+
+        auto shifted = _mm256_permute2x128_si256(previous, block, 0x21);
+        auto prev1 = _mm256_alignr_epi8(block, shifted, 15);
+        auto prev2 = _mm256_alignr_epi8(block, shifted, 14);
+        auto prev3 = _mm256_alignr_epi8(block, shifted, 13);
+        auto special = _mm256_and_si256(
+            _mm256_and_si256(
+                _mm256_shuffle_epi8(high1, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+                _mm256_shuffle_epi8(low1, _mm256_and_si256(prev1, nibble))),
+            _mm256_shuffle_epi8(high2, _mm256_and_si256(_mm256_srli_epi16(block, 4), nibble)));
+        auto must = _mm256_and_si256(_mm256_or_si256(_mm256_subs_epu8(prev2, third), _mm256_subs_epu8(prev3, fourth)), top);
+        auto error = _mm256_xor_si256(must, special);
+        if (!_mm256_testz_si256(error, error)) {
+            break;
+        }
+        incomplete = _mm256_subs_epu8(block, unfinished);
+        previous = block;
+    }
+
+    return i;
+}
+
+size_t lineStartsSse2(const char* data, size_t size, size_t base, std::vector<size_t>& starts) {
+    const auto lf = _mm_set1_epi8('\n');
+    size_t i = 0;
+    for ( ; i + 16 <= size; i += 16) {
+        auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        auto mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, lf)));
+        while (mask) {
+            starts.push_back(base + i + __builtin_ctz(mask) + 1);
+            mask &= mask - 1;
+        }
+    }
+
+    return i;
+}
+
+size_t findSse2(const char* data, size_t size, std::string_view needle, size_t base, std::vector<size_t>& matches) {
+    auto n = needle.size();
+    const auto first = _mm_set1_epi8(needle.front());
+    const auto last = _mm_set1_epi8(needle.back());
+    size_t i = 0;
+    for ( ; i + n - 1 + 16 <= size; i += 16) {
+        auto head = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        auto tail = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + n - 1));
+        auto mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(head, first), _mm_cmpeq_epi8(tail, last))));
+        while (mask) {
+            auto at = i + __builtin_ctz(mask);
+            if (n <= 2 || memcmp(data + at + 1, needle.data() + 1, n - 2) == 0) {
+                matches.push_back(base + at);
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    return i;
+}
+
+size_t countSse2(const char* data, size_t size, char c, size_t& result) {
+    const auto v = _mm_set1_epi8(c);
+    size_t i = 0;
+    for ( ; i + 16 <= size; i += 16) {
+        auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        result += __builtin_popcount(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, v))));
+    }
+
+    return i;
+}
+
+size_t statsSse2(const char* data, size_t size, bool& afterSpace, size_t& chars, size_t& words) {
+    const auto lead = _mm_set1_epi8(-65);
+    const auto space = _mm_set1_epi8(' ');
+    const auto tab = _mm_set1_epi8('\t');
+    const auto four = _mm_set1_epi8(4);
+    uint32_t carry = afterSpace;
+    size_t i = 0;
+    for ( ; i + 16 <= size; i += 16) {
+        auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        chars += __builtin_popcount(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpgt_epi8(block, lead))));
+        auto control = _mm_sub_epi8(block, tab);
+        auto blank = _mm_or_si128(_mm_cmpeq_epi8(block, space), _mm_cmpeq_epi8(_mm_min_epu8(control, four), control));
+        auto mask = static_cast<uint32_t>(_mm_movemask_epi8(blank));
+        words += __builtin_popcount(~mask & ((mask << 1) | carry) & 0xffff);
+        carry = mask >> 15;
+    }
+    afterSpace = carry;
+
+    return i;
+}
+
+
+size_t utf8Sse2(const char* data, size_t size) {
+    size_t i = 0;
+    for ( ; i + 16 <= size; i += 16) {
+        auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        if (_mm_movemask_epi8(block) != 0) {
+            break;
+        }
+    }
+
+    return i;
+}
+
+#endif
+
+}
+
+bool TextScan::avx2() {
+#ifdef TEXT_SCAN_X86
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+void TextScan::lineStarts(const char* data, size_t size, size_t base, std::vector<size_t>& starts) {
+    size_t i = 0;
+#ifdef TEXT_SCAN_X86
+    i = avx2() ? lineStartsAvx2(data, size, base, starts) : lineStartsSse2(data, size, base, starts);
+#endif
+
+    for ( ; i < size; i++) {
+        auto found = static_cast<const char*>(memchr(data + i, '\n', size - i));
+        if (found == nullptr) {
+            break;
+        }
+        i = found - data;
+        starts.push_back(base + i + 1);
+    }
+}
+
+size_t TextScan::count(const char* data, size_t size, char c) {
+    size_t result = 0;
+    size_t i = 0;
+#ifdef TEXT_SCAN_X86
+    i = avx2() ? countAvx2(data, size, c, result) : countSse2(data, size, c, result);
+#endif
+
+    for ( ; i < size; i++) {
+        result += data[i] == c;
+    }
+
+    return result;
+}
+
+void TextScan::find(const char* data, size_t size, std::string_view needle, size_t base, std::vector<size_t>& matches) {
+    if (needle.empty() || needle.size() > size) {
+        return ;
+    }
+
+    size_t i = 0;
+#ifdef TEXT_SCAN_X86
+    i = avx2() ? findAvx2(data, size, needle, base, matches) : findSse2(data, size, needle, base, matches);
+#endif
+
+    auto end = size - needle.size() + 1;
+    while (i < end) {
+        auto found = static_cast<const char*>(memchr(data + i, needle.front(), end - i));
+        if (found == nullptr) {
+            break;
+        }
+        i = found - data;
+        if (memcmp(data + i, needle.data(), needle.size()) == 0) {
+            matches.push_back(base + i);
+        }
+        i++;
+    }
+}
+
+bool TextScan::space(char c) {
+    return c == ' ' || static_cast<unsigned char>(c - '\t') <= 4;
+}
+
+void TextScan::stats(const char* data, size_t size, bool afterSpace, size_t& chars, size_t& words) {
+    size_t i = 0;
+#ifdef TEXT_SCAN_X86
+    i = avx2() ? statsAvx2(data, size, afterSpace, chars, words) : statsSse2(data, size, afterSpace, chars, words);
+#endif
+
+    for ( ; i < size; i++) {
+        chars += (static_cast<unsigned char>(data[i]) & 0xc0) != 0x80;
+        auto blank = space(data[i]);
+        words += !blank && afterSpace;
+        afterSpace = blank;
+    }
+}
+
+// the SIMD kernels stop at the first block they cannot vouch for, the scalar
+// pass resumes at the lead of any sequence running into that block
+size_t TextScan::validUtf8(const char* data, size_t size) {
+    size_t i = 0;
+#ifdef TEXT_SCAN_X86
+    i = avx2() ? utf8Avx2(data, size) : utf8Sse2(data, size);
+    for (size_t back = 1; back <= 3 && back <= i; back++) {
+        auto c = static_cast<unsigned char>(data[i - back]);
+        if (c < 0x80) {
+            break;
+        }
+        if (c >= 0xc0) {
+            i -= back;
+            break;
+        }
+    }
+#endif
+
+    while (i < size) {
+        auto length = Utf8::sequence(data + i, size - i);
+        if (length == 0) {
+            break;
+        }
+        i += length;
+    }
+
+    return i;
+}
\ No newline at end of file
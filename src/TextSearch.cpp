@@ -0,0 +1,186 @@
+#include "TextSearch.h"
+#include "TextScan.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// whether bytes occur at offset, where offset falls in pieces[piece] and base is
+// that piece's offset
+bool equalAt(const std::vector<std::string_view>& pieces, size_t piece, size_t base, size_t offset, std::string_view bytes) {
+    for ( ; piece < pieces.size() && !bytes.empty(); base += pieces[piece].size(), piece++) {
+        if (offset >= base + pieces[piece].size()) {
+            continue;
+        }
+
+        auto part = pieces[piece].substr(offset - base, bytes.size());
+        if (bytes.substr(0, part.size()) != part) {
+            return false;
+        }
+        bytes.remove_prefix(part.size());
+        offset += part.size();
+    }
+
+    return bytes.empty();
+}
+
+}
+
+void TextSearch::search(const std::vector<std::string_view>& pieces, std::string_view needle) {
+    needle_ = needle;
+    matches_.clear();
+    history_.clear();
+    valid_ = true;
+    if (needle.empty()) {
+        return ;
+    }
+
+    // the last needle.size() - 1 bytes before the current piece; a match that
+    // starts in them is looked for in carry + head of the piece
+    std::string carry, stitch;
+    size_t base = 0;
+    for (auto piece : pieces) {
+        if (!carry.empty()) {
+            stitch = carry;
+            stitch.append(piece.substr(0, needle.size() - 1));
+            auto first = matches_.size();
+            TextScan::find(stitch.data(), stitch.size(), needle, base - carry.size(), matches_);
+            auto end = std::find_if(matches_.begin() + first, matches_.end(), [&](size_t offset) {
+                return offset >= base;
+            });
+            matches_.erase(end, matches_.end());
+        }
+
+        TextScan::find(piece.data(), piece.size(), needle, base, matches_);
+        base += piece.size();
+
+        carry.append(piece.substr(piece.size() - std::min(piece.size(), needle.size() - 1)));
+        if (carry.size() >= needle.size()) {
+            carry.erase(0, carry.size() - (needle.size() - 1));
+        }
+    }
+}
+
+void TextSearch::update(const std::vector<std::string_view>& pieces, std::string_view needle) {
+    if (!valid_ || needle_.empty()) {
+        search(pieces, needle);
+        return ;
+    }
+    if (needle == needle_) {
+        return ;
+    }
+
+    // a deleted character brings back the set it was narrowed from
+    if (!needle.starts_with(needle_)) {
+        while (!history_.empty() && !needle.starts_with(history_.back().needle_)) {
+            history_.pop_back();
+        }
+        if (history_.empty()) {
+            search(pieces, needle);
+            return ;
+        }
+
+        needle_ = std::move(history_.back().needle_);
+        matches_ = std::move(history_.back().matches_);
+        history_.pop_back();
+        if (needle == needle_) {
+            return ;
+        }
+    }
+
+    narrow(pieces, needle);
+}
+
+// offsets are in the document after the edit: erased bytes at offset were
+// replaced by inserted ones
+void TextSearch::edit(size_t offset, size_t erased, size_t inserted, const Text& text) {
+    if (!valid_ || needle_.empty()) {
+        return ;
+    }
+    history_.clear();
+
+    // matches overlapping the replaced bytes go, the ones after them move
+    auto reach = needle_.size() - 1;
+    auto begin = offset - std::min(offset, reach);
+    auto first = std::lower_bound(matches_.begin(), matches_.end(), begin);
+    auto last = std::lower_bound(first, matches_.end(), offset + erased);
+    for (auto it = last; it != matches_.end(); ++it) {
+        *it = *it - erased + inserted;
+    }
+    auto at = matches_.erase(first, last) - matches_.begin();
+
+    // whatever is found around the new bytes must overlap them
+    std::vector<size_t> found;
+    auto window = text(begin, offset + inserted + reach - begin);
+    TextScan::find(window.data(), window.size(), needle_, begin, found);
+    matches_.insert(matches_.begin() + at, found.begin(), found.end());
+}
+
+void TextSearch::clear() {
+    matches_.clear();
+    history_.clear();
+    valid_ = false;
+}
+
+bool TextSearch::valid() const {
+    return valid_;
+}
+
+const std::string& TextSearch::needle() const {
+    return needle_;
+}
+
+const std::vector<size_t>& TextSearch::matches() const {
+    return matches_;
+}
+
+size_t TextSearch::next(size_t offset) const {
+    if (matches_.empty()) {
+        return npos;
+    }
+
+    auto it = std::upper_bound(matches_.begin(), matches_.end(), offset);
+
+    return it == matches_.end() ? matches_.front() : *it;
+}
+
+size_t TextSearch::prev(size_t offset) const {
+    if (matches_.empty()) {
+        return npos;
+    }
+
+    auto it = std::lower_bound(matches_.begin(), matches_.end(), offset);
+
+    return it == matches_.begin() ? matches_.back() : *(it - 1);
+}
+
+// keeps the matches of the current needle that go on with the rest of needle
+void TextSearch::narrow(const std::vector<std::string_view>& pieces, std::string_view needle) {
+    auto rest = needle.substr(needle_.size());
+    std::vector<size_t> kept;
+    kept.reserve(matches_.size());
+    size_t piece = 0, base = 0;
+    for (auto match : matches_) {
+        auto at = match + needle_.size();
+        while (piece < pieces.size() && base + pieces[piece].size() <= at) {
+            base += pieces[piece].size();
+            piece++;
+        }
+
+        // the rest is nearly always inside the same piece, and is mostly the
+        // one character just typed
+        if (piece < pieces.size() && at + rest.size() <= base + pieces[piece].size()) {
+            auto data = pieces[piece].data() + (at - base);
+            if (data[0] == rest[0] && (rest.size() == 1 || memcmp(data + 1, rest.data() + 1, rest.size() - 1) == 0)) {
+                kept.push_back(match);
+            }
+        } else if (equalAt(pieces, piece, base, at, rest)) {
+            kept.push_back(match);
+        }
+    }
+
+    history_.push_back({std::move(needle_), std::move(matches_)});
+    needle_ = needle;
+    matches_ = std::move(kept);
+}
\ No newline at end of file
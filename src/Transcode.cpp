@@ -0,0 +1,535 @@
+#include "Transcode.h"
+#include "TextScan.h"
+#include "Utf8.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#define TRANSCODE_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// the longest input a character can take, and so the most a chunk holds back
+constexpr size_t maxCarry = 4;
+
+// for 8 characters laid out as (first byte, second byte) pairs in a vector:
+// the shuffle that keeps every first byte and the second byte of the
+// characters whose bit is set, and how many bytes that keeps
+struct Compress {
+    alignas(16) uint8_t shuffle_[256][16];
+    uint8_t length_[256];
+
+    constexpr Compress() : shuffle_{}, length_{} {
+        for (int mask = 0; mask < 256; mask++) {
+            int n = 0;
+            for (int i = 0; i < 8; i++) {
+                shuffle_[mask][n++] = 2 * i;
+                if (mask & (1 << i)) {
+                    shuffle_[mask][n++] = 2 * i + 1;
+                }
+            }
+            for (int k = n; k < 16; k++) {
+                shuffle_[mask][k] = 0x80;
+            }
+            length_[mask] = n;
+        }
+    }
+};
+
+constexpr Compress compress;
+
+// for 4 characters of 1 to 3 bytes laid out in 32-bit lanes: the shuffle that
+// packs them, by the lengths less one in two bits per lane
+struct Pack {
+    alignas(16) uint8_t shuffle_[256][16];
+    uint8_t length_[256];
+    // mask bit i moved to bit 2i
+    uint8_t spread_[16];
+
+    constexpr Pack() : shuffle_{}, length_{}, spread_{} {
+        for (int index = 0; index < 256; index++) {
+            int n = 0;
+            for (int i = 0; i < 4; i++) {
+                auto length = (index >> (2 * i) & 3) + 1;
+                for (int k = 0; k < length && k < 3; k++) {
+                    shuffle_[index][n++] = 4 * i + k;
+                }
+            }
+            for (int k = n; k < 16; k++) {
+                shuffle_[index][k] = 0x80;
+            }
+            length_[index] = n;
+        }
+        for (int mask = 0; mask < 16; mask++) {
+            for (int i = 0; i < 4; i++) {
+                spread_[mask] |= (mask >> i & 1) << (2 * i);
+            }
+        }
+    }
+};
+
+constexpr Pack pack;
+
+char* putUtf8(char32_t c, char* out) {
+    if (c < 0x80) {
+        *out++ = static_cast<char>(c);
+    } else if (c < 0x800) {
+        *out++ = static_cast<char>(0xc0 | c >> 6);
+        *out++ = static_cast<char>(0x80 | (c & 0x3f));
+    } else if (c < 0x10000) {
+        *out++ = static_cast<char>(0xe0 | c >> 12);
+        *out++ = static_cast<char>(0x80 | (c >> 6 & 0x3f));
+        *out++ = static_cast<char>(0x80 | (c & 0x3f));
+    } else {
+        *out++ = static_cast<char>(0xf0 | c >> 18);
+        *out++ = static_cast<char>(0x80 | (c >> 12 & 0x3f));
+        *out++ = static_cast<char>(0x80 | (c >> 6 & 0x3f));
+        *out++ = static_cast<char>(0x80 | (c & 0x3f));
+    }
+
+    return out;
+}
+
+char* putUnit(uint32_t unit, bool big, char* out) {
+    out[big ? 0 : 1] = static_cast<char>(unit >> 8);
+    out[big ? 1 : 0] = static_cast<char>(unit);
+
+    return out + 2;
+}
+
+char* putUtf16(char32_t c, bool big, char* out) {
+    if (c < 0x10000) {
+        return putUnit(c, big, out);
+    }
+
+    c -= 0x10000;
+    out = putUnit(0xd800 | c >> 10, big, out);
+    return putUnit(0xdc00 | (c & 0x3ff), big, out);
+}
+
+uint32_t unitAt(const unsigned char* in, bool big) {
+    return big ? in[0] << 8 | in[1] : in[0] | in[1] << 8;
+}
+
+// a lead byte followed only by continuation bytes, fewer than it needs
+bool cutUtf8(const unsigned char* in, size_t size) {
+    size_t need = in[0] >= 0xf0 ? 4 : in[0] >= 0xe0 ? 3 : 2;
+    if (in[0] < 0xc2 || in[0] > 0xf4 || size >= need) {
+        return false;
+    }
+    for (size_t i = 1; i < size; i++) {
+        if ((in[i] & 0xc0) != 0x80) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+#ifdef TRANSCODE_X86
+
+// ASCII blocks are stored as they are; any other 8 bytes become lead and
+// continuation pairs compressed down to the bytes they need
+__attribute__((target("avx2")))
+size_t latin1ToUtf8Avx2(const unsigned char* in, size_t size, char*& out) {
+    const auto low6 = _mm_set1_epi8(0x3f);
+    const auto top2 = _mm_set1_epi8(0x03);
+    const auto lead = _mm_set1_epi8(static_cast<char>(0xc0));
+    const auto continuation = _mm_set1_epi8(static_cast<char>(0x80));
+    size_t i = 0;
+    for ( ; i + 32 <= size; i += 32) {
+        auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(block));
+        if (mask == 0) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), block);
+            out += 32;
+            continue;
+        }
+
+        for (int k = 0; k < 4; k++) {
+            auto bits = mask >> (8 * k) & 0xff;
+            auto v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + i + 8 * k));
+            if (bits == 0) {
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(out), v);
+                out += 8;
+                continue;
+            }
+            auto first = _mm_blendv_epi8(v, _mm_or_si128(_mm_and_si128(_mm_srli_epi16(v, 6), top2), lead), v);
+            auto second = _mm_or_si128(_mm_and_si128(v, low6), continuation);
+            auto pairs = _mm_unpacklo_epi8(first, second);
+            auto shuffle = _mm_load_si128(reinterpret_cast<const __m128i*>(compress.shuffle_[bits]));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi8(pairs, shuffle));
+            out += compress.length_[bits];
+        }
+    }
+
+    return i;
+}
+
+// 16 units at a time: all ASCII packs to bytes, all below U+0800 goes
+// through the same pair compression as Latin-1, and any other block
+// without surrogates is packed 8 units at a time; the rest is left to the
+// scalar loop
+__attribute__((target("avx2")))
+size_t utf16ToUtf8Avx2(const unsigned char* in, size_t size, bool big, char*& out) {
+    const auto swap = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14, 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    const auto notAscii = _mm256_set1_epi16(static_cast<short>(0xff80));
+    const auto notTwo = _mm256_set1_epi16(static_cast<short>(0xf800));
+    const auto ascii8 = _mm_set1_epi16(static_cast<short>(0xff80));
+    const auto low6 = _mm_set1_epi16(0x3f);
+    const auto lead = _mm_set1_epi16(0xc0);
+    const auto continuation = _mm_set1_epi16(0x80);
+    const auto zero = _mm_setzero_si128();
+    const auto surrogate = _mm256_set1_epi16(static_cast<short>(0xd800));
+    const auto lane80 = _mm256_set1_epi32(0x80);
+    const auto lane800 = _mm256_set1_epi32(0x800);
+    const auto lane3f = _mm256_set1_epi32(0x3f);
+    const auto lane3f00 = _mm256_set1_epi32(0x3f00);
+    const auto lane8000 = _mm256_set1_epi32(0x8000);
+    const auto lanec0 = _mm256_set1_epi32(0xc0);
+    const auto lanee0 = _mm256_set1_epi32(0xe0);
+    size_t i = 0;
+    for ( ; i + 32 <= size; i += 32) {
+        auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        if (big) {
+            block = _mm256_shuffle_epi8(block, swap);
+        }
+
+        if (_mm256_testz_si256(block, notAscii)) {
+            auto packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(block, block), 0x08);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm256_castsi256_si128(packed));
+            out += 16;
+            continue;
+        }
+        if (!_mm256_testz_si256(block, notTwo)) {
+            auto surrogates = _mm256_cmpeq_epi16(_mm256_and_si256(block, notTwo), surrogate);
+            if (!_mm256_testz_si256(surrogates, surrogates)) {
+                break;
+            }
+            // every lane gets all three encodings and keeps the one it needs
+            for (int k = 0; k < 2; k++) {
+                auto units = _mm256_cvtepu16_epi32(k == 0 ? _mm256_castsi256_si128(block) : _mm256_extracti128_si256(block, 1));
+                auto isAscii = _mm256_cmpgt_epi32(lane80, units);
+                auto isTwo = _mm256_cmpgt_epi32(lane800, units);
+                auto middle = _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi32(units, 2), lane3f00), lane8000);
+                auto last = _mm256_or_si256(_mm256_and_si256(units, lane3f), lane80);
+                auto two = _mm256_or_si256(_mm256_or_si256(_mm256_srli_epi32(units, 6), lanec0), _mm256_slli_epi32(last, 8));
+                auto three = _mm256_or_si256(_mm256_or_si256(_mm256_srli_epi32(units, 12), lanee0), _mm256_or_si256(middle, _mm256_slli_epi32(last, 16)));
+                auto bytes = _mm256_blendv_epi8(_mm256_blendv_epi8(three, two, isTwo), units, isAscii);
+                auto ascii = ~_mm256_movemask_ps(_mm256_castsi256_ps(isAscii));
+                auto twoBits = ~_mm256_movemask_ps(_mm256_castsi256_ps(isTwo));
+                auto first = pack.spread_[ascii & 15] + pack.spread_[twoBits & 15];
+                auto second = pack.spread_[ascii >> 4 & 15] + pack.spread_[twoBits >> 4 & 15];
+                auto shuffle = _mm256_loadu2_m128i(reinterpret_cast<const __m128i*>(pack.shuffle_[second]), reinterpret_cast<const __m128i*>(pack.shuffle_[first]));
+                auto packed = _mm256_shuffle_epi8(bytes, shuffle);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm256_castsi256_si128(packed));
+                out += pack.length_[first];
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm256_extracti128_si256(packed, 1));
+                out += pack.length_[second];
+            }
+            continue;
+        }
+
+        for (int k = 0; k < 2; k++) {
+            auto units = k == 0 ? _mm256_castsi256_si128(block) : _mm256_extracti128_si256(block, 1);
+            auto isAscii = _mm_cmpeq_epi16(_mm_and_si128(units, ascii8), zero);
+            auto bits = ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_packs_epi16(isAscii, isAscii))) & 0xff;
+            auto first = _mm_blendv_epi8(_mm_or_si128(_mm_srli_epi16(units, 6), lead), units, isAscii);
+            auto second = _mm_or_si128(_mm_and_si128(units, low6), continuation);
+            auto pairs = _mm_unpacklo_epi8(_mm_packus_epi16(first, first), _mm_packus_epi16(second, second));
+            auto shuffle = _mm_load_si128(reinterpret_cast<const __m128i*>(compress.shuffle_[bits]));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi8(pairs, shuffle));
+            out += compress.length_[bits];
+        }
+    }
+
+    return i;
+}
+
+// ASCII blocks widen to units; the first block with anything else stops it
+__attribute__((target("avx2")))
+size_t utf8ToUtf16Avx2(const unsigned char* in, size_t size, bool big, char*& out) {
+    const auto zero = _mm256_setzero_si256();
+    size_t i = 0;
+    for ( ; i + 32 <= size; i += 32) {
+        auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        if (_mm256_movemask_epi8(block) != 0) {
+            break;
+        }
+        block = _mm256_permute4x64_epi64(block, 0xd8);
+        auto low = big ? _mm256_unpacklo_epi8(zero, block) : _mm256_unpacklo_epi8(block, zero);
+        auto high = big ? _mm256_unpackhi_epi8(zero, block) : _mm256_unpackhi_epi8(block, zero);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), low);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 32), high);
+        out += 64;
+    }
+
+    return i;
+}
+
+__attribute__((target("avx2")))
+size_t asciiAvx2(const unsigned char* in, size_t size, char*& out) {
+    size_t i = 0;
+    for ( ; i + 32 <= size; i += 32) {
+        auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        if (_mm256_movemask_epi8(block) != 0) {
+            break;
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), block);
+        out += 32;
+    }
+
+    return i;
+}
+
+#endif
+
+size_t latin1ToUtf8(const unsigned char* in, size_t size, char*& out) {
+    size_t i = 0;
+#ifdef TRANSCODE_X86
+    if (TextScan::avx2()) {
+        i = latin1ToUtf8Avx2(in, size, out);
+    }
+#endif
+
+    for ( ; i < size; i++) {
+        out = putUtf8(in[i], out);
+    }
+
+    return size;
+}
+
+// unpaired surrogates become U+FFFD; an odd byte or a high surrogate at the
+// end is left unconsumed
+size_t utf16ToUtf8(const unsigned char* in, size_t size, bool big, char*& out) {
+    size_t i = 0;
+    while (i + 2 <= size) {
+#ifdef TRANSCODE_X86
+        if (TextScan::avx2()) {
+            i += utf16ToUtf8Avx2(in + i, size - i, big, out);
+        }
+#endif
+        // one block's worth before trying the vector path again
+        auto end = std::min(size, i + 32);
+        while (i + 2 <= end) {
+            auto unit = unitAt(in + i, big);
+            char32_t c = unit;
+            size_t length = 2;
+            if (unit >= 0xd800 && unit < 0xdc00) {
+                if (i + 4 > size) {
+                    return i;
+                }
+                auto low = unitAt(in + i + 2, big);
+                if (low >= 0xdc00 && low < 0xe000) {
+                    c = 0x10000 + ((unit - 0xd800) << 10) + (low - 0xdc00);
+                    length = 4;
+                } else {
+                    c = Utf8::replacement;
+                }
+            } else if (unit >= 0xdc00 && unit < 0xe000) {
+                c = Utf8::replacement;
+            }
+            out = putUtf8(c, out);
+            i += length;
+        }
+    }
+
+    return i;
+}
+
+// the code point of the well-formed sequence at in[0], else U+FFFD with a
+// length of 0
+inline char32_t decodeUtf8(const unsigned char* in, size_t size, size_t& length) {
+    auto continuation = [&](size_t k) { return k < size && (in[k] & 0xc0) == 0x80; };
+    char32_t c = in[0];
+    length = 0;
+    if (c < 0x80) {
+        length = 1;
+    } else if (c >= 0xc2 && c < 0xe0 && continuation(1)) {
+        c = (c & 0x1f) << 6 | (in[1] & 0x3f);
+        length = 2;
+    } else if (c >= 0xe0 && c < 0xf0 && continuation(1) && continuation(2)) {
+        c = (c & 0x0f) << 12 | (in[1] & 0x3f) << 6 | (in[2] & 0x3f);
+        length = c >= 0x800 && (c < 0xd800 || c >= 0xe000) ? 3 : 0;
+    } else if (c >= 0xf0 && c < 0xf5 && continuation(1) && continuation(2) && continuation(3)) {
+        c = (c & 0x07) << 18 | (in[1] & 0x3f) << 12 | (in[2] & 0x3f) << 6 | (in[3] & 0x3f);
+        length = c >= 0x10000 && c < 0x110000 ? 4 : 0;
+    }
+
+    return length == 0 ? Utf8::replacement : c;
+}
+
+// malformed bytes become U+FFFD, or '?' in Latin-1 along with every
+// character past U+00FF; a character cut by the end is left unconsumed
+size_t fromUtf8(const unsigned char* in, size_t size, Transcode::Encoding to, char*& out) {
+    bool big = to == Transcode::Utf16BE;
+    size_t i = 0;
+    while (i < size) {
+#ifdef TRANSCODE_X86
+        if (TextScan::avx2()) {
+            i += to == Transcode::Latin1 ? asciiAvx2(in + i, size - i, out) : utf8ToUtf16Avx2(in + i, size - i, big, out);
+        }
+#endif
+        auto end = std::min(size, i + 32);
+        while (i < end) {
+            size_t length;
+            auto c = decodeUtf8(in + i, size - i, length);
+            if (length == 0) {
+                if (cutUtf8(in + i, size - i)) {
+                    return i;
+                }
+                length = 1;
+            }
+
+            if (to == Transcode::Latin1) {
+                *out++ = c < 0x100 ? static_cast<char>(c) : '?';
+            } else {
+                out = putUtf16(c, big, out);
+            }
+            i += length;
+        }
+    }
+
+    return i;
+}
+
+}
+
+Transcode::Stream::Stream(Encoding from, Encoding to) : from_(from), to_(to) {
+
+}
+
+// the held back bytes are joined with enough of data to finish them, the
+// rest of data is converted in place
+void Transcode::Stream::convert(std::string_view data, std::string& out) {
+    if (!carry_.empty()) {
+        auto joined = carry_;
+        joined.append(data.substr(0, 16 * maxCarry));
+        auto used = convertWhole(joined, out);
+        if (joined.size() - carry_.size() == data.size()) {
+            carry_ = joined.substr(used);
+            return ;
+        }
+        data.remove_prefix(used - carry_.size());
+        carry_.clear();
+    }
+
+    auto used = convertWhole(data, out);
+    carry_.assign(data.substr(used));
+}
+
+void Transcode::Stream::finish(std::string& out) {
+    if (carry_.empty()) {
+        return ;
+    }
+
+    // a UTF-16 tail can be an unpaired high surrogate and an odd byte
+    auto count = from_ == Utf8 ? 1 : (carry_.size() + 1) / 2;
+    carry_.clear();
+
+    char replacement[4];
+    auto end = replacement;
+    if (to_ == Utf8) {
+        end = putUtf8(Utf8::replacement, end);
+    } else if (to_ == Latin1) {
+        *end++ = '?';
+    } else {
+        end = putUtf16(Utf8::replacement, to_ == Utf16BE, end);
+    }
+    for (size_t i = 0; i < count; i++) {
+        out.append(replacement, end);
+    }
+}
+
+// the vector paths store whole blocks, so the buffer has a block of slack
+size_t Transcode::Stream::convertWhole(std::string_view data, std::string& out) {
+    auto in = reinterpret_cast<const unsigned char*>(data.data());
+    if (from_ == to_) {
+        out.append(data);
+        return data.size();
+    }
+
+    auto worst = from_ == Utf8 ? data.size() * 2 : from_ == Latin1 ? data.size() * 2 : data.size() * 3 / 2;
+    if (buffer_.size() < worst + 64) {
+        buffer_.resize(worst + 64);
+    }
+
+    auto begin = buffer_.data();
+    auto end = begin;
+    size_t used;
+    if (from_ == Latin1) {
+        used = latin1ToUtf8(in, data.size(), end);
+    } else if (from_ != Utf8) {
+        used = utf16ToUtf8(in, data.size(), from_ == Utf16BE, end);
+    } else {
+        used = fromUtf8(in, data.size(), to_, end);
+    }
+    out.append(begin, end);
+
+    return used;
+}
+
+Transcode::Format Transcode::detect(std::string_view data, bool whole) {
+    Format format;
+    if (data.starts_with("\xef\xbb\xbf")) {
+        format.bom_ = true;
+        return format;
+    }
+    if (data.starts_with("\xff\xfe") || data.starts_with("\xfe\xff")) {
+        format.encoding_ = data[0] == '\xff' ? Utf16LE : Utf16BE;
+        format.bom_ = true;
+        return format;
+    }
+
+    // text in UTF-16 is mostly characters below U+0100, whose high byte is 0
+    auto sample = data.substr(0, 64 << 10);
+    size_t zeros[2] = {0, 0};
+    for (size_t i = 0; i < sample.size(); i++) {
+        zeros[i & 1] += sample[i] == '\0';
+    }
+    auto units = sample.size() / 2;
+    if (units > 0 && std::max(zeros[0], zeros[1]) > units / 4 && std::min(zeros[0], zeros[1]) < units / 64 + 1) {
+        format.encoding_ = zeros[1] > zeros[0] ? Utf16LE : Utf16BE;
+        return format;
+    }
+
+    auto valid = TextScan::validUtf8(data.data(), data.size());
+    if (valid < data.size() && (whole || !cutUtf8(reinterpret_cast<const unsigned char*>(data.data()) + valid, data.size() - valid))) {
+        format.encoding_ = Latin1;
+    }
+
+    return format;
+}
+
+std::string_view Transcode::bom(Format format) {
+    if (!format.bom_) {
+        return {};
+    }
+
+    switch (format.encoding_) {
+    case Utf8:
+        return "\xef\xbb\xbf";
+    case Utf16LE:
+        return "\xff\xfe";
+    case Utf16BE:
+        return "\xfe\xff";
+    default:
+        return {};
+    }
+}
+
+const char* Transcode::name(Format format) {
+    switch (format.encoding_) {
+    case Utf8:
+        return format.bom_ ? "utf-8 bom" : "utf-8";
+    case Utf16LE:
+        return "utf-16le";
+    case Utf16BE:
+        return "utf-16be";
+    default:
+        return "latin-1";
+    }
+}
\ No newline at end of file
@@ -0,0 +1,186 @@
+#include "UndoJournal.h"
+
+#include <algorithm>
+#include <limits>
+
+UndoJournal::UndoJournal(size_t capacity) : capacity_(capacity) {
+
+}
+
+// begin()/end() bracket one Editor operation; nested calls join the outer step
+void UndoJournal::begin(bool typing) {
+    if (depth_++ > 0) {
+        return ;
+    }
+
+    if (!typing || !typing_) {
+        stepOpen_ = false;
+    }
+    typing_ = typing;
+}
+
+void UndoJournal::end() {
+    depth_ = std::max(depth_ - 1, 0);
+}
+
+void UndoJournal::breakTyping() {
+    typing_ = false;
+    stepOpen_ = false;
+}
+
+void UndoJournal::recordInsert(size_t offset, std::string_view text) {
+    constexpr size_t limit = std::numeric_limits<uint32_t>::max();
+    for (size_t done = 0; done < text.size(); done += limit) {
+        record(offset + done, {}, text.substr(done, limit));
+    }
+}
+
+void UndoJournal::recordErase(size_t offset, std::string_view text) {
+    constexpr size_t limit = std::numeric_limits<uint32_t>::max();
+    for (size_t done = 0; done < text.size(); done += limit) {
+        record(offset, text.substr(done, limit), {});
+    }
+}
+
+bool UndoJournal::undo(const Apply& apply, size_t& cursor) {
+    breakTyping();
+    if (current_ == 0) {
+        return false;
+    }
+
+    current_--;
+    auto first = steps_[current_].record_;
+    for (auto i = recordEnd(current_); i-- > first; ) {
+        auto& r = recordAt(i);
+        apply(r.offset_, r.inserted_, bytes(r.arena_, r.erased_));
+        cursor = r.offset_;
+    }
+
+    return true;
+}
+
+bool UndoJournal::redo(const Apply& apply, size_t& cursor) {
+    breakTyping();
+    if (current_ >= steps_.size()) {
+        return false;
+    }
+
+    for (auto i = steps_[current_].record_; i < recordEnd(current_); i++) {
+        auto& r = recordAt(i);
+        apply(r.offset_, r.erased_, bytes(r.arena_ + r.erased_, r.inserted_));
+        cursor = r.offset_ + r.inserted_;
+    }
+    current_++;
+
+    return true;
+}
+
+void UndoJournal::clear() {
+    records_.clear();
+    steps_.clear();
+    arena_.clear();
+    recordBase_ = arenaBase_ = arenaFront_ = 0;
+    current_ = 0;
+    typing_ = stepOpen_ = false;
+}
+
+void UndoJournal::setCapacity(size_t capacity) {
+    capacity_ = capacity;
+    shrink();
+}
+
+size_t UndoJournal::usage() const {
+    return arena_.size() - (arenaFront_ - arenaBase_) + records_.size() * sizeof(Record) + steps_.size() * sizeof(Step);
+}
+
+size_t UndoJournal::steps() const {
+    return current_;
+}
+
+void UndoJournal::record(size_t offset, std::string_view erased, std::string_view inserted) {
+    dropRedo();
+
+    auto arenaEnd = arenaBase_ + arena_.size();
+    if (stepOpen_ && typing_ && erased.empty() && !records_.empty()) {
+        // a typed character right after the previous one extends that record
+        auto& last = records_.back();
+        if (last.erased_ == 0 && last.offset_ + last.inserted_ == offset && last.arena_ + last.inserted_ == arenaEnd
+            && last.inserted_ + inserted.size() <= std::numeric_limits<uint32_t>::max()) {
+            arena_.append(inserted);
+            last.inserted_ += static_cast<uint32_t>(inserted.size());
+            shrink();
+            return ;
+        }
+
+        stepOpen_ = false;
+    }
+
+    if (!stepOpen_) {
+        Step step;
+        step.record_ = recordBase_ + records_.size();
+        step.arena_ = arenaEnd;
+        steps_.push_back(step);
+        current_ = steps_.size();
+        stepOpen_ = true;
+    }
+
+    Record r;
+    r.offset_ = offset;
+    r.arena_ = arenaEnd;
+    r.erased_ = static_cast<uint32_t>(erased.size());
+    r.inserted_ = static_cast<uint32_t>(inserted.size());
+    arena_.append(erased);
+    arena_.append(inserted);
+    records_.push_back(r);
+
+    shrink();
+}
+
+// a new edit forgets everything that was undone
+void UndoJournal::dropRedo() {
+    if (current_ >= steps_.size()) {
+        return ;
+    }
+
+    auto& step = steps_[current_];
+    records_.resize(step.record_ - recordBase_);
+    arena_.resize(step.arena_ - arenaBase_);
+    steps_.resize(current_);
+    stepOpen_ = false;
+}
+
+// what was undone goes first: redo replays from current_ on, so a step there
+// cannot go without the ones after it. Then the oldest steps before current_
+void UndoJournal::shrink() {
+    if (usage() > capacity_) {
+        dropRedo();
+    }
+    // the step being recorded is never dropped
+    while (current_ > 0 && steps_.size() > 1 && usage() > capacity_) {
+        auto next = steps_[1];
+        records_.erase(records_.begin(), records_.begin() + (next.record_ - recordBase_));
+        recordBase_ = next.record_;
+        arenaFront_ = next.arena_;
+        steps_.pop_front();
+        current_--;
+    }
+
+    // compact once the dead prefix is at least half of the arena
+    auto dead = arenaFront_ - arenaBase_;
+    if (dead > 0 && dead * 2 >= arena_.size()) {
+        arena_.erase(0, dead);
+        arenaBase_ = arenaFront_;
+    }
+}
+
+UndoJournal::Record& UndoJournal::recordAt(uint64_t index) {
+    return records_[index - recordBase_];
+}
+
+std::string_view UndoJournal::bytes(uint64_t arena, size_t length) const {
+    return std::string_view(arena_).substr(arena - arenaBase_, length);
+}
+
+uint64_t UndoJournal::recordEnd(size_t step) const {
+    return step + 1 < steps_.size() ? steps_[step + 1].record_ : recordBase_ + records_.size();
+}
\ No newline at end of file
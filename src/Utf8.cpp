@@ -0,0 +1,258 @@
+#include "Utf8.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+// Grapheme_Cluster_Break values that matter to the rules in Utf8::next
+enum Break : uint8_t {
+    Other,
+    CR,
+    LF,
+    Control,
+    Extend,
+    ZWJ,
+    RegionalIndicator,
+    SpacingMark,
+    L,
+    V,
+    T,
+    LV,
+    LVT,
+    Pictographic,
+};
+
+struct Range {
+    char32_t first_;
+    char32_t last_;
+    Break break_;
+};
+
+// a compact subset of the UAX #29 property table: combining marks and spacing
+// marks of the common scripts, emoji and the format characters, sorted by
+// first; Hangul syllables are computed, everything else is Other
+constexpr Range ranges[] = {
+    {0x00a9, 0x00a9, Pictographic}, {0x00ad, 0x00ad, Control}, {0x00ae, 0x00ae, Pictographic},
+    {0x0300, 0x036f, Extend}, {0x0483, 0x0489, Extend}, {0x0591, 0x05bd, Extend},
+    {0x05bf, 0x05bf, Extend}, {0x05c1, 0x05c2, Extend}, {0x05c4, 0x05c5, Extend},
+    {0x05c7, 0x05c7, Extend}, {0x0610, 0x061a, Extend}, {0x061c, 0x061c, Control},
+    {0x064b, 0x065f, Extend}, {0x0670, 0x0670, Extend}, {0x06d6, 0x06dc, Extend},
+    {0x06df, 0x06e4, Extend}, {0x06e7, 0x06e8, Extend}, {0x06ea, 0x06ed, Extend},
+    {0x0711, 0x0711, Extend}, {0x0730, 0x074a, Extend}, {0x07a6, 0x07b0, Extend},
+    {0x07eb, 0x07f3, Extend}, {0x0816, 0x082d, Extend}, {0x0859, 0x085b, Extend},
+    {0x08d3, 0x08ff, Extend}, {0x0900, 0x0902, Extend}, {0x0903, 0x0903, SpacingMark},
+    {0x093a, 0x093a, Extend}, {0x093b, 0x093b, SpacingMark}, {0x093c, 0x093c, Extend},
+    {0x093e, 0x0940, SpacingMark}, {0x0941, 0x0948, Extend}, {0x0949, 0x094c, SpacingMark},
+    {0x094d, 0x094d, Extend}, {0x094e, 0x094f, SpacingMark}, {0x0951, 0x0957, Extend},
+    {0x0962, 0x0963, Extend}, {0x0981, 0x0981, Extend}, {0x0982, 0x0983, SpacingMark},
+    {0x09bc, 0x09bc, Extend}, {0x09be, 0x09be, Extend}, {0x09bf, 0x09c0, SpacingMark},
+    {0x09c1, 0x09c4, Extend}, {0x09c7, 0x09cc, SpacingMark}, {0x09cd, 0x09cd, Extend},
+    {0x09d7, 0x09d7, Extend}, {0x09e2, 0x09e3, Extend}, {0x0a01, 0x0a02, Extend},
+    {0x0a03, 0x0a03, SpacingMark}, {0x0a3c, 0x0a3c, Extend}, {0x0a3e, 0x0a40, SpacingMark},
+    {0x0a41, 0x0a51, Extend}, {0x0a70, 0x0a71, Extend}, {0x0a75, 0x0a75, Extend},
+    {0x0a81, 0x0a82, Extend}, {0x0a83, 0x0a83, SpacingMark}, {0x0abc, 0x0abc, Extend},
+    {0x0abe, 0x0ac0, SpacingMark}, {0x0ac1, 0x0ac8, Extend}, {0x0ac9, 0x0acc, SpacingMark},
+    {0x0acd, 0x0acd, Extend}, {0x0b01, 0x0b01, Extend}, {0x0b02, 0x0b03, SpacingMark},
+    {0x0b3c, 0x0b3c, Extend}, {0x0b3f, 0x0b3f, Extend}, {0x0b40, 0x0b40, SpacingMark},
+    {0x0b41, 0x0b44, Extend}, {0x0b47, 0x0b4c, SpacingMark}, {0x0b4d, 0x0b4d, Extend},
+    {0x0bbf, 0x0bbf, SpacingMark}, {0x0bc0, 0x0bc0, Extend}, {0x0bc1, 0x0bcc, SpacingMark},
+    {0x0bcd, 0x0bcd, Extend}, {0x0c01, 0x0c03, SpacingMark}, {0x0c3e, 0x0c40, Extend},
+    {0x0c41, 0x0c44, SpacingMark}, {0x0c46, 0x0c56, Extend}, {0x0c82, 0x0c83, SpacingMark},
+    {0x0cbc, 0x0cbc, Extend}, {0x0cbe, 0x0cc4, SpacingMark}, {0x0ccc, 0x0ccd, Extend},
+    {0x0d02, 0x0d03, SpacingMark}, {0x0d3f, 0x0d40, SpacingMark}, {0x0d41, 0x0d44, Extend},
+    {0x0d46, 0x0d4c, SpacingMark}, {0x0d4d, 0x0d4d, Extend}, {0x0e31, 0x0e31, Extend},
+    {0x0e33, 0x0e33, SpacingMark}, {0x0e34, 0x0e3a, Extend}, {0x0e47, 0x0e4e, Extend},
+    {0x0eb1, 0x0eb1, Extend}, {0x0eb3, 0x0eb3, SpacingMark}, {0x0eb4, 0x0ebc, Extend},
+    {0x0ec8, 0x0ecd, Extend}, {0x0f18, 0x0f19, Extend}, {0x0f35, 0x0f35, Extend},
+    {0x0f37, 0x0f37, Extend}, {0x0f39, 0x0f39, Extend}, {0x0f3e, 0x0f3f, SpacingMark},
+    {0x0f71, 0x0f7e, Extend}, {0x0f7f, 0x0f7f, SpacingMark}, {0x0f80, 0x0f84, Extend},
+    {0x0f86, 0x0f87, Extend}, {0x0f8d, 0x0fbc, Extend}, {0x102d, 0x1030, Extend},
+    {0x1031, 0x1031, SpacingMark}, {0x1032, 0x1037, Extend}, {0x1039, 0x103a, Extend},
+    {0x103b, 0x103c, SpacingMark}, {0x1100, 0x115f, L}, {0x1160, 0x11a7, V},
+    {0x11a8, 0x11ff, T}, {0x17b4, 0x17b5, Extend}, {0x17b6, 0x17b6, SpacingMark},
+    {0x17b7, 0x17bd, Extend}, {0x17be, 0x17c5, SpacingMark}, {0x17c6, 0x17c6, Extend},
+    {0x17c7, 0x17c8, SpacingMark}, {0x17c9, 0x17d3, Extend}, {0x180b, 0x180d, Extend},
+    {0x180e, 0x180e, Control}, {0x1ab0, 0x1aff, Extend}, {0x1dc0, 0x1dff, Extend},
+    {0x200b, 0x200b, Control}, {0x200c, 0x200c, Extend}, {0x200d, 0x200d, ZWJ},
+    {0x200e, 0x200f, Control}, {0x2028, 0x202e, Control}, {0x203c, 0x203c, Pictographic},
+    {0x2049, 0x2049, Pictographic}, {0x2060, 0x206f, Control}, {0x20d0, 0x20f0, Extend},
+    {0x2122, 0x2122, Pictographic}, {0x2139, 0x2139, Pictographic}, {0x2194, 0x2199, Pictographic},
+    {0x21a9, 0x21aa, Pictographic}, {0x231a, 0x231b, Pictographic}, {0x2328, 0x2328, Pictographic},
+    {0x23cf, 0x23cf, Pictographic}, {0x23e9, 0x23f3, Pictographic}, {0x23f8, 0x23fa, Pictographic},
+    {0x24c2, 0x24c2, Pictographic}, {0x25aa, 0x25ab, Pictographic}, {0x25b6, 0x25b6, Pictographic},
+    {0x25c0, 0x25c0, Pictographic}, {0x25fb, 0x25fe, Pictographic}, {0x2600, 0x27bf, Pictographic},
+    {0x2934, 0x2935, Pictographic}, {0x2b05, 0x2b07, Pictographic}, {0x2b1b, 0x2b1c, Pictographic},
+    {0x2b50, 0x2b50, Pictographic}, {0x2b55, 0x2b55, Pictographic}, {0x2cef, 0x2cf1, Extend},
+    {0x2de0, 0x2dff, Extend}, {0x302a, 0x302f, Extend}, {0x3030, 0x3030, Pictographic},
+    {0x303d, 0x303d, Pictographic}, {0x3099, 0x309a, Extend}, {0x3297, 0x3297, Pictographic},
+    {0x3299, 0x3299, Pictographic}, {0xa66f, 0xa672, Extend}, {0xa674, 0xa67d, Extend},
+    {0xa69e, 0xa69f, Extend}, {0xa960, 0xa97c, L}, {0xd7b0, 0xd7c6, V},
+    {0xd7cb, 0xd7fb, T}, {0xfb1e, 0xfb1e, Extend}, {0xfe00, 0xfe0f, Extend},
+    {0xfe20, 0xfe2f, Extend}, {0xfeff, 0xfeff, Control}, {0xff9e, 0xff9f, Extend},
+    {0xfff0, 0xfffb, Control}, {0x1f000, 0x1f0ff, Pictographic}, {0x1f10d, 0x1f10f, Pictographic},
+    {0x1f12f, 0x1f12f, Pictographic}, {0x1f16c, 0x1f171, Pictographic}, {0x1f17e, 0x1f17f, Pictographic},
+    {0x1f18e, 0x1f18e, Pictographic}, {0x1f191, 0x1f19a, Pictographic}, {0x1f1ad, 0x1f1e5, Pictographic},
+    {0x1f1e6, 0x1f1ff, RegionalIndicator}, {0x1f201, 0x1f20f, Pictographic}, {0x1f21a, 0x1f21a, Pictographic},
+    {0x1f22f, 0x1f22f, Pictographic}, {0x1f232, 0x1f23a, Pictographic}, {0x1f23c, 0x1f23f, Pictographic},
+    {0x1f249, 0x1f3fa, Pictographic}, {0x1f3fb, 0x1f3ff, Extend}, {0x1f400, 0x1f53d, Pictographic},
+    {0x1f546, 0x1f64f, Pictographic}, {0x1f680, 0x1f6ff, Pictographic}, {0x1f774, 0x1f77f, Pictographic},
+    {0x1f7d5, 0x1f7ff, Pictographic}, {0x1f80c, 0x1f80f, Pictographic}, {0x1f848, 0x1f84f, Pictographic},
+    {0x1f85a, 0x1f85f, Pictographic}, {0x1f888, 0x1f88f, Pictographic}, {0x1f8ae, 0x1f8ff, Pictographic},
+    {0x1f90c, 0x1f93a, Pictographic}, {0x1f93c, 0x1f945, Pictographic}, {0x1f947, 0x1faff, Pictographic},
+    {0x1fc00, 0x1fffd, Pictographic}, {0xe0000, 0xe001f, Control}, {0xe0020, 0xe007f, Extend},
+    {0xe0080, 0xe00ff, Control}, {0xe0100, 0xe01ef, Extend}, {0xe01f0, 0xe0fff, Control},
+};
+
+Break property(char32_t c) {
+    if (c < 0x7f) {
+        return c == '\r' ? CR : c == '\n' ? LF : c < 0x20 ? Control : Other;
+    }
+    if (c <= 0x9f) {
+        return Control;
+    }
+    if (c >= 0xac00 && c <= 0xd7a3) {
+        return (c - 0xac00) % 28 == 0 ? LV : LVT;
+    }
+
+    auto it = std::upper_bound(std::begin(ranges), std::end(ranges), c, [](char32_t c, const Range& range) {
+        return c < range.first_;
+    });
+    if (it == std::begin(ranges) || c > std::prev(it)->last_) {
+        return Other;
+    }
+
+    return std::prev(it)->break_;
+}
+
+}
+
+// the well-formed byte sequences of Unicode table 3-7: no overlong forms,
+// no surrogates, nothing past U+10FFFF
+size_t Utf8::sequence(const char* data, size_t size) {
+    auto s = reinterpret_cast<const unsigned char*>(data);
+    if (size == 0) {
+        return 0;
+    }
+    if (s[0] < 0x80) {
+        return 1;
+    }
+
+    size_t length;
+    unsigned char low = 0x80, high = 0xbf;
+    if (s[0] >= 0xc2 && s[0] <= 0xdf) {
+        length = 2;
+    } else if (s[0] >= 0xe0 && s[0] <= 0xef) {
+        length = 3;
+        low = s[0] == 0xe0 ? 0xa0 : 0x80;
+        high = s[0] == 0xed ? 0x9f : 0xbf;
+    } else if (s[0] >= 0xf0 && s[0] <= 0xf4) {
+        length = 4;
+        low = s[0] == 0xf0 ? 0x90 : 0x80;
+        high = s[0] == 0xf4 ? 0x8f : 0xbf;
+    } else {
+        return 0;
+    }
+
+    if (size < length || s[1] < low || s[1] > high) {
+        return 0;
+    }
+    for (size_t i = 2; i < length; i++) {
+        if ((s[i] & 0xc0) != 0x80) {
+            return 0;
+        }
+    }
+
+    return length;
+}
+
+char32_t Utf8::decode(std::string_view text, size_t offset, size_t& length) {
+    auto s = reinterpret_cast<const unsigned char*>(text.data() + offset);
+    length = sequence(text.data() + offset, text.size() - offset);
+    switch (length) {
+    case 1:
+        return s[0];
+    case 2:
+        return (s[0] & 0x1f) << 6 | (s[1] & 0x3f);
+    case 3:
+        return (s[0] & 0x0f) << 12 | (s[1] & 0x3f) << 6 | (s[2] & 0x3f);
+    case 4:
+        return (s[0] & 0x07) << 18 | (s[1] & 0x3f) << 12 | (s[2] & 0x3f) << 6 | (s[3] & 0x3f);
+    }
+
+    length = 1;
+    return replacement;
+}
+
+// extended grapheme clusters by the UAX #29 rules GB3 to GB13, with Prepend
+// left out
+size_t Utf8::next(std::string_view text, size_t offset) {
+    if (offset >= text.size()) {
+        return text.size();
+    }
+    // ASCII other than CR never joins with an ASCII byte after it
+    auto s = reinterpret_cast<const unsigned char*>(text.data());
+    if (s[offset] < 0x80 && s[offset] != '\r' && (offset + 1 == text.size() || s[offset + 1] < 0x80)) {
+        return offset + 1;
+    }
+
+    size_t length;
+    auto before = property(decode(text, offset, length));
+    offset += length;
+    // GB11 joins a pictograph after ZWJ only when the cluster so far is a pictograph and its extenders
+    bool pictograph = before == Pictographic;
+    size_t regional = before == RegionalIndicator;
+    while (offset < text.size()) {
+        auto after = property(decode(text, offset, length));
+
+        bool join;
+        if (before == CR && after == LF) {
+            join = true;
+        } else if (before == CR || before == LF || before == Control || after == CR || after == LF || after == Control) {
+            join = false;
+        } else if (after == Extend || after == ZWJ || after == SpacingMark) {
+            join = true;
+        } else if (before == L) {
+            join = after == L || after == V || after == LV || after == LVT;
+        } else if ((before == LV || before == V) && (after == V || after == T)) {
+            join = true;
+        } else if ((before == LVT || before == T) && after == T) {
+            join = true;
+        } else if (before == ZWJ && after == Pictographic) {
+            join = pictograph;
+        } else if (before == RegionalIndicator && after == RegionalIndicator) {
+            join = regional % 2 == 1;
+        } else {
+            join = false;
+        }
+
+        if (!join) {
+            break;
+        }
+
+        pictograph = after == Pictographic || (pictograph && (after == Extend || after == ZWJ));
+        regional = after == RegionalIndicator ? regional + 1 : 0;
+        before = after;
+        offset += length;
+    }
+
+    return offset;
+}
+
+void Utf8::graphemes(std::string_view text, std::vector<uint32_t>& bounds) {
+    bounds.push_back(0);
+    for (size_t i = 0; i < text.size(); ) {
+        i = next(text, i);
+        bounds.push_back(static_cast<uint32_t>(i));
+    }
+}
+
+size_t Utf8::columns(std::string_view text, size_t offset) {
+    offset = std::min(offset, text.size());
+    size_t result = 0;
+    for (size_t i = 0; i < offset; result++) {
+        i = next(text, i);
+    }
+
+    return result;
+}
\ No newline at end of file
@@ -17,7 +17,9 @@
 #include "Tools.h"
 #include "vulkan/vulkan_core.h"
 #include <cassert>
+#include <cctype>
 #include <cerrno>
+#include <charconv>
 #include <cmath>
 #include <format>
 #include <cstddef>
@@ -27,6 +29,7 @@
 #include <cstring>
 #include <iterator>
 #include <limits>
+#include <map>
 #include <memory>
 #include <stdexcept>
 #include <iostream>
@@ -46,6 +49,40 @@
 #include "LineNumber.h"
 #include "Grammar.h"
 
+namespace {
+
+// the whole of text as a number, false when it isn't one or doesn't fit
+template <typename T>
+bool number(std::string_view text, T& value) {
+    auto end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, value);
+    return !text.empty() && result.ec == std::errc() && result.ptr == end;
+}
+
+// "a b" or "a" as 0-based lines in order, clamped to a document of lines lines
+bool lineRange(std::string_view arg, size_t lines, int32_t& first, int32_t& last) {
+    auto space = arg.find(' ');
+    uint64_t a = 0;
+    uint64_t b = 0;
+    if (!number(arg.substr(0, space), a)) {
+        return false;
+    }
+    if (space == std::string_view::npos) {
+        b = a;
+    } else if (!number(arg.substr(space + 1), b)) {
+        return false;
+    }
+    if (a > b) {
+        std::swap(a, b);
+    }
+
+    first = static_cast<int32_t>(std::clamp<uint64_t>(a, 1, lines) - 1);
+    last = static_cast<int32_t>(std::clamp<uint64_t>(b, 1, lines) - 1);
+    return true;
+}
+
+}
+
 Vulkan::Vulkan(const std::string& title, uint32_t width, uint32_t height) : width_(width), height_(height), title_(title) {
     camera_ = std::make_shared<Camera>();
     initWindow();
@@ -56,6 +93,9 @@ Vulkan::Vulkan(const std::string& title, uint32_t width, uint32_t height) : widt
 void Vulkan::run() {
     while (!glfwWindowShouldClose(windows_)) {
         glfwPollEvents();
+        if (editor_->update()) {
+            lineNumber_->adjust(*editor_);
+        }
         static unsigned long long prev = Timer::nowMilliseconds();
         draw();
         auto curr = Timer::nowMilliseconds();
@@ -496,9 +536,9 @@ void Vulkan::createTextDescriptorSet() {
 
     
     std::vector<VkDescriptorImageInfo> imageInfos(dictionary_.size());
-    for (uint32_t i = 0; i < 128; i++) {
-        char c = static_cast<char>(i);
-        imageInfos[i].imageView = dictionary_[c].image_->view();
+    for (auto& [c, character] : dictionary_) {
+        auto i = character.index_;
+        imageInfos[i].imageView = character.image_->view();
         imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
         imageInfos[i].sampler = canvasSampler_->sampler();
     }
@@ -1166,7 +1206,7 @@ void Vulkan::recordCommadBuffer(VkCommandBuffer commandBuffer, uint32_t imageInd
         }
 
         // line number
-        if (lineNumber_->wordCount_ > 0) {
+        if (lineNumber_->wordCount_ > 0 && gutter() > 0) {
             renderTargets_["lineNumber"]->render(commandBuffer, lineNumberVertexBuffer_, lineNumberIndexBuffer_);
         }
 
@@ -1418,9 +1458,16 @@ void Vulkan::generateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWid
 void Vulkan::loadChars() {
     font_ = std::make_shared<Font>(fontPath_.c_str(), 20);
 
+    std::vector<char32_t> codes;
+    for (auto [first, last] : glyphRanges_) {
+        for (auto c = first; c <= last; c++) {
+            codes.push_back(c);
+        }
+    }
+
     uint32_t height = 0;
-    for (uint32_t i = 0; i < 128; i++) {
-        char c = static_cast<char>(i);
+    for (uint32_t i = 0; i < codes.size(); i++) {
+        auto c = codes[i];
         font_->loadChar(c);
         auto& currentChar = dictionary_[c];
 
@@ -1434,11 +1481,11 @@ void Vulkan::loadChars() {
         height = std::max(height, static_cast<uint32_t>(texHeight));
 
         if (pixel == nullptr) {
-            texWidth = dictionary_.at(static_cast<char>(0)).width_;
-            texHeight = dictionary_.at(static_cast<char>(0)).height_;
-            offsetX = dictionary_.at(static_cast<char>(0)).offsetX_;
-            offsetY = dictionary_.at(static_cast<char>(0)).offsetY_;
-            advance = dictionary_.at(static_cast<char>(0)).advance_;
+            texWidth = dictionary_.at(0).width_;
+            texHeight = dictionary_.at(0).height_;
+            offsetX = dictionary_.at(0).offsetX_;
+            offsetY = dictionary_.at(0).offsetY_;
+            advance = dictionary_.at(0).advance_;
             size = texWidth * texHeight * 1;
         }
 
@@ -1531,16 +1578,37 @@ void Vulkan::updateDrawAssets() {
 
             auto limit = editor_->showLimit();
 
-            auto text = std::vector<std::string>(editor_->lines_.begin() + limit.up_, editor_->lines_.begin() + limit.bottom_);
             // for (auto& s : text) {
             //     std::cout << s << std::endl;
             // }
             // auto s = Timer::nowMilliseconds();
             glm::ivec2 xy;
-            xy.x = -static_cast<float>(swapChain_->width()) / 2.0f + lineNumber_->lineNumberOffset_ * font_->advance_;
+            xy.x = -static_cast<float>(swapChain_->width()) / 2.0f + gutter() * font_->advance_;
             xy.y = static_cast<float>(swapChain_->height()) / 2.0f - editor_->lineHeight_;
 
-            auto t = font_->genTextLines(xy.x, xy.y, editor_->lineHeight_, text, dictionary_, grammar_.get());
+            std::pair<std::vector<Font::Point>, std::vector<uint32_t>> t;
+            if (editor_->hex_) {
+                Font::genHexRows(xy.x, xy.y, editor_->lineHeight_, *editor_->hex_, limit.up_, limit.bottom_, dictionary_, t);
+            } else if (editor_->wrapped() || editor_->folded()) {
+                // only the lines on screen are fetched, not the ones folds
+                // hide between them; a folded line tells how many it hides
+                std::vector<std::string> text;
+                std::vector<std::pair<size_t, int32_t>> rows;
+                auto width = editor_->wrapped() ? static_cast<int32_t>(editor_->wrap_.width()) : INT32_MAX;
+                for (auto& row : editor_->showRows()) {
+                    if (row.row_ == 0 || text.empty()) {
+                        text.push_back(editor_->line(row.line_));
+                        if (auto hidden = editor_->foldedAt(row.line_); hidden > 0) {
+                            text.back() += std::format(" ... {} lines", hidden);
+                        }
+                    }
+                    rows.emplace_back(text.size() - 1, row.row_ * width);
+                }
+                t = Font::genTextRows(xy.x, xy.y, editor_->lineHeight_, text, rows, width, dictionary_, grammar_.get(), editor_->tabWidth_);
+            } else {
+                auto text = editor_->lines(limit.up_, limit.bottom_);
+                t = font_->genTextLines(xy.x, xy.y, editor_->lineHeight_, text, dictionary_, grammar_.get(), editor_->tabWidth_);
+            }
             t = Font::merge(t, animationPoints);
             // std::cout << std::format("generate vertices ms: {}\n", e - s);
             textVertices_ = t.first;
@@ -1602,9 +1670,11 @@ void Vulkan::updateDrawAssets() {
         // auto e = Timer::nowMilliseconds();
         // std::cout << std::format("create text buffer ms: {}\n", e - s); 
 
+        // cheap now that labels are formatted on demand; keeps up with a paged file still being indexed
+        lineNumber_->adjust(*editor_);
         if (lineNumber_->wordCount_ > 0) {
             // std::cout << lineNumber_->limit_.up_ << ", " << lineNumber_->limit_.bottom_ << std::endl;
-            auto text = std::vector<std::string>(lineNumber_->lines_.begin() + lineNumber_->showLimit().up_, lineNumber_->lines_.begin() + lineNumber_->showLimit().bottom_);
+            auto text = lineNumber_->showLines();
             auto t = font_->genTextLines(-static_cast<float>(swapChain_->width()) / 2.0f, static_cast<float>(swapChain_->height()) / 2.0f - lineNumber_->lineHeight_, editor_->lineHeight_, text, dictionary_, grammar_.get());
 
             lineNumberVertices_ = t.first;
@@ -1743,6 +1813,7 @@ void Vulkan::updateDrawAssets() {
                 default:
                     currModeName_ = "Unknown";
             }
+            currModeName_ = editor_->status() + "  " + currModeName_;
 
             glm::ivec2 xy;
             xy.x = static_cast<float>(swapChain_->width()) / 2.0f - currModeName_.size() * font_->advance_;
@@ -1827,7 +1898,7 @@ void Vulkan::updateDrawAssets() {
 
             glm::ivec2 xy;
             if (editor_->mode_ == Editor::Mode::Insert || editor_->mode_ == Editor::Mode::General) {
-                xy = editor_->cursorRenderPos(lineNumber_->lineNumberOffset_ * font_->advance_, font_->advance_);
+                xy = editor_->cursorRenderPos(gutter() * font_->advance_, font_->advance_);
             } else {
                 xy = commandLine_->cursorRenderPos(font_->advance_);
             }
@@ -1835,6 +1906,19 @@ void Vulkan::updateDrawAssets() {
             cursorVertices_ = t.first;
             cursorIndices_ = t.second;
 
+            // the other cursors on screen, one more quad each
+            if (editor_->mode_ == Editor::Mode::Insert || editor_->mode_ == Editor::Mode::General) {
+                for (auto pos : editor_->visibleCursors()) {
+                    auto other = editor_->renderPos(pos, gutter() * font_->advance_, font_->advance_);
+                    auto quad = canvas_->vertices(other.x, other.y, 2.0f, editor_->lineHeight_, cursorColor);
+                    auto base = static_cast<uint32_t>(cursorVertices_.size());
+                    cursorVertices_.insert(cursorVertices_.end(), quad.first.begin(), quad.first.end());
+                    for (auto index : quad.second) {
+                        cursorIndices_.push_back(base + index);
+                    }
+                }
+            }
+
             VkDeviceSize size = sizeof(cursorVertices_[0]) * cursorVertices_.size();
 
             cursorVertexBuffer_->size_ = size;
@@ -2082,6 +2166,11 @@ void Vulkan::endSingleTimeCommands(VkCommandBuffer commandBuffer, VkQueue queue)
     vkFreeCommandBuffers(device_, commandPool_->commanddPool(), 1, &commandBuffer);
 }
 
+// columns taken by line numbers; the hex view shows offsets instead
+int32_t Vulkan::gutter() const {
+    return editor_->hex_ ? 0 : lineNumber_->lineNumberOffset_;
+}
+
 void Vulkan::updateTexture() {
     createCanvasDescriptorSet();
 }
@@ -2123,6 +2212,34 @@ void Vulkan::inputGeneral(int key, int scancode, int mods) {
         return ;
     }
 
+    if (key == GLFW_KEY_ESCAPE) {
+        editor_->clearCursors();
+        return ;
+    }
+
+    if (mods == GLFW_MOD_CONTROL) {
+        if (key == 'Z') {
+            editor_->undo();
+        }
+        if (key == 'Y') {
+            editor_->redo();
+        }
+
+        lineNumber_->adjust(*editor_);
+        return ;
+    }
+
+    // step through the matches of the last find
+    if (key == 'N') {
+        auto xy = mods == GLFW_MOD_SHIFT ? editor_->searchPrev() : editor_->searchNext();
+        if (xy.x != -1) {
+            editor_->setCursor(xy);
+        }
+
+        lineNumber_->adjust(*editor_);
+        return ;
+    }
+
     editor_->moveCursor(static_cast<Editor::Direction>(key));
     lineNumber_->adjust(*editor_);
 }
@@ -2155,6 +2272,12 @@ void Vulkan::inputInsert(int key, int scancode, int mods) {
         if (key == GLFW_KEY_ENTER) {
             editor_->newLine();
         }
+        if (key == 'Z') {
+            editor_->undo();
+        }
+        if (key == 'Y') {
+            editor_->redo();
+        }
 
         lineNumber_->adjust(*editor_);
     } else {
@@ -2193,7 +2316,7 @@ void Vulkan::inputInsert(int key, int scancode, int mods) {
                 editor_->insertChar(c);
             }
         } else if (key == GLFW_KEY_TAB) {
-            editor_->insertStr("    ");
+            editor_->insertChar('\t');
         } else {
             editor_->moveCursor(static_cast<Editor::Direction>(key));
         }
@@ -2205,6 +2328,7 @@ void Vulkan::inputInsert(int key, int scancode, int mods) {
 void Vulkan::inputCommand(int key, int scancode, int mods) {
     if (key == GLFW_KEY_ESCAPE) {
         commandLine_->clear();
+        previewCmd();
         editor_->mode_ = Editor::Mode::General;
         return ;
     }
@@ -2216,7 +2340,9 @@ void Vulkan::inputCommand(int key, int scancode, int mods) {
         capsLock_ ^= 1;
     } else if (key == GLFW_KEY_ENTER) {
         auto cmd = commandLine_->enter();
+        searchOrigin_ = {-1, -1};
         processCmd(cmd);
+        return ;
     } else if (key >= 0 && key <= 127) {
         if (mods == GLFW_MOD_SHIFT) {
             c = Tools::charToShiftChar(Tools::keyToChar(key));
@@ -2234,10 +2360,82 @@ void Vulkan::inputCommand(int key, int scancode, int mods) {
     } else {
         commandLine_->moveCursor(static_cast<Editor::Direction>(key));
     }
+
+    previewCmd();
+}
+
+// jumps to the first match while a find command is being typed
+void Vulkan::previewCmd() {
+    auto command = Tools::rmFrontSpace(commandLine_->enter());
+    if (command.rfind("find ", 0) != 0) {
+        if (searchOrigin_.x != -1) {
+            editor_->setCursor(searchOrigin_);
+            lineNumber_->adjust(*editor_);
+            searchOrigin_ = {-1, -1};
+        }
+        return ;
+    }
+
+    if (searchOrigin_.x == -1) {
+        searchOrigin_ = editor_->cursorPos_;
+    }
+
+    editor_->setCursor(searchOrigin_);
+    auto xy = editor_->searchStr(Tools::rmSpace(command.substr(5)));
+    if (xy.x != -1) {
+        editor_->setCursor(xy);
+    }
+    lineNumber_->adjust(*editor_);
 }
 
 void Vulkan::processCmd(std::string command) {
     command = Tools::rmFrontSpace(command);
+
+    // s/pattern/replacement/, \/ stands for a / in either part
+    if (command.starts_with("s/")) {
+        std::vector<std::string> parts(1);
+        for (size_t k = 2; k < command.size(); k++) {
+            if (command[k] == '\\' && k + 1 < command.size() && command[k + 1] == '/') {
+                parts.back() += '/';
+                k++;
+            } else if (command[k] == '/') {
+                parts.emplace_back();
+            } else {
+                parts.back() += command[k];
+            }
+        }
+
+        if (parts.size() >= 2 && editor_->substitute(parts[0], parts[1]) >= 0) {
+            commandLine_->clear();
+            editor_->setMode(Editor::Mode::General);
+            lineNumber_->adjust(*editor_);
+        }
+        return ;
+    }
+    // 10,200sort limits a line command to lines 10 to 200, 10sort is line 10
+    int32_t first = 0, last = -1;
+    if (!command.empty() && std::isdigit(static_cast<unsigned char>(command.front()))) {
+        auto begin = command.data();
+        auto end = begin + command.size();
+        uint64_t a = 0;
+        auto result = std::from_chars(begin, end, a);
+        auto b = a;
+        if (result.ec == std::errc() && result.ptr < end && *result.ptr == ',') {
+            result = std::from_chars(result.ptr + 1, end, b);
+        }
+        if (a > b) {
+            std::swap(a, b);
+        }
+        // 5,sort, line 0, a number past 64 bits or lines past the end are no range
+        auto lines = editor_->lineCount();
+        if (result.ec != std::errc() || a == 0 || a > lines) {
+            return ;
+        }
+        first = static_cast<int32_t>(a - 1);
+        last = static_cast<int32_t>(std::min<uint64_t>(b, lines) - 1);
+        command = command.substr(result.ptr - begin);
+    }
+
     std::string cmd, arg;
     size_t i = 0;
     for ( ; i < command.size(); i++) {
@@ -2253,10 +2451,30 @@ void Vulkan::processCmd(std::string command) {
     }
     arg = Tools::rmSpace(arg);
 
-    if (cmd == "go") {
-        auto number = std::stoi(arg) - 1;
-        if (number >= 0 && number < editor_->lines_.size()) {
-            editor_->setCursor({0, number});
+    // go 120 is a line, go @4096 a byte offset, go 50% a share of the bytes
+    if (cmd == "go" && !arg.empty()) {
+        glm::ivec2 xy = {-1, -1};
+        auto size = editor_->stats().bytes_;
+        std::string_view text = arg;
+        if (text.front() == '@') {
+            size_t offset = 0;
+            if (number(text.substr(1), offset) && offset <= size) {
+                xy = editor_->position(offset);
+            }
+        } else if (text.back() == '%') {
+            double percent = 0.0;
+            if (number(text.substr(0, text.size() - 1), percent) && percent >= 0.0 && percent <= 100.0) {
+                xy = editor_->position(static_cast<size_t>(size * percent / 100.0));
+            }
+        } else {
+            size_t line = 0;
+            if (number(text, line) && line >= 1 && line <= editor_->lineCount()) {
+                xy = {0, static_cast<int32_t>(line - 1)};
+            }
+        }
+
+        if (xy.x != -1) {
+            editor_->setCursor(xy);
             lineNumber_->adjust(*editor_);
             commandLine_->clear();
             
@@ -2264,6 +2482,63 @@ void Vulkan::processCmd(std::string command) {
         }
     }
 
+    // a cursor at every match of the last find, or on every line in a range
+    if (cmd == "cursors") {
+        int32_t first = 0;
+        int32_t last = 0;
+        if (arg.empty()) {
+            editor_->addCursorsAtMatches();
+        } else if (lineRange(arg, editor_->lineCount(), first, last)) {
+            editor_->addCursorsOnLines(first, last);
+        } else {
+            return ;
+        }
+        commandLine_->clear();
+        editor_->setMode(Editor::Mode::Insert);
+    }
+
+    // wrap, wrap on or wrap off: long lines go on in rows below
+    if (cmd == "wrap") {
+        editor_->setWrap(arg.empty() ? !editor_->wrapping_ : arg == "on");
+        lineNumber_->adjust(*editor_);
+        commandLine_->clear();
+        editor_->setMode(Editor::Mode::General);
+    }
+
+    // fold opens the folds on the cursor's line or closes the one around it,
+    // fold a b folds lines a to b, unfold opens every fold
+    if (cmd == "fold") {
+        int32_t first = 0;
+        int32_t last = 0;
+        if (arg.empty()) {
+            editor_->toggleFold();
+        } else if (lineRange(arg, editor_->lineCount(), first, last)) {
+            editor_->fold(first, last);
+        } else {
+            return ;
+        }
+        lineNumber_->adjust(*editor_);
+        commandLine_->clear();
+        editor_->setMode(Editor::Mode::General);
+    }
+
+    if (cmd == "unfold") {
+        editor_->unfold();
+        lineNumber_->adjust(*editor_);
+        commandLine_->clear();
+        editor_->setMode(Editor::Mode::General);
+    }
+
+    // columns a tab reaches to
+    if (cmd == "tab" && !arg.empty()) {
+        int32_t width = 0;
+        if (number(arg, width) && width > 0 && width <= Editor::maxTabWidth_) {
+            editor_->setTabWidth(width);
+            commandLine_->clear();
+            editor_->setMode(Editor::Mode::General);
+        }
+    }
+
     if (cmd == "sys") {
         commandLine_->exectue(arg);
         commandLine_->clear();
@@ -2281,6 +2556,21 @@ void Vulkan::processCmd(std::string command) {
         }
     }
 
+    // written over a change another process made to the file
+    if (cmd == "save!") {
+        if (editor_->save(arg.empty() ? editor_->fileName_ : arg, true)) {
+            commandLine_->clear();
+        }
+    }
+
+    // the file as it is on disk, unsaved edits dropped
+    if (cmd == "reload" && !editor_->fileName_.empty()) {
+        editor_->reopen();
+        lineNumber_->adjust(*editor_);
+        commandLine_->clear();
+        editor_->setMode(Editor::Mode::General);
+    }
+
     if (cmd == "find") {
         auto xy = editor_->searchStr(arg);
         if (xy.x != -1) {
@@ -2297,6 +2587,63 @@ void Vulkan::processCmd(std::string command) {
         commandLine_->clear();
     }
 
+    // read-only, and kept up to date as the file grows
+    if (cmd == "follow" && !arg.empty()) {
+        editor_->follow(arg);
+        lineNumber_->adjust(*editor_);
+        commandLine_->clear();
+        editor_->setMode(Editor::Mode::General);
+    }
+
+    // the file as offset, hex and ASCII columns, whatever it holds
+    if (cmd == "hex" && !arg.empty()) {
+        editor_->hex(arg);
+        lineNumber_->adjust(*editor_);
+        commandLine_->clear();
+        editor_->setMode(Editor::Mode::General);
+    }
+
+    // the file, or the open one without an argument, as aligned columns; again
+    // without an argument goes back to the text
+    if (cmd == "table") {
+        if (arg.empty()) {
+            editor_->table(editor_->table_ == nullptr);
+        } else {
+            editor_->table(arg);
+        }
+        lineNumber_->adjust(*editor_);
+        commandLine_->clear();
+        editor_->setMode(Editor::Mode::General);
+    }
+
+    // order 3 desc sorts the table's rows by the third column, order name by
+    // the column headed name
+    if (cmd == "order" && !arg.empty()) {
+        auto descending = arg.ends_with(" desc");
+        if (editor_->sortTable(descending ? arg.substr(0, arg.size() - 5) : arg, descending)) {
+            lineNumber_->adjust(*editor_);
+            commandLine_->clear();
+            editor_->setMode(Editor::Mode::General);
+        }
+    }
+
+    // whole lines of the buffer or of the range, replaced in one undo step
+    static const std::map<std::string, LineOps::Op> lineOps = {
+        {"sort", LineOps::Sort},
+        {"uniq", LineOps::Uniq},
+        {"grep", LineOps::Grep},
+        {"vgrep", LineOps::VGrep},
+        {"reverse", LineOps::Reverse},
+    };
+    auto lineOp = lineOps.find(cmd);
+    if (lineOp != lineOps.end() && (!arg.empty() || (lineOp->second != LineOps::Grep && lineOp->second != LineOps::VGrep))) {
+        if (editor_->lineOp(lineOp->second, arg, first, last) >= 0) {
+            lineNumber_->adjust(*editor_);
+            commandLine_->clear();
+            editor_->setMode(Editor::Mode::General);
+        }
+    }
+
     if (cmd == "load") {
         if (canvasImages_.find(arg) != canvasImages_.end()) {
             canvasTextureName_ = arg;
@@ -0,0 +1,277 @@
+#include "WrapIndex.h"
+#include "Utf8.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+void WrapIndex::assign(const std::vector<uint32_t>& columns, uint32_t width) {
+    width_ = std::max(width, 1u);
+    blocks_.clear();
+    for (size_t i = 0; i < columns.size(); i += blockLines_) {
+        auto& block = blocks_.emplace_back();
+        block.columns_.assign(columns.begin() + i, columns.begin() + std::min(i + blockLines_, columns.size()));
+        block.rows_ = count(block);
+    }
+    rebuild();
+}
+
+void WrapIndex::setWidth(uint32_t width) {
+    width = std::max(width, 1u);
+    if (width == width_) {
+        return ;
+    }
+
+    width_ = width;
+    for (auto& block : blocks_) {
+        block.rows_ = count(block);
+    }
+    rebuild();
+}
+
+// the lines from the one holding the start to the one holding the end are
+// taken out with what replaces them and cut into blocks again; a block left
+// with few lines takes in the next one. Only a change of the blocks rebuilds
+// the trees, a change within one block is a point update
+void WrapIndex::splice(size_t line, size_t erase, const std::vector<uint32_t>& columns) {
+    if (blocks_.empty()) {
+        assign(columns, width_);
+        return ;
+    }
+
+    line = std::min(line, lines_);
+    erase = std::min(erase, lines_ - line);
+    auto [first, begin] = find(line);
+    auto [last, end] = find(line + erase);
+    if (end == 0 && last > first) {
+        last--;
+        end = blocks_[last].columns_.size();
+    }
+    if (first == last && erase == columns.size()) {
+        auto& block = blocks_[first];
+        int64_t delta = 0;
+        for (size_t i = 0; i < columns.size(); i++) {
+            delta += static_cast<int64_t>(rowsOf(columns[i])) - rowsOf(block.columns_[begin + i]);
+            block.columns_[begin + i] = columns[i];
+        }
+        block.rows_ += delta;
+        rows_ += delta;
+        add(rowTree_, first, delta);
+        return ;
+    }
+
+    std::vector<uint32_t> merged(blocks_[first].columns_.begin(), blocks_[first].columns_.begin() + begin);
+    merged.insert(merged.end(), columns.begin(), columns.end());
+    merged.insert(merged.end(), blocks_[last].columns_.begin() + end, blocks_[last].columns_.end());
+    if (merged.size() < blockLines_ / 4 && last + 1 < blocks_.size()) {
+        last++;
+        merged.insert(merged.end(), blocks_[last].columns_.begin(), blocks_[last].columns_.end());
+    }
+
+    auto pieces = merged.size() <= 2 * blockLines_ ? std::min<size_t>(merged.size(), 1) : merged.size() / blockLines_;
+    if (first == last && pieces == 1) {
+        auto& block = blocks_[first];
+        int64_t lines = static_cast<int64_t>(merged.size()) - block.columns_.size();
+        int64_t rows = -static_cast<int64_t>(block.rows_);
+        block.columns_ = std::move(merged);
+        block.rows_ = count(block);
+        rows += block.rows_;
+        lines_ += lines;
+        rows_ += rows;
+        add(lineTree_, first, lines);
+        add(rowTree_, first, rows);
+        return ;
+    }
+
+    std::vector<Block> replaced(pieces);
+    for (size_t i = 0; i < pieces; i++) {
+        auto from = merged.size() * i / pieces;
+        auto to = merged.size() * (i + 1) / pieces;
+        replaced[i].columns_.assign(merged.begin() + from, merged.begin() + to);
+        replaced[i].rows_ = count(replaced[i]);
+    }
+    blocks_.erase(blocks_.begin() + first, blocks_.begin() + last + 1);
+    blocks_.insert(blocks_.begin() + first, std::make_move_iterator(replaced.begin()), std::make_move_iterator(replaced.end()));
+    rebuild();
+}
+
+void WrapIndex::clear() {
+    blocks_.clear();
+    rebuild();
+}
+
+size_t WrapIndex::lines() const {
+    return lines_;
+}
+
+size_t WrapIndex::rows() const {
+    return rows_;
+}
+
+uint32_t WrapIndex::width() const {
+    return width_;
+}
+
+uint32_t WrapIndex::columns(size_t line) const {
+    auto [block, at] = find(line);
+
+    return blocks_[block].columns_[at];
+}
+
+uint32_t WrapIndex::height(size_t line) const {
+    return rowsOf(columns(line));
+}
+
+size_t WrapIndex::rowOf(size_t line) const {
+    if (line >= lines_) {
+        return rows_;
+    }
+
+    auto [block, at] = find(line);
+    auto row = prefix(rowTree_, block);
+    for (size_t i = 0; i < at; i++) {
+        row += rowsOf(blocks_[block].columns_[i]);
+    }
+
+    return row;
+}
+
+std::pair<size_t, uint32_t> WrapIndex::lineAt(size_t row) const {
+    auto rest = std::min(row, rows_ - 1);
+    auto block = descend(rowTree_, rest);
+    auto line = prefix(lineTree_, block);
+    auto& columns = blocks_[block].columns_;
+    size_t i = 0;
+    for (; i + 1 < columns.size() && rest >= rowsOf(columns[i]); i++) {
+        rest -= rowsOf(columns[i]);
+    }
+
+    return {line + i, static_cast<uint32_t>(rest)};
+}
+
+uint32_t WrapIndex::measure(std::string_view line, int32_t tabWidth) {
+    // most lines are plain ASCII without tabs, a byte a column
+    uint8_t special = 0;
+    for (auto c : line) {
+        special |= (static_cast<uint8_t>(c) & 0x80) | (c == '\t');
+    }
+    if (special == 0) {
+        return static_cast<uint32_t>(line.size());
+    }
+
+    uint32_t column = 0;
+    for (size_t i = 0; i < line.size(); ) {
+        if (line[i] == '\t') {
+            column += tabWidth - column % tabWidth;
+            i++;
+        } else {
+            column++;
+            i = Utf8::next(line, i);
+        }
+    }
+
+    return column;
+}
+
+// a line split between pieces is gathered in a copy, the rest are measured
+// where they are
+void WrapIndex::measure(const std::vector<std::string_view>& pieces, int32_t tabWidth, std::vector<uint32_t>& columns) {
+    std::string carry;
+    for (auto piece : pieces) {
+        while (!piece.empty()) {
+            auto feed = static_cast<const char*>(std::memchr(piece.data(), '\n', piece.size()));
+            if (feed == nullptr) {
+                carry.append(piece);
+                break;
+            }
+
+            auto line = piece.substr(0, feed - piece.data());
+            if (carry.empty()) {
+                columns.push_back(measure(line, tabWidth));
+            } else {
+                carry.append(line);
+                columns.push_back(measure(carry, tabWidth));
+                carry.clear();
+            }
+            piece.remove_prefix(line.size() + 1);
+        }
+    }
+    columns.push_back(measure(carry, tabWidth));
+}
+
+uint32_t WrapIndex::rowsOf(uint32_t columns) const {
+    return columns == 0 ? 1 : (columns - 1) / width_ + 1;
+}
+
+size_t WrapIndex::count(const Block& block) const {
+    size_t rows = 0;
+    for (auto columns : block.columns_) {
+        rows += rowsOf(columns);
+    }
+
+    return rows;
+}
+
+std::pair<size_t, size_t> WrapIndex::find(size_t line) const {
+    if (line >= lines_) {
+        return {blocks_.size() - 1, blocks_.back().columns_.size()};
+    }
+
+    auto rest = line;
+    auto block = descend(lineTree_, rest);
+
+    return {block, rest};
+}
+
+// linear: every node takes in its own block, then passes its sum up
+void WrapIndex::rebuild() {
+    lineTree_.assign(blocks_.size() + 1, 0);
+    rowTree_.assign(blocks_.size() + 1, 0);
+    lines_ = rows_ = 0;
+    for (size_t i = 1; i <= blocks_.size(); i++) {
+        lineTree_[i] += blocks_[i - 1].columns_.size();
+        rowTree_[i] += blocks_[i - 1].rows_;
+        lines_ += blocks_[i - 1].columns_.size();
+        rows_ += blocks_[i - 1].rows_;
+        auto parent = i + (i & (~i + 1));
+        if (parent <= blocks_.size()) {
+            lineTree_[parent] += lineTree_[i];
+            rowTree_[parent] += rowTree_[i];
+        }
+    }
+}
+
+void WrapIndex::add(std::vector<size_t>& tree, size_t block, int64_t delta) {
+    for (auto i = block + 1; i < tree.size(); i += i & (~i + 1)) {
+        tree[i] += delta;
+    }
+}
+
+// the sum over the blocks before block
+size_t WrapIndex::prefix(const std::vector<size_t>& tree, size_t block) const {
+    size_t sum = 0;
+    for (auto i = block; i > 0; i -= i & (~i + 1)) {
+        sum += tree[i];
+    }
+
+    return sum;
+}
+
+// the block where the sum passes rest, which is left as the part of the sum
+// inside it; rest is less than the total
+size_t WrapIndex::descend(const std::vector<size_t>& tree, size_t& rest) const {
+    auto size = tree.size() - 1;
+    size_t at = 0;
+    size_t step = 1;
+    while (step * 2 <= size) {
+        step *= 2;
+    }
+    for (; step > 0; step /= 2) {
+        if (at + step <= size && tree[at + step] <= rest) {
+            at += step;
+            rest -= tree[at];
+        }
+    }
+
+    return at;
+}
\ No newline at end of file
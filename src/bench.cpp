@@ -0,0 +1,782 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <regex>
+#include <thread>
+#include <string>
+#include <vector>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "CsvTable.h"
+#include "Editor.h"
+#include "LineOps.h"
+#include "Lz.h"
+#include "MappedFile.h"
+#include "PieceTable.h"
+#include "Regex.h"
+#include "SaveEngine.h"
+#include "Substitute.h"
+#include "TextScan.h"
+#include "TextSearch.h"
+#include "Transcode.h"
+#include "Utf8.h"
+
+namespace {
+
+double seconds(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+void report(const std::string& name, size_t bytes, double seconds) {
+    printf("%-44s %10.1f MB/s  (%.3f s)\n", name.c_str(), bytes / 1048576.0 / seconds, seconds);
+}
+
+std::string genLog(size_t bytes) {
+    std::string text;
+    text.reserve(bytes + 128);
+    size_t n = 0;
+    while (text.size() < bytes) {
+        text += "2024-01-01 12:00:00.000 INFO  [worker-";
+        text += std::to_string(n % 16);
+        text += "] request ";
+        text += std::to_string(n);
+        text += " handled in ";
+        text += std::to_string(n % 997);
+        text += " ms\n";
+        n++;
+    }
+
+    return text;
+}
+
+std::filesystem::path genFile(size_t megabytes) {
+    auto path = std::filesystem::temp_directory_path() / ("editor_bench_" + std::to_string(megabytes) + "mb.log");
+    if (std::filesystem::exists(path) && std::filesystem::file_size(path) >= megabytes << 20) {
+        return path;
+    }
+
+    auto chunk = genLog(16 << 20);
+    std::ofstream file(path, std::ios::binary);
+    for (size_t written = 0; written < (megabytes << 20); written += chunk.size()) {
+        file.write(chunk.data(), chunk.size());
+    }
+
+    return path;
+}
+
+void benchLoad() {
+    for (size_t megabytes : {10, 100, 1024}) {
+        auto path = genFile(megabytes);
+        auto bytes = std::filesystem::file_size(path);
+        printf("-- %zu MB\n", megabytes);
+
+        if (megabytes <= 100) {
+            auto begin = std::chrono::steady_clock::now();
+            std::ifstream file(path);
+            std::vector<std::string> lines;
+            std::string line;
+            while (std::getline(file, line)) {
+                lines.push_back(line);
+            }
+            report("getline into vector<string>", bytes, seconds(begin));
+        }
+
+        {
+            auto begin = std::chrono::steady_clock::now();
+            auto file = std::make_shared<MappedFile>(path.string());
+            PieceTable document(file, file->view());
+            report("mmap + piece table", bytes, seconds(begin));
+            printf("%-44s %10zu\n", "lines", document.lineCount());
+        }
+
+        {
+            auto file = std::make_shared<MappedFile>(path.string());
+            std::vector<size_t> starts;
+            auto begin = std::chrono::steady_clock::now();
+            TextScan::lineStarts(file->data(), file->size(), 0, starts);
+            report(TextScan::avx2() ? "newline scan (avx2)" : "newline scan (sse2)", bytes, seconds(begin));
+        }
+
+        std::filesystem::remove(path);
+    }
+}
+
+void benchSave() {
+    auto text = genLog(256 << 20);
+    auto path = (std::filesystem::temp_directory_path() / "editor_bench_save.log").string();
+
+    {
+        std::vector<std::string> lines;
+        size_t pos = 0;
+        for (auto lf = text.find('\n'); lf != std::string::npos; lf = text.find('\n', pos)) {
+            lines.emplace_back(text, pos, lf - pos);
+            pos = lf + 1;
+        }
+
+        // what Editor::save used to do
+        auto begin = std::chrono::steady_clock::now();
+        std::ofstream file(path);
+        for (size_t i = 0; i < lines.size(); i++) {
+            file << lines[i] << std::endl;
+        }
+        file.close();
+        report("ofstream << line << endl", text.size(), seconds(begin));
+    }
+
+    for (size_t edits : {0, 100000}) {
+        PieceTable document(text);
+        // scattered typing leaves the table fragmented into many small pieces
+        for (size_t i = 0; i < edits; i++) {
+            document.insert((i * 2654435761u) % document.size(), "x");
+        }
+
+        auto pieces = document.pieces();
+        auto begin = std::chrono::steady_clock::now();
+        SaveEngine::write(pieces, path);
+        report("writev + fsync + rename, " + std::to_string(pieces.size()) + " pieces", document.size(), seconds(begin));
+    }
+
+    std::filesystem::remove(path);
+}
+
+
+void benchSearch() {
+    auto text = genLog(500 << 20);
+    std::vector<std::string> lines;
+    size_t pos = 0;
+    for (auto lf = text.find('\n'); lf != std::string::npos; lf = text.find('\n', pos)) {
+        lines.emplace_back(text, pos, lf - pos);
+        pos = lf + 1;
+    }
+
+    PieceTable edited(text);
+    for (size_t i = 0; i < 100000; i++) {
+        edited.insert((i * 2654435761u) % edited.size(), "x");
+    }
+
+    // rare, common, and a single byte
+    for (std::string needle : {"request 4242424 ", "worker-7]", "9"}) {
+        printf("-- \"%s\"\n", needle.c_str());
+
+        {
+            // what Editor::searchStr did, carried on to every match
+            auto begin = std::chrono::steady_clock::now();
+            size_t count = 0;
+            for (auto& line : lines) {
+                for (auto at = line.find(needle); at != std::string::npos; at = line.find(needle, at + 1)) {
+                    count++;
+                }
+            }
+            report("string::find per line, " + std::to_string(count) + " matches", text.size(), seconds(begin));
+        }
+
+        {
+            std::vector<size_t> matches;
+            auto begin = std::chrono::steady_clock::now();
+            TextScan::find(text.data(), text.size(), needle, 0, matches);
+            report(TextScan::avx2() ? "first/last byte filter (avx2)" : "first/last byte filter (sse2)", text.size(), seconds(begin));
+        }
+
+        {
+            TextSearch search;
+            auto pieces = edited.pieces();
+            auto begin = std::chrono::steady_clock::now();
+            search.search(pieces, needle);
+            report("TextSearch, " + std::to_string(pieces.size()) + " pieces", edited.size(), seconds(begin));
+        }
+    }
+}
+
+void benchCursors() {
+    auto text = genLog(64 << 20);
+    std::vector<size_t> cursors;
+    for (size_t pos = 0; cursors.size() < 10000; pos = text.find('\n', pos) + 1) {
+        cursors.push_back(pos + 5);
+    }
+
+    auto keys = std::string("hello world");
+    {
+        // one insert per cursor, back to front so the offsets stay put
+        PieceTable document(text);
+        auto begin = std::chrono::steady_clock::now();
+        for (size_t k = 0; k < keys.size(); k++) {
+            for (auto it = cursors.rbegin(); it != cursors.rend(); ++it) {
+                document.insert(*it + k, keys.substr(k, 1));
+            }
+        }
+        printf("%-44s %10.3f ms/key\n", "insert per cursor, 10000 cursors", seconds(begin) * 1000 / keys.size());
+    }
+
+    {
+        PieceTable document(text);
+        auto moved = cursors;
+        auto begin = std::chrono::steady_clock::now();
+        for (size_t k = 0; k < keys.size(); k++) {
+            document.replaceAt(moved, 0, keys.substr(k, 1));
+            for (size_t i = 0; i < moved.size(); i++) {
+                moved[i] += i + 1;
+            }
+        }
+        printf("%-44s %10.3f ms/key\n", "replaceAt, 10000 cursors", seconds(begin) * 1000 / keys.size());
+    }
+}
+
+// deleting a token and pasting a line, per character against one range edit;
+// the range times should grow linearly with the length
+void benchRange() {
+    for (size_t length : {size_t(1000), size_t(10000), size_t(100000)}) {
+        auto token = std::string(length, 'x');
+
+        {
+            Editor editor(800, 600, 20, 10);
+            editor.insertRange(0, token);
+            auto begin = std::chrono::steady_clock::now();
+            while (editor.cursorPos_.x > 0) {
+                editor.backspace();
+            }
+            report("backspace per char, " + std::to_string(length), length, seconds(begin));
+        }
+
+        {
+            Editor editor(800, 600, 20, 10);
+            editor.insertRange(0, token);
+            auto begin = std::chrono::steady_clock::now();
+            editor.rmWord();
+            report("rmWord, " + std::to_string(length), length, seconds(begin));
+        }
+
+        {
+            Editor editor(800, 600, 20, 10);
+            editor.copyLine_ = token;
+            auto begin = std::chrono::steady_clock::now();
+            editor.paste();
+            report("paste, " + std::to_string(length), length, seconds(begin));
+        }
+
+        {
+            Editor editor(800, 600, 20, 10);
+            editor.insertRange(0, token);
+            editor.setCursor({0, 0});
+            auto begin = std::chrono::steady_clock::now();
+            editor.moveRightWord();
+            report("moveRightWord, " + std::to_string(length), length, seconds(begin));
+        }
+    }
+}
+
+// validation of ASCII and of mixed UTF-8 text of the same size, against a
+// byte-at-a-time decoder, and the grapheme boundaries of one long line
+void benchUtf8() {
+    size_t bytes = 256 << 20;
+    std::string ascii, mixed;
+    while (ascii.size() < bytes) {
+        ascii += "request 1234 handled by worker-7 in 42 ms, status ok\n";
+    }
+    while (mixed.size() < bytes) {
+        mixed += "requête 1234 traitée par 工作者-7 en 42 ms, état ✓ 👍🏽\n";
+    }
+
+    for (auto [name, text] : {std::pair{"ascii", &ascii}, std::pair{"utf-8", &mixed}}) {
+        auto begin = std::chrono::steady_clock::now();
+        auto valid = TextScan::validUtf8(text->data(), text->size());
+        report(std::string("validate ") + name + (TextScan::avx2() ? " (avx2)" : " (sse2)"), text->size(), seconds(begin));
+
+        begin = std::chrono::steady_clock::now();
+        size_t scalar = 0;
+        while (scalar < text->size()) {
+            auto length = Utf8::sequence(text->data() + scalar, text->size() - scalar);
+            if (length == 0) {
+                break;
+            }
+            scalar += length;
+        }
+        report(std::string("validate ") + name + " (scalar)", text->size(), seconds(begin));
+        if (valid != scalar) {
+            printf("validators disagree: %zu vs %zu\n", valid, scalar);
+        }
+
+        std::string_view line(text->data(), 1 << 20);
+        std::vector<uint32_t> bounds;
+        begin = std::chrono::steady_clock::now();
+        Utf8::graphemes(line, bounds);
+        report(std::string("graphemes of a 1 MB ") + name + " line", line.size(), seconds(begin));
+    }
+}
+
+// decoding into UTF-8 and encoding back in 1 MB chunks, as open and save do,
+// for ASCII and for mixed text; each round trip must give the input back
+void benchTranscode() {
+    size_t bytes = 256 << 20;
+    std::string ascii, latin1, mixed;
+    while (ascii.size() < bytes) {
+        ascii += "request 1234 handled by worker-7 in 42 ms, status ok\n";
+    }
+    while (latin1.size() < bytes) {
+        latin1 += "requ\xea" "te 1234 trait\xe9" "e par l'ouvrier-7 en 42 ms, \xe9" "tat ok \xa7\n";
+    }
+    while (mixed.size() < bytes) {
+        mixed += "requête 1234 traitée par 工作者-7 en 42 ms, état ✓ 👍🏽\n";
+    }
+
+    auto run = [](Transcode::Encoding from, Transcode::Encoding to, const std::string& text) {
+        Transcode::Stream stream(from, to);
+        std::string out;
+        out.reserve(text.size() * 2);
+        for (size_t offset = 0; offset < text.size(); offset += 1 << 20) {
+            stream.convert(std::string_view(text).substr(offset, 1 << 20), out);
+        }
+        stream.finish(out);
+        return out;
+    };
+
+    struct Case {
+        const char* name_;
+        Transcode::Encoding encoding_;
+        const std::string* text_;
+    };
+    std::vector<Case> cases = {
+        {"latin-1 ascii", Transcode::Latin1, &ascii},
+        {"latin-1 accented", Transcode::Latin1, &latin1},
+        {"utf-16le ascii", Transcode::Utf16LE, &ascii},
+        {"utf-16be mixed", Transcode::Utf16BE, &mixed},
+    };
+    for (auto& test : cases) {
+        // the UTF-16 input is made by the encoder under test and checked by the round trip
+        auto input = test.encoding_ == Transcode::Latin1 ? *test.text_ : run(Transcode::Utf8, test.encoding_, *test.text_);
+        auto begin = std::chrono::steady_clock::now();
+        auto utf8 = run(test.encoding_, Transcode::Utf8, input);
+        report(std::string("decode ") + test.name_, input.size(), seconds(begin));
+
+        begin = std::chrono::steady_clock::now();
+        auto back = run(Transcode::Utf8, test.encoding_, utf8);
+        report(std::string("encode ") + test.name_, utf8.size(), seconds(begin));
+        if (back != input) {
+            printf("%s does not round trip\n", test.name_);
+        }
+    }
+}
+
+void benchCsv() {
+    // a quoted field with a comma and a line break in every tenth row
+    std::string text = "id,name,amount,note\n";
+    text.reserve((512 << 20) + 128);
+    for (size_t n = 0; text.size() < (512u << 20); n++) {
+        text += std::to_string(n) + ",user" + std::to_string(n * 7919 % 100003) + "," + std::to_string(n * 31 % 9973) + ".5,";
+        text += n % 10 == 0 ? "\"said \"\"hi\"\",\nthen left\"\n" : "plain note\n";
+    }
+
+    auto cores = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t threads : {size_t(1), size_t(cores)}) {
+        auto begin = std::chrono::steady_clock::now();
+        CsvTable table(nullptr, text, ',', threads);
+        report("parse, " + std::to_string(threads) + " threads, " + std::to_string(table.rows()) + " rows", text.size(), seconds(begin));
+
+        begin = std::chrono::steady_clock::now();
+        table.sort(2, false, threads);
+        report("sort by number, " + std::to_string(threads) + " threads", text.size(), seconds(begin));
+
+        begin = std::chrono::steady_clock::now();
+        table.sort(1, true, threads);
+        report("sort by text, " + std::to_string(threads) + " threads", text.size(), seconds(begin));
+        if (cores == 1) {
+            break;
+        }
+    }
+}
+
+void benchLines() {
+    auto text = genLog(512 << 20);
+    Regex regex("worker-1[0-5]");
+    auto cores = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t threads : {size_t(1), size_t(cores)}) {
+        for (auto [name, op] : {std::pair{"sort", LineOps::Sort}, std::pair{"uniq", LineOps::Uniq}, std::pair{"grep", LineOps::Grep}}) {
+            auto begin = std::chrono::steady_clock::now();
+            auto result = LineOps::run(text, op, &regex, threads);
+            report(std::string(name) + ", " + std::to_string(threads) + " threads", text.size(), seconds(begin));
+        }
+        if (cores == 1) {
+            break;
+        }
+    }
+}
+
+// heap bytes in use, where the allocator tells
+size_t heapInUse() {
+#ifdef __GLIBC__
+    return mallinfo2().uordblks;
+#else
+    return 0;
+#endif
+}
+
+void benchMemory() {
+    auto text = genLog(512 << 20);
+    auto lines = TextScan::count(text.data(), text.size(), '\n');
+    auto perLine = [lines](const std::string& name, size_t bytes) {
+        printf("%-44s %10.1f bytes/line\n", name.c_str(), static_cast<double>(bytes) / lines);
+    };
+
+    {
+        // a std::string per line, the layout before the piece table
+        auto before = heapInUse();
+        std::vector<std::string> strings;
+        for (size_t start = 0, end; start < text.size(); start = end + 1) {
+            end = text.find('\n', start);
+            strings.emplace_back(text, start, end - start);
+        }
+        perLine("std::string per line, text included", heapInUse() - before);
+    }
+
+    PieceTable opened(nullptr, text);
+    perLine("piece table over the text, index only", opened.memory());
+
+    // every line appended at the end, as :follow does
+    PieceTable appended;
+    double slowest = 0;
+    for (size_t start = 0, end; start < text.size(); start = end + 1) {
+        end = text.find('\n', start);
+        auto begin = std::chrono::steady_clock::now();
+        appended.insert(appended.size(), std::string_view(text).substr(start, end + 1 - start));
+        slowest = std::max(slowest, seconds(begin));
+    }
+    perLine("piece table of appended lines, text included", appended.memory());
+    printf("%-44s %10.3f ms\n", "slowest append", slowest * 1000);
+}
+
+void benchCold() {
+    auto text = genLog(256 << 20);
+    auto block = ChunkArena::chunkSize_;
+    std::vector<std::string> packed;
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t offset = 0; offset < text.size(); offset += block) {
+        packed.push_back(Lz::compress(std::string_view(text).substr(offset, block)));
+    }
+    report("compress, 256 KB blocks", text.size(), seconds(begin));
+    size_t total = 0;
+    std::vector<char> out(block);
+    begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < packed.size(); i++) {
+        Lz::decompress(packed[i], out.data(), std::min(block, text.size() - i * block));
+        total += packed[i].size();
+    }
+    report("decompress, 256 KB blocks", text.size(), seconds(begin));
+    printf("%-44s %10.2fx\n", "ratio", static_cast<double>(text.size()) / total);
+
+    // the text appended as :follow does, then everything but the end frozen
+    PieceTable document;
+    for (size_t offset = 0; offset < text.size(); offset += 1 << 20) {
+        document.insert(document.size(), std::string_view(text).substr(offset, 1 << 20));
+    }
+    auto plain = document.memory();
+    begin = std::chrono::steady_clock::now();
+    while (document.freeze(document.size(), document.size(), 64) != 0) {
+    }
+    auto frozen = seconds(begin);
+    printf("%-44s %10.1f MB -> %.1f MB  (%.3f s)\n", "memory, text and indexes", plain / 1048576.0, document.memory() / 1048576.0, frozen);
+
+    // a line far off the screen read again thaws its chunk
+    double slowest = 0;
+    for (size_t line = 0; line < document.lineCount(); line += document.lineCount() / 64) {
+        begin = std::chrono::steady_clock::now();
+        document.line(line);
+        slowest = std::max(slowest, seconds(begin));
+    }
+    printf("%-44s %10.3f ms\n", "slowest line read from a frozen chunk", slowest * 1000);
+}
+
+// readers on every other core check snapshots while the main thread edits a
+// thousand times a second; a snapshot is consistent when its line index
+// agrees with its text
+void benchSnapshots() {
+    Editor editor(800, 600, 20, 10);
+    editor.insertText(0, genLog(8 << 20));
+    auto baseLines = editor.document_.lineCount();
+
+    std::atomic<bool> stop = false;
+    std::atomic<size_t> checked = 0, failed = 0;
+    std::vector<std::thread> readers;
+    auto cores = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t i = 0; i < std::max(cores - 1, 2u); i++) {
+        readers.emplace_back([&, i]() {
+            size_t line = i;
+            while (!stop) {
+                auto snapshot = editor.snapshot();
+                size_t lineFeeds = 0, size = 0;
+                for (auto piece : snapshot->pieces()) {
+                    lineFeeds += TextScan::count(piece.data(), piece.size(), '\n');
+                    size += piece.size();
+                }
+                line = (line * 2654435761u + 1) % snapshot->lineCount();
+                auto ok = lineFeeds + 1 == snapshot->lineCount() && size == snapshot->size() && snapshot->lineCount() >= baseLines;
+                ok = ok && snapshot->line(line) == snapshot->text(snapshot->lineStart(line), snapshot->lineLength(line));
+                failed += !ok;
+                checked++;
+            }
+        });
+    }
+
+    // an edit every millisecond: a line inserted or a line erased at a spread
+    // of places, then a frame's worth of work every 16
+    size_t edits = 0;
+    double slowest = 0, total = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t tick = 0; tick < 3000; tick++) {
+        std::this_thread::sleep_until(begin + std::chrono::milliseconds(tick));
+        auto edit = std::chrono::steady_clock::now();
+        auto& document = editor.document_;
+        auto at = document.lineStart(tick * 7919 % document.lineCount());
+        if (tick % 3 == 2 && document.lineCount() > baseLines) {
+            editor.eraseText(at, document.lineLength(tick * 7919 % document.lineCount()) + 1);
+        } else {
+            editor.insertText(at, "edit " + std::to_string(tick) + "\n");
+        }
+        if (tick % 16 == 0) {
+            editor.update();
+        }
+        auto spent = seconds(edit);
+        slowest = std::max(slowest, spent);
+        total += spent;
+        edits++;
+    }
+    auto elapsed = seconds(begin);
+    stop = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+
+    printf("%-44s %10.0f edits/s\n", "writer", edits / elapsed);
+    printf("%-44s %10.3f ms  (slowest %.3f ms)\n", "edit and publish, mean", total * 1000 / edits, slowest * 1000);
+    printf("%-44s %10.0f /s  (%zu readers, %zu inconsistent)\n", "snapshots checked", checked / elapsed, readers.size(), failed.load());
+}
+
+// a line written into a 1 GB file by another process, next to it and renamed
+// over it, while the editor holds an unsaved edit
+void benchReload() {
+    auto path = genFile(1024).string();
+    Editor editor(800, 600, 20, 10);
+    editor.pagedThreshold_ = ~size_t(0);
+    auto begin = std::chrono::steady_clock::now();
+    editor.init(path);
+    report("open", editor.document_.size(), seconds(begin));
+    editor.insertText(0, "edited here\n");
+    editor.setCursor({0, static_cast<int32_t>(editor.lineCount() / 2)});
+    auto cursor = editor.line(editor.cursorPos_.y);
+
+    for (auto share : {0.9, 0.5, 0.1}) {
+        {
+            MappedFile file(path);
+            auto at = file.view().find('\n', static_cast<size_t>(file.size() * share)) + 1;
+            std::ofstream changed(path + ".new", std::ios::binary);
+            changed.write(file.data(), at);
+            changed << "a line from elsewhere\n";
+            changed.write(file.data() + at, file.size() - at);
+        }
+        std::filesystem::rename(path + ".new", path);
+
+        begin = std::chrono::steady_clock::now();
+        auto merged = editor.reload();
+        auto spent = seconds(begin);
+        char name[64];
+        snprintf(name, sizeof(name), "reload, line at %.0f%%", share * 100);
+        printf("%-44s %10.1f ms  (%s, cursor %s)\n", name, spent * 1000, merged ? "merged" : "not merged", editor.line(editor.cursorPos_.y) == cursor ? "kept" : "lost");
+    }
+
+    begin = std::chrono::steady_clock::now();
+    {
+        Editor again(800, 600, 20, 10);
+        again.pagedThreshold_ = ~size_t(0);
+        again.init(path);
+    }
+    report("init again, for scale", editor.document_.size(), seconds(begin));
+    std::filesystem::remove(path);
+    std::filesystem::remove(path + ".journal");
+}
+
+// a log of short lines wrapped at 40 columns, most taking two rows; every
+// step after the first should stay flat as the file grows
+void benchWrap() {
+    auto path = genFile(128).string();
+    Editor editor(450, 600, 20, 10, 5);
+    editor.init(path);
+    auto lines = static_cast<int32_t>(editor.lineCount());
+
+    auto begin = std::chrono::steady_clock::now();
+    editor.setWrap(true);
+    report("wrap on, every line measured", editor.document_.size(), seconds(begin));
+
+    begin = std::chrono::steady_clock::now();
+    editor.adjust(650, 600);
+    printf("%-44s %10.3f ms  (%zu rows)\n", "resize, rows counted again", seconds(begin) * 1000, editor.wrap_.rows());
+
+    constexpr int jumps = 100000;
+    uint32_t seed = 1;
+    begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < jumps; i++) {
+        seed = seed * 1664525 + 1013904223;
+        editor.setCursor({0, static_cast<int32_t>(seed % lines)});
+        editor.cursorRenderPos(50, 10);
+        editor.showRows();
+    }
+    printf("%-44s %10.3f us\n", "jump, cursor and screen rows", seconds(begin) * 1e6 / jumps);
+
+    editor.setCursor({0, lines / 2});
+    constexpr int keys = 1000;
+    begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < keys; i++) {
+        editor.insertChar('x');
+    }
+    printf("%-44s %10.3f us/key\n", "typing on a wrapping line", seconds(begin) * 1e6 / keys);
+
+    begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < keys / 10; i++) {
+        editor.newLine();
+    }
+    printf("%-44s %10.3f us/key\n", "new lines", seconds(begin) * 1e6 / (keys / 10));
+    std::filesystem::remove(path + ".journal");
+}
+
+// generated C++: a few functions of 100k lines each, with a small block in
+// every seventh line
+void benchFold() {
+    auto path = std::filesystem::temp_directory_path() / "editor_bench_fold.cpp";
+    {
+        std::ofstream file(path, std::ios::binary);
+        for (int function = 0; function < 4; function++) {
+            file << "int f" << function << "() {\n";
+            for (int i = 0; i < 100000; i++) {
+                if (i % 7 == 0) {
+                    file << "    if (x) {\n        y(\"}\");\n    }\n";
+                } else {
+                    file << "    z = " << i << "; // {\n";
+                }
+            }
+            file << "}\n";
+        }
+    }
+    Editor editor(450, 600, 20, 10, 5);
+    editor.init(path.string());
+    auto lines = static_cast<int32_t>(editor.lineCount());
+
+    auto begin = std::chrono::steady_clock::now();
+    editor.setCursor({0, 0});
+    editor.toggleFold();
+    report("folds derived, first closed", editor.document_.size(), seconds(begin));
+    printf("%-44s %10zu\n", "folds", editor.folds_.folds().size());
+
+    constexpr int toggles = 100000;
+    begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < toggles; i++) {
+        editor.toggleFold();
+    }
+    printf("%-44s %10.3f us\n", "toggle a fold of 100k+ lines", seconds(begin) * 1e6 / toggles);
+
+    editor.setCursor({0, lines / 2});
+    constexpr int keys = 1000;
+    begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < keys; i++) {
+        editor.newLine();
+    }
+    printf("%-44s %10.3f us/key\n", "new lines below a closed fold", seconds(begin) * 1e6 / keys);
+
+    uint32_t seed = 1;
+    begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < toggles; i++) {
+        seed = seed * 1664525 + 1013904223;
+        editor.setCursor({0, static_cast<int32_t>(seed % lines)});
+        editor.toggleFold();
+        editor.cursorRenderPos(50, 10);
+        editor.showRows();
+    }
+    printf("%-44s %10.3f us\n", "jump, toggle and screen rows", seconds(begin) * 1e6 / toggles);
+    std::filesystem::remove(path.string() + ".journal");
+    std::filesystem::remove(path);
+}
+
+void benchReplace() {
+    std::string pattern = "request [0-9]*7 handled in [0-9]+";
+    std::string replacement = "[&]";
+
+    {
+        // std::regex for scale, on a slice it can finish
+        auto text = genLog(16 << 20);
+        auto begin = std::chrono::steady_clock::now();
+        auto result = std::regex_replace(text, std::regex(pattern), "[$&]");
+        report("std::regex_replace, 16 MB", text.size(), seconds(begin));
+    }
+
+    PieceTable document(genLog(1024 << 20));
+    Regex regex(pattern);
+    auto cores = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t threads : {size_t(1), size_t(cores)}) {
+        auto begin = std::chrono::steady_clock::now();
+        auto spans = Substitute::run(document, regex, replacement, threads);
+        size_t count = 0;
+        for (auto& span : spans) {
+            count += span.count_;
+        }
+        report("lazy dfa match, " + std::to_string(threads) + " threads, " + std::to_string(count) + " matches", document.size(), seconds(begin));
+
+        if (threads == cores) {
+            auto size = document.size();
+            begin = std::chrono::steady_clock::now();
+            for (auto it = spans.rbegin(); it != spans.rend(); ++it) {
+                document.erase(it->offset_, it->length_);
+                document.insert(it->offset_, it->text_);
+            }
+            report("apply " + std::to_string(spans.size()) + " chunk spans", size, seconds(begin));
+        }
+        if (cores == 1) {
+            break;
+        }
+    }
+}
+
+}
+
+int main(int argc, char** argv) {
+    std::map<std::string, std::function<void()>> benches = {
+        {"cold", benchCold},
+        {"csv", benchCsv},
+        {"cursors", benchCursors},
+        {"fold", benchFold},
+        {"lines", benchLines},
+        {"load", benchLoad},
+        {"memory", benchMemory},
+        {"range", benchRange},
+        {"reload", benchReload},
+        {"replace", benchReplace},
+        {"save", benchSave},
+        {"search", benchSearch},
+        {"snapshots", benchSnapshots},
+        {"transcode", benchTranscode},
+        {"utf8", benchUtf8},
+        {"wrap", benchWrap},
+    };
+
+    if (argc < 2) {
+        for (auto& [name, bench] : benches) {
+            printf("== %s\n", name.c_str());
+            bench();
+        }
+        return 0;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        auto it = benches.find(argv[i]);
+        if (it == benches.end()) {
+            std::cerr << "unknown bench: " << argv[i] << std::endl;
+            return 1;
+        }
+        printf("== %s\n", argv[i]);
+        it->second();
+    }
+}
\ No newline at end of file